@@ -12,6 +12,9 @@
 #define FILE_READ_ERROR 1
 #define NULL_POINTER 2 
 #define UNSUPPORTED_IMAGE 3
+#define WRONG_PARAMETER 4
+#define CANCELLED 5
+#define FILE_TOO_LARGE 6
 #define OTHER_ERROR 255
 
 #endif // error_codes_h__
\ No newline at end of file
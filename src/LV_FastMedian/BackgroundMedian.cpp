@@ -0,0 +1,306 @@
+/**
+ * \file    BackgroundMedian.cpp
+ * \brief	Approximate median with large mask for background estimation
+ * \details Image is decimated by factor f, every f x f block is replaced by its median. Small image is filtered
+ * exactly with mask of size mask/f and result is interpolated back bilinearly. Cost is dominated by block medians
+ * and does not depend on the mask, for f=8 and 101x101 mask small image is filtered with 13x13 mask only.
+ * Error of the approximation is estimated by comparing with exact median at grid of sample pixels.
+ * \author  PB
+ * \date    2014/02/27
+ */
+
+#include "stdafx.h"
+
+#define BG_SAMPLES 16	///< number of sample pixels in every direction used to estimate error
+
+/**
+ * Replaces every f x f block of image by its median, blocks at right and bottom edge may be smaller
+ * \param[in] image		input image
+ * \param[out] small	decimated image of ceil(rows/f) x ceil(cols/f) pixels
+ * \param[in] factor	decimation factor
+ * \param[in] row_start	first row of small image to be computed
+ * \param[in] row_end	one past the last row of small image to be computed
+ * \remarks Median is selected by two passes of 256 bin histogram, high byte first and then low byte of pixels with
+ * found high byte. Unlike std::nth_element there are no data dependent branches and no copy of the block.
+*/
+static void DecimateMedian(const OBRAZ *image, unsigned short *small, unsigned int factor, unsigned int row_start, unsigned int row_end)
+{
+	unsigned int scols = (image->cols+factor-1)/factor;
+	unsigned int count[256];
+	for(unsigned int i=row_start;i<row_end;i++)
+		for(unsigned int j=0;j<scols;j++)
+		{
+			unsigned int r0 = i*factor, r1 = std::min(r0+factor,image->rows);
+			unsigned int c0 = j*factor, c1 = std::min(c0+factor,image->cols);
+			unsigned int k = (r1-r0)*(c1-c0)/2;	// rank of median
+			unsigned int hi, lo;
+			memset(count, 0, sizeof(count));
+			for(unsigned int r=r0;r<r1;r++)
+				for(unsigned int c=c0;c<c1;c++)
+					count[image->tab[r*image->pitch + c]>>8]++;
+			for(hi=0;k>=count[hi];hi++)
+				k -= count[hi];
+			memset(count, 0, sizeof(count));
+			for(unsigned int r=r0;r<r1;r++)
+				for(unsigned int c=c0;c<c1;c++)
+				{
+					unsigned short v = image->tab[r*image->pitch + c];
+					if(hi==static_cast<unsigned int>(v>>8))
+						count[v & 0xFF]++;
+				}
+			for(lo=0;k>=count[lo];lo++)
+				k -= count[lo];
+			small[i*scols + j] = static_cast<unsigned short>((hi<<8) | lo);
+		}
+}
+
+/**
+ * Interpolates decimated image back to full resolution, centre of block is node of interpolation
+ * \param[in] small		decimated image
+ * \param[in] srows		number of rows of decimated image
+ * \param[in] scols		number of columns of decimated image
+ * \param[in] factor	decimation factor
+ * \param[out] tabout	output image
+ * \param[in] cols		number of columns of output image
+ * \param[in] out_pitch	row pitch of output image
+ * \param[in] row_start	first row of output image to be computed
+ * \param[in] row_end	one past the last row of output image to be computed
+ * \remarks Interpolation is separable, every output row interpolates two rows of small image vertically first and
+ * then uses precomputed column nodes and weights.
+*/
+static void UpsampleBilinear(const unsigned short *small, unsigned int srows, unsigned int scols, unsigned int factor, unsigned short *tabout, unsigned int cols, unsigned int out_pitch, unsigned int row_start, unsigned int row_end)
+{
+	std::vector<unsigned int> j0(cols);		// left node of every output column
+	std::vector<float> wx(cols);			// weight of right node
+	std::vector<float> line(scols+1);		// row of small image interpolated vertically, last node repeated
+	for(unsigned int c=0;c<cols;c++)
+	{
+		double x = std::min(std::max((c+0.5)/factor - 0.5, 0.0), scols-1.0);
+		j0[c] = static_cast<unsigned int>(x);
+		wx[c] = static_cast<float>(x - j0[c]);
+	}
+	for(unsigned int r=row_start;r<row_end;r++)
+	{
+		double y = std::min(std::max((r+0.5)/factor - 0.5, 0.0), srows-1.0);
+		unsigned int i0 = static_cast<unsigned int>(y);
+		unsigned int i1 = std::min(i0+1,srows-1);
+		float wy = static_cast<float>(y - i0);
+		const unsigned short *top = small + i0*scols;
+		const unsigned short *bottom = small + i1*scols;
+		for(unsigned int j=0;j<scols;j++)
+			line[j] = top[j] + wy*(bottom[j]-top[j]);
+		line[scols] = line[scols-1];
+		unsigned short *out = tabout + r*out_pitch;
+		for(unsigned int c=0;c<cols;c++)
+		{
+			float left = line[j0[c]];
+			out[c] = static_cast<unsigned short>(left + wx[c]*(line[j0[c]+1]-left) + 0.5f);
+		}
+	}
+}
+
+/**
+ * Compares approximation with exact median at BG_SAMPLES x BG_SAMPLES pixels spread over the image
+ * \param[in] image		input image
+ * \param[in] tabout	approximated median
+ * \param[in] mask		size of the mask
+ * \param[out] mean_error	mean absolute difference
+ * \param[out] max_error	maximal absolute difference
+*/
+static void EstimateError(const OBRAZ *image, const unsigned short *tabout, unsigned short mask, double *mean_error, unsigned short *max_error)
+{
+	int bok_maski = (mask-1)/2;
+	unsigned int nr = std::min<unsigned int>(BG_SAMPLES,image->rows);
+	unsigned int nc = std::min<unsigned int>(BG_SAMPLES,image->cols);
+	std::vector<unsigned short> window(static_cast<size_t>(mask)*mask);
+	double sum = 0;
+	unsigned short maxe = 0;
+	for(unsigned int a=0;a<nr;a++)
+		for(unsigned int b=0;b<nc;b++)
+		{
+			int r = static_cast<int>((2*a+1)*image->rows/(2*nr));	// centres of nr x nc grid cells
+			int k = static_cast<int>((2*b+1)*image->cols/(2*nc));
+			unsigned int n = 0;
+			for(int i=r-bok_maski;i<=r+bok_maski;i++)
+				for(int j=k-bok_maski;j<=k+bok_maski;j++)
+					window[n++] = getPointBorder(image,i,j);
+			std::nth_element(window.begin(),window.begin()+n/2,window.end());
+			unsigned short e = static_cast<unsigned short>(abs(static_cast<int>(tabout[r*image->out_pitch + k]) - window[n/2]));
+			sum += e;
+			maxe = std::max(maxe,e);
+		}
+	if(mean_error)
+		*mean_error = sum/(nr*nc);
+	if(max_error)
+		*max_error = maxe;
+}
+
+/**
+ * Approximates median with large mask, common part of LV_MedFiltBackground and LV_MedFiltBackgroundView
+ * \param[in] image		input image, not empty, pitch, out_pitch and border set
+ * \param[out] tabout	output image
+ * \param[in] mask		size of the mask, odd
+ * \param[in] factor	decimation factor, not zero
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \param[out] mean_error	mean absolute difference to exact median at sample pixels, NULL to skip estimation
+ * \param[out] max_error	maximal absolute difference to exact median at sample pixels, NULL to skip estimation
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li OTHER_ERROR - memory could not be allocated
+*/
+static BYTE BackgroundImage(OBRAZ *image, UINT16 *tabout, UINT16 mask, UINT16 factor, UINT16 nthreads, double* mean_error, UINT16* max_error)
+{
+	OBRAZ small;	// decimated image
+	std::vector<UINT16> small_in, small_out;
+	unsigned int srows, scols;
+	unsigned short smask;
+	srows = (image->rows+factor-1)/factor;
+	scols = (image->cols+factor-1)/factor;
+	smask = static_cast<unsigned short>(2*((mask/2 + factor/2)/factor) + 1);	// half of the mask scaled and rounded
+	bool failed;	// any band failed to allocate memory
+	try
+	{
+		small_in.resize(srows*scols);
+		small_out.resize(srows*scols);
+	}
+	catch(std::bad_alloc&)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	failed = !ParallelBands(srows,nthreads,[&](unsigned int row_start, unsigned int row_end)
+	{
+		DecimateMedian(image,&small_in[0],factor,row_start,row_end);
+	});
+	small.tab = &small_in[0];
+	small.rows = srows;
+	small.cols = scols;
+	small.pitch = scols;
+	small.out_pitch = scols;
+	small.tabsize = srows*scols;
+	small.border = image->border;
+	small.border_value = image->border_value;
+	if(!failed)
+		failed = !FastMedian_Parallel(&small,&small_out[0],smask,nthreads,getBandFilter(getDefaultEngine(smask),16));
+	if(!failed)
+		failed = !ParallelBands(image->rows,nthreads,[&](unsigned int row_start, unsigned int row_end)
+		{
+			UpsampleBilinear(&small_out[0],srows,scols,factor,tabout,image->cols,image->out_pitch,row_start,row_end);
+		});
+	try
+	{
+		if(!failed && (mean_error || max_error))
+			EstimateError(image,tabout,mask,mean_error,max_error);
+	}
+	catch(std::bad_alloc&)
+	{
+		failed = true;
+	}
+	if(failed)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	return OK;
+}
+
+/**
+ * \details Approximates median with large mask, intended for estimation of smooth background. Image is decimated by
+ * factor with block medians, filtered exactly with mask scaled down by factor and interpolated back bilinearly.
+ * Optionally error of the approximation is measured at 16 x 16 pixels against exact median. With factor 1 output is
+ * exact. Image is passed row by row in 1D array.
+ * \param[in] input_image		input image
+ * \param[out] output_image	pointer to output array of size of input image
+ * \param[in] nrows		number of rows
+ * \param[in] ncols		number of columns
+ * \param[in] mask		size of the mask, odd
+ * \param[in] factor	decimation factor, 1 for exact median, mask/10 is reasonable
+ * \param[in] border	border mode, one of BORDER_MODE
+ * \param[in] border_value	value outside the image for BORDER_CONSTANT, ignored otherwise
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \param[out] mean_error	mean absolute difference to exact median at sample pixels, NULL to skip estimation
+ * \param[out] max_error	maximal absolute difference to exact median at sample pixels, NULL to skip estimation
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask, zero factor or unknown border mode
+ * \li OTHER_ERROR - memory could not be allocated
+ * \remarks Estimation costs BG_SAMPLES^2*mask^2 operations, comparable to filtering for small images.
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltBackground(const UINT16* input_image, UINT16* output_image, UINT16 nrows, UINT16 ncols, UINT16 mask, UINT16 factor, UINT16 border, UINT16 border_value, UINT16 nthreads, double* mean_error, UINT16* max_error)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// shallow copy of input image
+	BYTE ret;
+	if(NULL==input_image || NULL==output_image)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2 || 0==factor || border>BORDER_CONSTANT)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong parameters: mask "), pantheios::integer(mask), PSTR(" factor "), pantheios::integer(factor), PSTR(" border "), pantheios::integer(border));
+		return WRONG_PARAMETER;
+	}
+	if(0==nrows || 0==ncols)
+		return OK;
+	obraz.tab = input_image;
+	obraz.rows = nrows;
+	obraz.cols = ncols;
+	obraz.pitch = ncols;
+	obraz.out_pitch = ncols;
+	obraz.tabsize = nrows*ncols;
+	obraz.border = static_cast<BORDER_MODE>(border);
+	obraz.border_value = border_value;
+	ret = BackgroundImage(&obraz,output_image,mask,factor,nthreads,mean_error,max_error);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return ret;
+}
+
+/**
+ * \details Approximates median with large mask of view of the image, as LV_MedFiltBackground. Views address
+ * rectangles of buffers with arbitrary row pitch, see LV_MedFiltView.
+ * \param[in] input		view of input image
+ * \param[in,out] output	view of output image, the same size as input, must not overlap input
+ * \param[in] mask		size of the mask, odd
+ * \param[in] factor	decimation factor, 1 for exact median, mask/10 is reasonable
+ * \param[in] border	border mode, one of BORDER_MODE, applied at the edges of the input view
+ * \param[in] border_value	value outside the view for BORDER_CONSTANT, ignored otherwise
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \param[out] mean_error	mean absolute difference to exact median at sample pixels, NULL to skip estimation
+ * \param[out] max_error	maximal absolute difference to exact median at sample pixels, NULL to skip estimation
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask, zero factor, unknown border mode, empty or inconsistent views
+ * \li OTHER_ERROR - memory could not be allocated
+ * \remarks Pixels outside the input view are never read, even if the buffer contains them, border mode is used instead.
+ * \see MEDFILT_VIEW
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltBackgroundView(const MEDFILT_VIEW *input, const MEDFILT_VIEW *output, UINT16 mask, UINT16 factor, UINT16 border, UINT16 border_value, UINT16 nthreads, double* mean_error, UINT16* max_error)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// input view
+	unsigned short *tabout;	// first pixel of output view
+	BYTE ret;
+	if(NULL==input || NULL==output || NULL==input->tab || NULL==output->tab)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2 || 0==factor || border>BORDER_CONSTANT)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong parameters: mask "), pantheios::integer(mask), PSTR(" factor "), pantheios::integer(factor), PSTR(" border "), pantheios::integer(border));
+		return WRONG_PARAMETER;
+	}
+	if(OK!=viewToImage(input,output,&obraz,&tabout))
+		return WRONG_PARAMETER;
+	obraz.border = static_cast<BORDER_MODE>(border);
+	obraz.border_value = border_value;
+	ret = BackgroundImage(&obraz,tabout,mask,factor,nthreads,mean_error,max_error);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return ret;
+}
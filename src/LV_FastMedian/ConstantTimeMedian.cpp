@@ -0,0 +1,268 @@
+/**
+ * \file    ConstantTimeMedian.cpp
+ * \brief	Median filter with per-pixel cost independent of the mask size
+ * \details Implementation of Perreault, Hebert, Median Filtering in Constant Time. One histogram is kept for every
+ * image column and the kernel histogram is obtained by adding the column entering and subtracting the column
+ * leaving the window. Histograms are two-level (coarse buckets and fine bins), fine level of kernel is updated lazily
+ * only for the bucket that contains the median.
+ * \author  PB
+ * \date    2014/02/10
+ */
+
+#include "stdafx.h"
+
+/// number of output columns processed at once, limits memory used by column histograms
+#define CT_STRIP_WIDTH 64
+
+/**
+ * Layout of constant time histograms for given bit depth, fine level is split into buckets as in C_TwoLevelHist
+ * \tparam BITS		effective bit depth of the image
+ */
+template<unsigned int BITS>
+struct CT_LAYOUT
+{
+	enum
+	{
+		BINS = 1<<BITS,							///< number of fine bins
+		BUCKET_SHIFT = BITS/2,					///< log2 of number of bins in bucket
+		BUCKET_SIZE = 1<<BUCKET_SHIFT,			///< number of fine bins in one coarse bucket
+		BUCKETS = BINS/BUCKET_SIZE				///< number of coarse buckets
+	};
+};
+
+/**
+ * Clears column histogram touching only non-empty buckets
+ * \param[in,out] coarse	coarse level of histogram
+ * \param[in,out] fine		fine level of histogram
+ * \tparam BITS			effective bit depth of the image
+*/
+template<unsigned int BITS>
+static inline void ClearColumnHist(unsigned short *coarse, unsigned short *fine)
+{
+	typedef CT_LAYOUT<BITS> L;
+	for(unsigned int b=0;b<L::BUCKETS;b++)
+		if(coarse[b])
+		{
+			memset(fine + b*L::BUCKET_SIZE, 0, L::BUCKET_SIZE*sizeof(unsigned short));
+			coarse[b] = 0;
+		}
+}
+
+/**
+ * Moves fine level of one kernel bucket along the row by adding and subtracting whole column histograms
+ * \param[in,out] kf	fine level of kernel bucket
+ * \param[in] col_fine	fine level of column histograms of the strip, offset to the first bin of the bucket
+ * \param[in] from		strip column for which \a kf is valid
+ * \param[in] to		strip column for which \a kf is requested
+ * \param[in] mask		size of the mask
+ * \tparam BITS			effective bit depth of the image
+ * \remarks Strip column c is covered by column histograms c to c+mask-1.
+*/
+template<unsigned int BITS>
+static inline void MoveKernelBucket(unsigned int *kf, const unsigned short *col_fine, int from, int to, int mask)
+{
+	typedef CT_LAYOUT<BITS> L;
+	const unsigned short *ch_in, *ch_out;	// histograms of columns entering and leaving the kernel
+	int dir = (to>from) ? 1 : -1;
+	for(int j=from+dir;j!=to+dir;j+=dir)
+	{
+		ch_in = col_fine + (dir>0 ? j+mask-1 : j)*L::BINS;
+		ch_out = col_fine + (dir>0 ? j-1 : j+mask)*L::BINS;
+		for(unsigned int l=0;l<L::BUCKET_SIZE;l++)
+			kf[l] += ch_in[l] - ch_out[l];
+	}
+}
+
+/**
+ * Filters image with median in constant time per pixel.
+ * Based on Perreault, Hebert, Median Filtering in Constant Time, IEEE Trans. Image Processing 16(9), 2007.
+ * \param[in] image		input image, all values must be smaller than 2^BITS
+ * \param[out] tabout	pointer to output array of size of input image
+ * \param[in] mask		size of the mask, odd and square
+ * \param[in] row_start	first row of the band to be filtered
+ * \param[in] row_end	one past the last row of the band to be filtered
+ * \param[in] ws		workspace providing column and kernel histograms, NULL to allocate them locally
+ * \tparam BITS			effective bit depth of the image
+ * \remarks Output is identical to FastMedian_Huang, pixels outside the image are taken according to image->border.
+ * Image is processed in vertical strips of CT_STRIP_WIDTH columns, every strip needs CT_STRIP_WIDTH+mask-1 column
+ * histograms. Column histograms are left zeroed so the workspace can be reused without clearing.
+ * Strip is traversed in serpentine order, even rows of the band left to right and odd rows right to left, so kernel
+ * histogram is never rebuilt. Kernel is moved along the row by adding and subtracting whole column histograms and
+ * is moved one row down at the end of the row together with column histograms, by 2*mask pixels that change in its
+ * columns. Fine buckets of kernel that contained the median in the row are moved to its last column and carried to
+ * the next row in the same way, so a bucket is rebuilt from mask columns only when the median enters it for the first
+ * time or after a long jump. Per pixel cost depends on the strip width and the image content, not on the mask size.
+ * \remarks Memory taken from workspace by one thread is (CT_STRIP_WIDTH+mask-1)*2^BITS*2 bytes of column histograms
+ * plus 2^BITS*4 bytes of kernel, e.g. 21 MB for mask 101 at 16 bits and 1.3 MB at 12 bits.
+*/
+template<unsigned int BITS>
+void FastMedian_ConstantTimeBits(	OBRAZ *image,
+									unsigned short *tabout,
+									unsigned short mask,
+									unsigned int row_start,
+									unsigned int row_end,
+									C_MedianWorkspace *ws)
+{
+	typedef CT_LAYOUT<BITS> L;
+	C_MedianWorkspace local_ws;				// used if caller does not provide workspace
+	unsigned short *col_coarse = NULL;		// coarse level of column histograms [column][L::BUCKETS]
+	unsigned short *col_fine = NULL;		// fine level of column histograms [column][L::BINS]
+	unsigned int kernel_coarse[L::BUCKETS];	// coarse level of kernel histogram
+	unsigned int *kernel_fine = NULL;		// fine level of kernel histogram, valid only for buckets listed in luc and lur
+	int luc[L::BUCKETS];					// column for which fine bucket of kernel is valid (last updated column)
+	int lur[L::BUCKETS];					// row for which fine bucket of kernel is valid (last updated row)
+	int lmr[L::BUCKETS];					// last row in which bucket contained the median
+	int bok_maski = (mask-1)/2;				// half of the mask
+	unsigned int th = (mask*mask)/2;		// rank of median
+	unsigned int ncolhist = CT_STRIP_WIDTH + mask - 1;	// column histograms needed by one strip
+	int c0, c1;								// columns of current strip [c0,c1)
+	int r, c, h, j;							// row, column, histogram index and column of histogram
+	int dir;								// direction of current row, 1 left to right, -1 right to left
+	unsigned int b, l;						// bucket and bin counters
+	unsigned int sum;						// cumulative histogram
+	unsigned short *ch;						// column histogram helper
+	unsigned int *kf;						// kernel bucket helper
+
+	if(row_start>=row_end || 0==image->cols)
+		return;
+	if(NULL==ws)
+		ws = &local_ws;
+	col_coarse = static_cast<unsigned short*>(ws->GetBuffer(WS_CT_COARSE,ncolhist*L::BUCKETS*sizeof(unsigned short)));
+	col_fine = static_cast<unsigned short*>(ws->GetBuffer(WS_CT_FINE,ncolhist*L::BINS*sizeof(unsigned short)));
+	kernel_fine = static_cast<unsigned int*>(ws->GetBuffer(WS_CT_KERNEL,L::BINS*sizeof(unsigned int)));
+
+	for(c0=0;c0<static_cast<int>(image->cols);c0+=CT_STRIP_WIDTH)
+	{
+		c1 = std::min(c0+CT_STRIP_WIDTH,static_cast<int>(image->cols));
+		int nh = c1 - c0 + mask - 1;		// histograms used in this strip, histogram h holds column c0-bok_maski+h
+		// ---------- column histograms and kernel for the first row of band ----------
+		for(h=0;h<nh;h++)
+		{
+			j = c0 - bok_maski + h;
+			for(r=static_cast<int>(row_start)-bok_maski;r<=static_cast<int>(row_start)+bok_maski;r++)
+			{
+				unsigned short v = getPointBorder(image,r,j);
+				col_coarse[h*L::BUCKETS + (v>>L::BUCKET_SHIFT)]++;
+				col_fine[h*L::BINS + v]++;
+			}
+		}
+		memset(kernel_coarse, 0, sizeof(kernel_coarse));
+		for(h=0;h<mask;h++)
+		{
+			ch = col_coarse + h*L::BUCKETS;
+			for(b=0;b<L::BUCKETS;b++)
+				kernel_coarse[b] += ch[b];
+		}
+		for(b=0;b<L::BUCKETS;b++)
+			lur[b] = lmr[b] = static_cast<int>(row_start) - 1;	// no fine bucket valid
+		c = c0;		// kernel is at the first column of strip
+		for(r=static_cast<int>(row_start);r<static_cast<int>(row_end);r++)
+		{
+			dir = ((r-row_start)&1) ? -1 : 1;
+			// ---------- move column histograms and kernel at column c one row down ----------
+			if(r>static_cast<int>(row_start))
+			{
+				for(b=0;b<L::BUCKETS;b++)	// fine buckets used in previous row moved to column c
+					if(r-1==lur[b] && c!=luc[b])
+					{
+						if(r-1==lmr[b] && 2*abs(c-luc[b]) < mask)
+						{
+							MoveKernelBucket<BITS>(kernel_fine + (b<<L::BUCKET_SHIFT), col_fine + (b<<L::BUCKET_SHIFT), luc[b]-c0, c-c0, mask);
+							luc[b] = c;
+						}
+						else
+							lur[b] = static_cast<int>(row_start) - 1;	// not used or cheaper to rebuild when needed
+					}
+				for(h=0;h<nh;h++)
+				{
+					j = c0 - bok_maski + h;
+					unsigned short vout = getPointBorder(image,r-bok_maski-1,j);
+					unsigned short vin = getPointBorder(image,r+bok_maski,j);
+					col_coarse[h*L::BUCKETS + (vout>>L::BUCKET_SHIFT)]--;
+					col_fine[h*L::BINS + vout]--;
+					col_coarse[h*L::BUCKETS + (vin>>L::BUCKET_SHIFT)]++;
+					col_fine[h*L::BINS + vin]++;
+					if(h<c-c0 || h>=c-c0+mask)	// column outside kernel
+						continue;
+					kernel_coarse[vout>>L::BUCKET_SHIFT]--;
+					kernel_coarse[vin>>L::BUCKET_SHIFT]++;
+					if(r-1==lur[vout>>L::BUCKET_SHIFT] && c==luc[vout>>L::BUCKET_SHIFT])
+						kernel_fine[vout]--;
+					if(r-1==lur[vin>>L::BUCKET_SHIFT] && c==luc[vin>>L::BUCKET_SHIFT])
+						kernel_fine[vin]++;
+				}
+				for(b=0;b<L::BUCKETS;b++)
+					if(r-1==lur[b] && c==luc[b])
+						lur[b] = r;		// fine bucket carried to this row
+			}
+			for(;c>=c0 && c<c1;c+=dir)
+			{
+				if(c!=(dir>0 ? c0 : c1-1))	// move kernel coarse level along the row
+				{
+					unsigned short *ch_in = col_coarse + (dir>0 ? c-c0+mask-1 : c-c0)*L::BUCKETS;
+					unsigned short *ch_out = col_coarse + (dir>0 ? c-c0-1 : c-c0+mask)*L::BUCKETS;
+					for(b=0;b<L::BUCKETS;b++)
+						kernel_coarse[b] += ch_in[b] - ch_out[b];
+				}
+				// bucket containing median
+				for(b=0,sum=0;b<L::BUCKETS;b++)
+				{
+					if(sum+kernel_coarse[b]>th)
+						break;
+					sum += kernel_coarse[b];
+				}
+				_ASSERT(b<L::BUCKETS);
+				// update fine level of this bucket
+				kf = kernel_fine + (b<<L::BUCKET_SHIFT);
+				if(r!=lur[b] || 2*dir*(c-luc[b]) >= mask)	// not valid in this row or cheaper to rebuild from mask columns
+				{
+					memset(kf, 0, L::BUCKET_SIZE*sizeof(unsigned int));
+					for(h=c-c0;h<c-c0+mask;h++)
+					{
+						ch = col_fine + h*L::BINS + (b<<L::BUCKET_SHIFT);
+						for(l=0;l<L::BUCKET_SIZE;l++)
+							kf[l] += ch[l];
+					}
+				}
+				else if(c!=luc[b])	// all moves since last update
+					MoveKernelBucket<BITS>(kf, col_fine + (b<<L::BUCKET_SHIFT), luc[b]-c0, c-c0, mask);
+				luc[b] = c;
+				lur[b] = r;
+				lmr[b] = r;
+				// median within bucket
+				for(l=0;l<L::BUCKET_SIZE;l++)
+				{
+					if(sum+kf[l]>th)
+						break;
+					sum += kf[l];
+				}
+				_ASSERT(l<L::BUCKET_SIZE);
+				tabout[r*image->out_pitch+c] = static_cast<unsigned short>((b<<L::BUCKET_SHIFT) + l);
+			}
+			c -= dir;	// kernel stays at the last column of the row
+		}
+		// ---------- clean column histograms for next strip ----------
+		for(h=0;h<nh;h++)
+			ClearColumnHist<BITS>(col_coarse + h*L::BUCKETS, col_fine + h*L::BINS);
+	}
+}
+
+template void FastMedian_ConstantTimeBits<8>(OBRAZ*, unsigned short*, unsigned short, unsigned int, unsigned int, C_MedianWorkspace*);
+template void FastMedian_ConstantTimeBits<10>(OBRAZ*, unsigned short*, unsigned short, unsigned int, unsigned int, C_MedianWorkspace*);
+template void FastMedian_ConstantTimeBits<12>(OBRAZ*, unsigned short*, unsigned short, unsigned int, unsigned int, C_MedianWorkspace*);
+template void FastMedian_ConstantTimeBits<14>(OBRAZ*, unsigned short*, unsigned short, unsigned int, unsigned int, C_MedianWorkspace*);
+template void FastMedian_ConstantTimeBits<16>(OBRAZ*, unsigned short*, unsigned short, unsigned int, unsigned int, C_MedianWorkspace*);
+
+/**
+ * Filters image with median in constant time per pixel for full 16 bit range.
+ * \see FastMedian_ConstantTimeBits
+*/
+void FastMedian_ConstantTime(	OBRAZ *image,
+								unsigned short *tabout,
+								unsigned short mask,
+								unsigned int row_start,
+								unsigned int row_end,
+								C_MedianWorkspace *ws)
+{
+	FastMedian_ConstantTimeBits<16>(image,tabout,mask,row_start,row_end,ws);
+}
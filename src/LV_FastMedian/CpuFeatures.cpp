@@ -0,0 +1,51 @@
+/**
+ * \file    CpuFeatures.cpp
+ * \brief	Runtime detection of instruction sets used by median engines
+ * \author  PB
+ * \date    2014/02/14
+ */
+
+#include "stdafx.h"
+
+/**
+ * Queries cpuid and xgetbv for instruction sets supported by processor and enabled by operating system
+ * \return combination of CPU_FEATURE flags
+ * \remarks AVX2 requires that OS saves YMM registers (XCR0 bits 1 and 2)
+*/
+static unsigned int detectCpuFeatures()
+{
+	int info[4];				// eax, ebx, ecx, edx
+	int nids;					// highest supported cpuid leaf
+	unsigned int features = 0;
+	bool osxsave, avx;
+
+	__cpuid(info, 0);
+	nids = info[0];
+	if(nids<1)
+		return features;
+	__cpuid(info, 1);
+	if(info[2] & (1<<19))
+		features |= CPU_SSE41;
+	osxsave = 0!=(info[2] & (1<<27));
+	avx = 0!=(info[2] & (1<<28));
+	if(nids>=7 && osxsave && avx)
+	{
+		unsigned long long xcr0 = _xgetbv(0);
+		__cpuidex(info, 7, 0);
+		if((xcr0 & 0x6)==0x6 && (info[1] & (1<<5)))	// YMM state enabled and AVX2
+			features |= CPU_AVX2;
+	}
+	return features;
+}
+
+/// detected once when DLL is loaded
+static const unsigned int cpu_features = detectCpuFeatures();
+
+/**
+ * Returns instruction sets available on this machine
+ * \return combination of CPU_FEATURE flags
+*/
+unsigned int getCpuFeatures()
+{
+	return cpu_features;
+}
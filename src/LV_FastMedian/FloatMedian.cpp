@@ -0,0 +1,514 @@
+/**
+ * \file    FloatMedian.cpp
+ * \brief	Median filter of float and double images
+ * \details IEEE values are mapped to unsigned integer keys that sort in the same order as the values. Image is split
+ * into tiles of at most FLOAT_TILE x FLOAT_TILE pixels including halo, distinct keys of the tile are sorted and every
+ * pixel is replaced by the index of its key among them. Tile has less than 2^16 distinct values so ranks are ordinary
+ * 16 bit image filtered by any of integer engines, median rank is translated back to the value. Only comparisons of
+ * values are used, so result is exactly the same as sorting every window. Masks too large for tiles use ranks of
+ * the whole image and histogram of up to 2^24 bins.
+ * \author  PB
+ * \date    2014/02/26
+ */
+
+#include "stdafx.h"
+
+#define FLOAT_TILE 255	///< side of the tile including halo, tile together with zero has at most 2^16 distinct values
+
+/**
+ * Order preserving mapping between IEEE value and unsigned integer
+ * \tparam T	float or double
+ */
+template<typename T> struct FLOAT_KEY;
+
+template<> struct FLOAT_KEY<float>
+{
+	typedef unsigned int KEY;		///< key of the same size as value
+	/// Maps value to key, negative values are inverted so that keys of all values sort as values
+	static KEY Encode(float v)
+	{
+		KEY u;
+		memcpy(&u, &v, sizeof(u));
+		return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+	}
+	/// Maps key back to value
+	static float Decode(KEY k)
+	{
+		float v;
+		k = (k & 0x80000000u) ? (k & 0x7FFFFFFFu) : ~k;
+		memcpy(&v, &k, sizeof(v));
+		return v;
+	}
+};
+
+template<> struct FLOAT_KEY<double>
+{
+	typedef unsigned long long KEY;	///< key of the same size as value
+	/// Maps value to key, negative values are inverted so that keys of all values sort as values
+	static KEY Encode(double v)
+	{
+		KEY u;
+		memcpy(&u, &v, sizeof(u));
+		return (u & 0x8000000000000000ull) ? ~u : (u | 0x8000000000000000ull);
+	}
+	/// Maps key back to value
+	static double Decode(KEY k)
+	{
+		double v;
+		k = (k & 0x8000000000000000ull) ? (k & 0x7FFFFFFFFFFFFFFFull) : ~k;
+		memcpy(&v, &k, sizeof(v));
+		return v;
+	}
+};
+
+/**
+ * Sorts unsigned keys by LSD radix sort with 16 bit digits, digits equal for all keys are skipped
+ * \param[in,out] keys	keys to sort
+ * \tparam KEY			unsigned integer type
+*/
+template<typename KEY>
+static void RadixSort(std::vector<KEY> &keys)
+{
+	std::vector<KEY> tmp(keys.size());
+	std::vector<size_t> count(65537);
+	for(unsigned int shift=0;shift<8*sizeof(KEY);shift+=16)
+	{
+		std::fill(count.begin(),count.end(),0);
+		for(size_t i=0;i<keys.size();i++)
+			count[((keys[i]>>shift) & 0xFFFF) + 1]++;
+		if(count[((keys[0]>>shift) & 0xFFFF) + 1]==keys.size())	// all keys have the same digit
+			continue;
+		for(unsigned int d=1;d<=65536;d++)
+			count[d] += count[d-1];
+		for(size_t i=0;i<keys.size();i++)
+			tmp[count[(keys[i]>>shift) & 0xFFFF]++] = keys[i];
+		keys.swap(tmp);
+	}
+}
+
+/**
+ * Image of dense ranks of pixel values
+ */
+struct RANK_OBRAZ
+{
+	const unsigned int *tab;		///< rank of every pixel
+	unsigned int rows;				///< number of rows
+	unsigned int cols;				///< number of columns
+	unsigned int border_value;		///< rank of zero, used outside the image
+};
+
+/**
+ * Copies mask pixels of rank image starting at [r,k] in direction [dr,dk], zero rank outside the image
+ * \param[in] image		rank image
+ * \param[in] mask		number of pixels to copy
+ * \param[in] r			first row
+ * \param[in] k			first column
+ * \param[in] dr		step in rows
+ * \param[in] dk		step in columns
+ * \param[out] out		copied pixels
+*/
+static void CopyRankLine(const RANK_OBRAZ *image, unsigned short mask, int r, int k, int dr, int dk, unsigned int *out)
+{
+	for(unsigned int l=0;l<mask;l++,r+=dr,k+=dk)
+		if(r<0 || k<0 || r>=static_cast<int>(image->rows) || k>=static_cast<int>(image->cols))
+			out[l] = image->border_value;
+		else
+			out[l] = image->tab[r*image->cols + k];
+}
+
+/**
+ * Removes one column (or row) of the window from histogram and adds another one, updates counter of median
+ * \param[in,out] hist		histogram of the window
+ * \param[in] out_vals		pixels leaving the window
+ * \param[in] in_vals		pixels entering the window
+ * \param[in] stride		distance between consecutive pixels in out_vals and in_vals
+ * \param[in] mask			number of pixels in out_vals and in_vals
+ * \param[in] mdm			current median
+ * \param[in,out] lmdm		number of pixels in window smaller than mdm
+ * \tparam HIST				C_TwoLevelHist with unsigned int values
+*/
+template<class HIST>
+static inline void RankImageSwap(HIST &hist, const unsigned int *out_vals, const unsigned int *in_vals, unsigned int stride, unsigned short mask, unsigned int mdm, unsigned int &lmdm)
+{
+	for(unsigned int l=0;l<mask*stride;l+=stride)
+	{
+		unsigned int x = out_vals[l];
+		unsigned int y = in_vals[l];
+		hist.Remove(x);
+		hist.Add(y);
+		lmdm += (y<mdm) - (x<mdm);
+	}
+}
+
+/**
+ * Filters band of rows of rank image with median and writes values of median ranks
+ * \param[in] image		rank image
+ * \param[in] values	value of every rank
+ * \param[out] tabout	output image
+ * \param[in] mask		size of the mask, odd
+ * \param[in] row_start	first row of the band to be filtered
+ * \param[in] row_end	one past the last row of the band to be filtered
+ * \param[in] ws		workspace providing histogram and buffers
+ * \tparam HIST			C_TwoLevelHist with unsigned int values
+ * \tparam T			float or double
+*/
+template<class HIST, typename T>
+static void FloatBand(const RANK_OBRAZ *image, const T *values, T *tabout, unsigned short mask, unsigned int row_start, unsigned int row_end, C_MedianWorkspace *ws)
+{
+	unsigned int th = (static_cast<unsigned int>(mask)*mask)/2;	// rank of median
+	unsigned int mdm, lmdm;
+	unsigned int *window, *leaving, *entering;
+	const unsigned int *out_vals, *in_vals;
+	unsigned int stride;
+	int cols = static_cast<int>(image->cols);
+	int bok_maski = (mask-1)/2;
+	int r, k, step, i;
+	bool rows_inside;
+
+	if(row_start>=row_end || 0==image->cols)
+		return;
+	HIST &hist = ws->GetHist<HIST>();
+	leaving = static_cast<unsigned int*>(ws->GetBuffer(WS_LEAVING,mask*sizeof(unsigned int)));
+	entering = static_cast<unsigned int*>(ws->GetBuffer(WS_ENTERING,mask*sizeof(unsigned int)));
+	window = static_cast<unsigned int*>(ws->GetBuffer(WS_WINDOW,mask*sizeof(unsigned int)));
+	r = static_cast<int>(row_start);
+	k = 0;
+	hist.Clear();
+	for(i=0;i<mask;i++)
+	{
+		CopyRankLine(image,mask,r-bok_maski+i,-bok_maski,0,1,window);
+		for(unsigned int l=0;l<mask;l++)
+			hist.Add(window[l]);
+	}
+	mdm = hist.GetRank(th,lmdm);
+	step = 1;
+	for(;;)
+	{
+		tabout[r*image->cols + k] = values[mdm];
+		rows_inside = r>=bok_maski && r+bok_maski<static_cast<int>(image->rows);
+		// ---------- slide along the row ----------
+		while( (step>0 && k+1<cols) || (step<0 && k>0) )
+		{
+			int kout = step>0 ? k-bok_maski : k+bok_maski;
+			int kin = step>0 ? k+bok_maski+1 : k-bok_maski-1;
+			if(rows_inside && std::min(kout,kin)>=0 && std::max(kout,kin)<cols)	// interior - columns read in place
+			{
+				out_vals = image->tab + (r-bok_maski)*cols + kout;
+				in_vals = image->tab + (r-bok_maski)*cols + kin;
+				stride = image->cols;
+			}
+			else
+			{
+				CopyRankLine(image,mask,r-bok_maski,kout,1,0,leaving);
+				CopyRankLine(image,mask,r-bok_maski,kin,1,0,entering);
+				out_vals = leaving;
+				in_vals = entering;
+				stride = 1;
+			}
+			RankImageSwap(hist,out_vals,in_vals,stride,mask,mdm,lmdm);
+			hist.Recenter(th,mdm,lmdm);
+			k += step;
+			tabout[r*image->cols + k] = values[mdm];
+		}
+		if(r+1>=static_cast<int>(row_end))
+			break;
+		// ---------- slide one row down and reverse direction ----------
+		CopyRankLine(image,mask,r-bok_maski,k-bok_maski,0,1,leaving);
+		CopyRankLine(image,mask,r+bok_maski+1,k-bok_maski,0,1,entering);
+		RankImageSwap(hist,leaving,entering,1,mask,mdm,lmdm);
+		hist.Recenter(th,mdm,lmdm);
+		r++;
+		step = -step;
+	}
+}
+
+/**
+ * Filters band with histogram of 2^BITS bins, counters chosen according to the size of the mask
+ * \param[in] image		rank image
+ * \param[in] values	value of every rank
+ * \param[out] tabout	output image
+ * \param[in] mask		size of the mask, odd
+ * \param[in] row_start	first row of the band to be filtered
+ * \param[in] row_end	one past the last row of the band to be filtered
+ * \param[in] ws		workspace providing histogram and buffers
+ * \tparam BITS			number of bits of ranks
+ * \tparam T			float or double
+*/
+template<unsigned int BITS, typename T>
+static void FloatBandBits(const RANK_OBRAZ *image, const T *values, T *tabout, unsigned short mask, unsigned int row_start, unsigned int row_end, C_MedianWorkspace *ws)
+{
+	if(static_cast<unsigned int>(mask)*mask<65536)
+		FloatBand< C_TwoLevelHist<BITS,unsigned short,unsigned int> >(image,values,tabout,mask,row_start,row_end,ws);
+	else
+		FloatBand< C_TwoLevelHist<BITS,unsigned int,unsigned int> >(image,values,tabout,mask,row_start,row_end,ws);
+}
+
+/**
+ * Filters float or double image with median using ranks of the whole image, zeros outside the image
+ * \param[in] input_image	input image
+ * \param[out] output_image	output image
+ * \param[in] nrows			number of rows
+ * \param[in] ncols			number of columns
+ * \param[in] mask			size of the mask, odd
+ * \param[in] nthreads		number of threads, 0 uses all cores
+ * \return operation status as returned by LV_MedFiltFloat
+ * \tparam T				float or double
+ * \remarks Used for masks too large for tiles, histogram with many distinct values is slow for small masks.
+*/
+template<typename T>
+static BYTE FloatMedianGlobal(const T *input_image, T *output_image, UINT16 nrows, UINT16 ncols, UINT16 mask, UINT16 nthreads)
+{
+	typedef typename FLOAT_KEY<T>::KEY KEY;
+	size_t npixels = static_cast<size_t>(nrows)*ncols;
+	std::vector<KEY> keys;				// distinct keys, sorted
+	std::vector<T> values;				// value of every rank
+	std::vector<unsigned int> ranks;	// rank image
+	RANK_OBRAZ obraz;
+	std::atomic<bool> failed(false);	// any band failed to allocate memory
+
+	try
+	{
+		// ---------- distinct values in order, zero for pixels outside the image included ----------
+		keys.resize(npixels+1);
+		for(size_t i=0;i<npixels;i++)
+			keys[i] = FLOAT_KEY<T>::Encode(input_image[i]);
+		keys[npixels] = FLOAT_KEY<T>::Encode(0);
+		RadixSort(keys);
+		keys.erase(std::unique(keys.begin(),keys.end()),keys.end());
+		if(keys.size()>(1u<<24))
+		{
+			PANTHEIOS_TRACE_ERROR(PSTR("Too many distinct values: "), pantheios::integer(keys.size()));
+			return UNSUPPORTED_IMAGE;
+		}
+		values.resize(keys.size());
+		for(size_t i=0;i<keys.size();i++)
+			values[i] = FLOAT_KEY<T>::Decode(keys[i]);
+		// ---------- rank image ----------
+		ranks.resize(npixels);
+		ParallelBands(nrows,nthreads,[&](unsigned int row_start, unsigned int row_end)
+		{
+			for(size_t i=static_cast<size_t>(row_start)*ncols;i<static_cast<size_t>(row_end)*ncols;i++)
+				ranks[i] = static_cast<unsigned int>(std::lower_bound(keys.begin(),keys.end(),FLOAT_KEY<T>::Encode(input_image[i])) - keys.begin());
+		});
+	}
+	catch(std::bad_alloc&)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	obraz.tab = &ranks[0];
+	obraz.rows = nrows;
+	obraz.cols = ncols;
+	obraz.border_value = static_cast<unsigned int>(std::lower_bound(keys.begin(),keys.end(),FLOAT_KEY<T>::Encode(0)) - keys.begin());
+	ParallelBands(nrows,nthreads,[&](unsigned int row_start, unsigned int row_end)
+	{
+		try
+		{
+			C_MedianWorkspace ws;
+			if(values.size()<=(1u<<16))
+				FloatBandBits<16>(&obraz,&values[0],output_image,mask,row_start,row_end,&ws);
+			else if(values.size()<=(1u<<20))
+				FloatBandBits<20>(&obraz,&values[0],output_image,mask,row_start,row_end,&ws);
+			else
+				FloatBandBits<24>(&obraz,&values[0],output_image,mask,row_start,row_end,&ws);
+		}
+		catch(std::bad_alloc&)
+		{
+			failed = true;
+		}
+	});
+	if(failed)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	return OK;
+}
+
+/**
+ * Filters band of rows of float or double image tile by tile, zeros outside the image
+ * \param[in] input_image	input image
+ * \param[out] output_image	output image
+ * \param[in] rows			number of rows
+ * \param[in] cols			number of columns
+ * \param[in] mask			size of the mask, odd, smaller than FLOAT_TILE
+ * \param[in] row_start		first row of the band to be filtered
+ * \param[in] row_end		one past the last row of the band to be filtered
+ * \param[in] ws			workspace used by engine
+ * \tparam T				float or double
+ * \remarks Every tile is ranked separately, halo pixels of the tile are filtered too but not used.
+*/
+template<typename T>
+static void FloatTiles(const T *input_image, T *output_image, unsigned int rows, unsigned int cols, unsigned short mask, unsigned int row_start, unsigned int row_end, C_MedianWorkspace *ws)
+{
+	typedef typename FLOAT_KEY<T>::KEY KEY;
+	unsigned int bok_maski = (mask-1)/2;
+	unsigned int t = FLOAT_TILE - 2*bok_maski;		// filtered pixels of tile in both directions
+	KEY zero = FLOAT_KEY<T>::Encode(0);
+	std::vector<KEY> keys, dict;					// keys of tile pixels, distinct keys of tile
+	std::vector<unsigned short> ranks, tabout;		// tile of ranks and its median
+	BAND_FILTER filter;
+	OBRAZ tile;
+	unsigned int bits;
+
+	for(unsigned int r0=row_start;r0<row_end;r0+=t)
+		for(unsigned int c0=0;c0<cols;c0+=t)
+		{
+			// ---------- tile [r0,r1)x[c0,c1) with halo [ir0,ir1)x[ic0,ic1) ----------
+			unsigned int r1 = std::min(r0+t,row_end);
+			unsigned int c1 = std::min(c0+t,cols);
+			unsigned int ir0 = r0>bok_maski ? r0-bok_maski : 0;
+			unsigned int ic0 = c0>bok_maski ? c0-bok_maski : 0;
+			unsigned int ir1 = std::min(r1+bok_maski,rows);
+			unsigned int ic1 = std::min(c1+bok_maski,cols);
+			unsigned int tw = ic1-ic0;
+			unsigned int tsize = (ir1-ir0)*tw;
+			keys.resize(tsize);
+			for(unsigned int r=ir0;r<ir1;r++)
+				for(unsigned int c=ic0;c<ic1;c++)
+					keys[(r-ir0)*tw + c-ic0] = FLOAT_KEY<T>::Encode(input_image[r*cols + c]);
+			dict.assign(keys.begin(),keys.end());
+			dict.push_back(zero);
+			std::sort(dict.begin(),dict.end());
+			dict.erase(std::unique(dict.begin(),dict.end()),dict.end());
+			ranks.resize(tsize);
+			tabout.resize(tsize);
+			for(unsigned int i=0;i<tsize;i++)
+				ranks[i] = static_cast<unsigned short>(std::lower_bound(dict.begin(),dict.end(),keys[i]) - dict.begin());
+			// ---------- median of ranks ----------
+			tile.tab = &ranks[0];
+			tile.rows = ir1-ir0;
+			tile.cols = tw;
+			tile.pitch = tw;
+			tile.out_pitch = tw;
+			tile.tabsize = tsize;
+			tile.border = BORDER_CONSTANT;
+			tile.border_value = static_cast<unsigned short>(std::lower_bound(dict.begin(),dict.end(),zero) - dict.begin());
+			for(bits=8;(1u<<bits)<dict.size();bits+=2);
+			filter = getBandFilter(getDefaultEngine(mask),bits);
+			filter(&tile,&tabout[0],mask,r0-ir0,r1-ir0,ws);
+			for(unsigned int r=r0;r<r1;r++)
+				for(unsigned int c=c0;c<c1;c++)
+					output_image[r*cols + c] = FLOAT_KEY<T>::Decode(dict[tabout[(r-ir0)*tw + c-ic0]]);
+		}
+}
+
+/**
+ * Filters float or double image with median, zeros outside the image
+ * \param[in] input_image	input image
+ * \param[out] output_image	output image
+ * \param[in] nrows			number of rows
+ * \param[in] ncols			number of columns
+ * \param[in] mask			size of the mask, odd
+ * \param[in] nthreads		number of threads, 0 uses all cores
+ * \return operation status as returned by LV_MedFiltFloat
+ * \tparam T				float or double
+*/
+template<typename T>
+static BYTE FloatMedian(const T *input_image, T *output_image, UINT16 nrows, UINT16 ncols, UINT16 mask, UINT16 nthreads)
+{
+	size_t npixels = static_cast<size_t>(nrows)*ncols;
+	std::atomic<bool> failed(false);	// any band failed to allocate memory
+	if(0==npixels)
+		return OK;
+	for(size_t i=0;i<npixels;i++)
+		if(input_image[i]!=input_image[i])
+		{
+			PANTHEIOS_TRACE_ERROR(PSTR("NaN in image at "), pantheios::integer(i));
+			return UNSUPPORTED_IMAGE;
+		}
+	if(FLOAT_TILE<mask+32)
+		return FloatMedianGlobal(input_image,output_image,nrows,ncols,mask,nthreads);
+	ParallelBands(nrows,nthreads,[&](unsigned int row_start, unsigned int row_end)
+	{
+		try
+		{
+			C_MedianWorkspace ws;
+			FloatTiles(input_image,output_image,nrows,ncols,mask,row_start,row_end,&ws);
+		}
+		catch(std::bad_alloc&)
+		{
+			failed = true;
+		}
+	});
+	if(failed)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	return OK;
+}
+
+/**
+ * \details Filters float image with median. Result is exactly the same as sorting every window, no quantisation
+ * takes place. Image is passed row by row in 1D array.
+ * \param[in] input_image		input image
+ * \param[out] output_image	pointer to output array of size of input image
+ * \param[in] nrows		number of rows
+ * \param[in] ncols		number of columns
+ * \param[in] mask		size of the mask, odd
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask
+ * \li UNSUPPORTED_IMAGE - NaN in image, or more than 2^24 distinct values for mask over 223
+ * \li OTHER_ERROR - memory could not be allocated
+ * \remarks Zeros are assumed outside the image as in LV_MedFilt. -0 and +0 are distinct values ordered -0<+0.
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltFloat(const float* input_image, float* output_image, UINT16 nrows, UINT16 ncols, UINT16 mask, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	BYTE err;
+	if(NULL==input_image || NULL==output_image)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong mask: "), pantheios::integer(mask));
+		return WRONG_PARAMETER;
+	}
+	err = FloatMedian(input_image,output_image,nrows,ncols,mask,nthreads);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return err;
+}
+
+/**
+ * \details Filters double image with median, for example data of C_Matrix_Container. Result is exactly the same as
+ * sorting every window, no quantisation takes place. Image is passed row by row in 1D array.
+ * \param[in] input_image		input image
+ * \param[out] output_image	pointer to output array of size of input image
+ * \param[in] nrows		number of rows
+ * \param[in] ncols		number of columns
+ * \param[in] mask		size of the mask, odd
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask
+ * \li UNSUPPORTED_IMAGE - NaN in image, or more than 2^24 distinct values for mask over 223
+ * \li OTHER_ERROR - memory could not be allocated
+ * \remarks Zeros are assumed outside the image as in LV_MedFilt. -0 and +0 are distinct values ordered -0<+0.
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltDouble(const double* input_image, double* output_image, UINT16 nrows, UINT16 ncols, UINT16 mask, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	BYTE err;
+	if(NULL==input_image || NULL==output_image)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong mask: "), pantheios::integer(mask));
+		return WRONG_PARAMETER;
+	}
+	err = FloatMedian(input_image,output_image,nrows,ncols,mask,nthreads);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return err;
+}
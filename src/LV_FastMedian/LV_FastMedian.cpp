@@ -26,8 +26,8 @@
 */
 inline unsigned short getPoint(OBRAZ *image, unsigned int r, unsigned int k)
 {
-	_ASSERT(r*image->cols+k<image->tabsize);
-	return image->tab[r*image->cols+k];
+	_ASSERT(r<image->rows && k<image->cols);
+	return image->tab[r*image->pitch+k];
 }
 
 /** 
@@ -73,6 +73,31 @@ void CopyWindow( OBRAZ *input_image, unsigned short mask, unsigned int current_r
 			}
 }
 
+/** 
+ * Copies window of size mask x mask centered at [current_row,current_col] and builds its two-level histogram
+ * \param[in] input_image		input image
+ * \param[in] mask				odd size of the mask
+ * \param[in] current_row		row of window center
+ * \param[in] current_col		column of window center
+ * \param[out] out				output array of size mask*mask
+ * \param[out] hist				histogram of the window, cleared before
+ * \tparam HIST					C_TwoLevelHist
+ * \remarks Pixels outside the image are copied according to input_image->border, see CopyOneRow
+*/
+template<class HIST>
+static void CopyWindow( OBRAZ *input_image, unsigned short mask, unsigned int current_row, unsigned int current_col, unsigned short *out, HIST &hist )
+{
+	int bok_maski = (mask-1)/2;
+	unsigned int l = 0;
+	hist.Clear();
+	for(int wr=static_cast<int>(current_row)-bok_maski;wr<=static_cast<int>(current_row)+bok_maski;wr++,l+=mask)
+	{
+		CopyOneRow(input_image,mask,wr,static_cast<int>(current_col)-bok_maski,out+l);
+		for(unsigned int a=l;a<l+mask;a++)
+			hist.Add(out[a]);
+	}
+}
+
 /** 
  * Zwraca median z wektora reprezentowanego przez jego histogram
  * \param[in] hist		tablica z histogramem 
@@ -121,22 +146,66 @@ unsigned short getMedianHist( const unsigned int *hist, unsigned int tabsize )
 	return cum_index[a] + (M-prev_cum)/hist[ cum_index[a] ];
 }
 
+/** 
+ * Removes one column (or row) of the window from histogram and adds another one. Updates number of pixels below median.
+ * Na podstawie Huang, A Fast Two-Dimensional Median Filtering Algorithm 
+ * \param[in,out] hist		histogram of the window
+ * \param[in] out_vals		pixels leaving the window
+ * \param[in] in_vals		pixels entering the window
+ * \param[in] stride		distance between consecutive pixels in out_vals and in_vals, 1 for buffers, cols for image columns
+ * \param[in] mask			number of pixels in out_vals and in_vals
+ * \param[in] mdm			current median
+ * \param[in,out] lmdm		number of pixels in window smaller than mdm
+ * \tparam HIST				C_TwoLevelHist
+*/
+template<class HIST>
+static inline void HuangSwap(HIST &hist, const unsigned short *out_vals, const unsigned short *in_vals, unsigned int stride, unsigned short mask, unsigned short mdm, unsigned int &lmdm)
+{
+	unsigned short picval;					// pomocnicza warto piksela obrazu
+	for(unsigned int l=0;l<mask*stride;l+=stride)	// po wszystkich wartociach kolumny
+	{
+		picval = out_vals[l];
+		hist.Remove(picval);	// kasowanie lewej kolumny z histogtramu
+		if (picval<mdm)
+			lmdm--;
+		picval = in_vals[l];	
+		hist.Add(picval);		// dodawanie prawej kolummny
+		if (picval<mdm)
+			lmdm++;
+	}
+}
+
 /** 
  * Filtruje obraz median
  * Na podstawie Huang, A Fast Two-Dimensional Median Filtering Algorithm.
  * \param[in] image		obraz wejciowy
  * \param[out] tabout	wskanik na tablice wyjciow z przefiltrowanym obrazem o rozmiarze obrazu wejciowego
  * \param[in] mask		rozmiar maski, maska nieparzysta i kwadratowa
- * \remarks Na rogach obrazu pojawiaj si zera. Pozatym mona procedur jeszcze przyspieszy modyfikujc pierwsz median (moe na containerze bdzie szybsza (getMedian)
- * oraz modyfikujc pobieranie wartoci okna poprzez kopiowanie caych rzedw na raz (s liniowo w pamici).
- * \todo Add progress feature
+ * \param[in] row_start	first row of the band to be filtered
+ * \param[in] row_end	one past the last row of the band to be filtered
+ * \param[in] ws		workspace providing histogram and buffers, NULL to allocate them locally
+ * \remarks Each row builds its own histogram so bands [row_start,row_end) are independent and can be filtered concurrently
+ * \remarks Columns of windows lying entirely inside the image are read directly from the image with stride of row length,
+ * only windows overlapping the border are copied with border handling (image->border).
+ * \remarks Zera na rogach obrazu pojawiaj si tylko dla BORDER_ZERO (domylny tryb LV_MedFilt), dla BORDER_CONSTANT
+ * rogi d do border_value, BORDER_REPLICATE i BORDER_REFLECT ich nie przyciemniaj.
+ * Pozatym mona procedur jeszcze przyspieszy modyfikujc pierwsz median (moe na containerze bdzie szybsza (getMedian)).
+ * \tparam HIST		C_TwoLevelHist of bit depth of the image
  * \todo Add error_codes support
+ * \see LV_MedFiltProgress for progress reporting and cancellation
 */
-void FastMedian_Huang(	OBRAZ *image,
+template<class HIST>
+static void HuangBand(	OBRAZ *image,
 						unsigned short *tabout, 
-						unsigned short mask)
+						unsigned short mask,
+						unsigned int row_start,
+						unsigned int row_end,
+						C_MedianWorkspace *ws)
 {
-	unsigned int *hist=NULL;				// histogram obszaru filtrowanego
+	C_MedianWorkspace local_ws;				// used if caller does not provide workspace
+	if(NULL==ws)
+		ws = &local_ws;
+	HIST &hist = ws->GetHist<HIST>();		// histogram obszaru filtrowanego
 	unsigned short *window = NULL;			// dane z okna maski
 	unsigned short mdm;						// warto mediany w oknie
  	unsigned int lmdm;					// liczba elementw obrazu o wartociach mniejszych od mdm
@@ -145,75 +214,377 @@ void FastMedian_Huang(	OBRAZ *image,
  	unsigned int r,k;						// indeksy bierzcej pozycji okna na obrazie (rodka)
  	unsigned short mask_center = (mask+1)/2;// rodek maski (indeks)
  	unsigned short bok_maski = (mask-1)/2;	// rozmiar boku maski caa maska to 2*bok + 1 
- 	unsigned int l;							// licznik
-	unsigned short picval;					// pomocnicza warto piksela obrazu
 	unsigned int th = (mask*mask)/2;			// parametr pomocniczy
+	unsigned int k_in0, k_in1;				// window positions [k_in0,k_in1) that do not need border handling
+	const unsigned short *leaving, *entering;	// columns passed to HuangSwap
+	unsigned int stride;					// distance between pixels of leaving and entering
  
- 	hist = new unsigned int[GRAYSCALE];		// zakadam gbi 16 bit
- 	left_column = new unsigned short[mask];	// lewa kolumna poprzedniej pozycji maski (maska jest zawsze kwadratowa)
- 	right_column = new unsigned short[mask];// prawa kolumna bierzacej maski
- 	window = new unsigned short[static_cast<unsigned int>(mask)*mask];
+ 	left_column = static_cast<unsigned short*>(ws->GetBuffer(WS_LEAVING,mask*sizeof(unsigned short)));	// lewa kolumna poprzedniej pozycji maski (maska jest zawsze kwadratowa)
+ 	right_column = static_cast<unsigned short*>(ws->GetBuffer(WS_ENTERING,mask*sizeof(unsigned short)));// prawa kolumna bierzacej maski
+ 	window = static_cast<unsigned short*>(ws->GetBuffer(WS_WINDOW,static_cast<unsigned int>(mask)*mask*sizeof(unsigned short)));
  	/* 
  	 * Przegldanie obrazu po rzdach a procedura szybkiej filtracji po 
  	 * kolumnach. Dla kazdego nowego rzdu powtarza si wszystko od pocztku.
  	 */
- 	for (r = 0;r<image->rows;r++)	// gwna ptla po rzdach obrazu
+ 	for (r = row_start;r<row_end;r++)	// gwna ptla po rzdach obrazu
  	{
  		// -------------------- inicjalizacja parametrw dla kadego rzdu --------------------------
 		k = 0;
 		CopyWindow(image,mask,r,k,window,hist);	// kopiowanie okna skrajnego lewego dla danego rzdu
- // 		mdm = getMedian(window,static_cast<unsigned int>(mask)*mask);	// znajduj median z okna
-		mdm = getMedianHist(hist,GRAYSCALE);
-		tabout[r*image->cols+k] = mdm;	// ustawiam wyjcie przy zaoeniu e tabout jaest taka sama jak tabin
-		// obliczanie lmdm
-		for(l=0,lmdm=0;l<static_cast<unsigned int>(mask)*mask;l++)
-			if(window[l]<mdm)
-				lmdm++;
+		mdm = hist.GetRank(th,lmdm);	// mediana oraz lmdm z histogramu dwupoziomowego
+		tabout[r*image->out_pitch+k] = mdm;	// ustawiam wyjcie przy zaoeniu e tabout jaest taka sama jak tabin
+		if(r>=bok_maski && r+bok_maski<image->rows && image->cols>mask)
+		{
+			k_in0 = bok_maski+1;	// left column of previous window inside
+			k_in1 = image->cols-bok_maski;	// right column of current window inside
+		}
+		else
+			k_in0 = k_in1 = image->cols;
 		for (k = 0+1;k<image->cols;k++)	// gwna ptla po kolumnach obrazu, dla pierwszej pozycji k=mask_center obliczane jest osobno
  		{
 
  			 // modyfikacja histogramu - Na podstawie Huang, A Fast Two-Dimensional Median Filtering Algorithm 
-
-			CopyOneColumn(image,mask,static_cast<int>(r)-bok_maski,static_cast<int>(k)-bok_maski-1,left_column); //pobieranie lewej kolumny poprzedniego (k-1) okna (podaj [r,k] pocztku kolumny	
-			CopyOneColumn(image,mask,static_cast<int>(r)-bok_maski,static_cast<int>(k)+bok_maski,right_column);	// prawa kolumna bierzcego k okna
-			// liczenie mediany
-			for(l=0;l<mask;l++)	// po wszystkich wartociach kolumny
+			if(k>=k_in0 && k<k_in1)	// interior - columns read in place
 			{
-				picval = left_column[l];
-				_ASSERT(hist[picval]>0);	// jeli =0 to po odjciu przepenienie
-				hist[ picval ]--;	// kasowanie lewej kolumny z histogtramu
-				if (picval<mdm)
-					lmdm--;
-				picval = right_column[l];	
-				_ASSERT(hist[picval]<65535);	// jeli =65535 to po odjciu przepenienie
-				hist[picval]++;		// dodawanie prawej kolummny
-				if (picval<mdm)
-					lmdm++;
-			}	// koniec ptli po kolumnach okna
-			if (lmdm>th)
-				while (lmdm>th)	// zmiana wzgldem oryginau !!! FUCK !!
-				{
-					_ASSERT(mdm>0);
-					mdm--;
-					_ASSERT(lmdm>=hist[mdm]);
-					lmdm-=hist[mdm];
-				} 
+				leaving = image->tab + (r-bok_maski)*image->pitch + k-bok_maski-1;
+				entering = leaving + mask;
+				stride = image->pitch;
+			}
 			else
-				while(lmdm+hist[mdm]<=th) {
-					lmdm+=hist[mdm];
-					_ASSERT(mdm<65535);
-					mdm++;
-				}		
+			{
+				CopyOneColumn(image,mask,static_cast<int>(r)-bok_maski,static_cast<int>(k)-bok_maski-1,left_column); //pobieranie lewej kolumny poprzedniego (k-1) okna (podaj [r,k] pocztku kolumny	
+				CopyOneColumn(image,mask,static_cast<int>(r)-bok_maski,static_cast<int>(k)+bok_maski,right_column);	// prawa kolumna bierzcego k okna
+				leaving = left_column;
+				entering = right_column;
+				stride = 1;
+			}
+			// liczenie mediany
+			HuangSwap(hist,leaving,entering,stride,mask,mdm,lmdm);
+			hist.Recenter(th,mdm,lmdm);
 
-			tabout[r*image->cols+k] = mdm;	// ustawiam wyjcie przy zaoeniu e tabout jaest taka sama jak tabin
+			tabout[r*image->out_pitch+k] = mdm;	// ustawiam wyjcie przy zaoeniu e tabout jaest taka sama jak tabin
 		} // koniec ptli po kolumnach obrazu
   
  	} // koniec ptli po rzdach
- 
- 	SAFE_DELETE(hist);
- 	SAFE_DELETE(left_column);
- 	SAFE_DELETE(right_column);
- 	SAFE_DELETE(window);
+}
+
+/** 
+ * Filters image with median using serpentine traversal of the window.
+ * Based on Huang, A Fast Two-Dimensional Median Filtering Algorithm, but the histogram is built only once per band.
+ * At the end of each row the window slides one row down (one row of the window removed, one added) and the next
+ * row is processed in opposite direction. Setup cost per row is O(mask) instead of O(mask^2 + GRAYSCALE).
+ * \param[in] image		input image
+ * \param[out] tabout	pointer to output array of size of input image
+ * \param[in] mask		size of the mask, odd and square
+ * \param[in] row_start	first row of the band to be filtered
+ * \param[in] row_end	one past the last row of the band to be filtered
+ * \param[in] col_start	first column to be filtered
+ * \param[in] col_end	one past the last column to be filtered
+ * \param[in] ws		workspace providing histogram and buffers, NULL to allocate them locally
+ * \tparam HIST		C_TwoLevelHist of bit depth of the image
+ * \remarks Output is identical to FastMedian_Huang. As in HuangBand columns and rows inside the image are read in place.
+ * Only columns [col_start,col_end) of tabout are written, window reads the image outside them as usual.
+*/
+template<class HIST>
+static void HuangSerpentineBand(OBRAZ *image,
+								unsigned short *tabout,
+								unsigned short mask,
+								unsigned int row_start,
+								unsigned int row_end,
+								unsigned int col_start,
+								unsigned int col_end,
+								C_MedianWorkspace *ws)
+{
+	C_MedianWorkspace local_ws;				// used if caller does not provide workspace
+	unsigned short *window = NULL;			// pixels of initial window
+	unsigned short *leaving = NULL;			// column or row leaving the window
+	unsigned short *entering = NULL;		// column or row entering the window
+	const unsigned short *out_vals, *in_vals;	// pixels passed to HuangSwap, buffers above or image itself
+	unsigned int stride;					// distance between pixels of out_vals and in_vals
+	int cols = static_cast<int>(image->cols);
+	bool rows_inside;						// all rows of the window are inside the image
+	unsigned short mdm;						// median in the window
+	unsigned int lmdm;						// number of pixels in window smaller than mdm
+	int r,k;								// position of window center
+	int step;								// direction of current row, +1 or -1
+	int bok_maski = (mask-1)/2;				// half of the mask
+	unsigned int th = (mask*mask)/2;		// rank of median
+
+	if(row_start>=row_end || col_start>=col_end)
+		return;
+	if(NULL==ws)
+		ws = &local_ws;
+	HIST &hist = ws->GetHist<HIST>();		// histogram of window
+	leaving = static_cast<unsigned short*>(ws->GetBuffer(WS_LEAVING,mask*sizeof(unsigned short)));
+	entering = static_cast<unsigned short*>(ws->GetBuffer(WS_ENTERING,mask*sizeof(unsigned short)));
+	window = static_cast<unsigned short*>(ws->GetBuffer(WS_WINDOW,static_cast<unsigned int>(mask)*mask*sizeof(unsigned short)));
+	// initial window on the left side of the first row
+	r = static_cast<int>(row_start);
+	k = static_cast<int>(col_start);
+	CopyWindow(image,mask,r,k,window,hist);
+	mdm = hist.GetRank(th,lmdm);
+	step = 1;
+	for(;;)
+	{
+		tabout[r*image->out_pitch+k] = mdm;
+		rows_inside = r>=bok_maski && r+bok_maski<static_cast<int>(image->rows);
+		// ---------- slide along the row ----------
+		while( (step>0 && k+1<static_cast<int>(col_end)) || (step<0 && k>static_cast<int>(col_start)) )
+		{
+			int kout = step>0 ? k-bok_maski : k+bok_maski;				// column leaving: left or right of current window
+			int kin = step>0 ? k+bok_maski+1 : k-bok_maski-1;			// column entering: right or left of next window
+			if(rows_inside && std::min(kout,kin)>=0 && std::max(kout,kin)<cols)	// interior - columns read in place
+			{
+				out_vals = image->tab + (r-bok_maski)*image->pitch + kout;
+				in_vals = image->tab + (r-bok_maski)*image->pitch + kin;
+				stride = image->pitch;
+			}
+			else
+			{
+				CopyOneColumn(image,mask,r-bok_maski,kout,leaving);
+				CopyOneColumn(image,mask,r-bok_maski,kin,entering);
+				out_vals = leaving;
+				in_vals = entering;
+				stride = 1;
+			}
+			HuangSwap(hist,out_vals,in_vals,stride,mask,mdm,lmdm);
+			hist.Recenter(th,mdm,lmdm);
+			k += step;
+			tabout[r*image->out_pitch+k] = mdm;
+		}
+		if(r+1>=static_cast<int>(row_end))
+			break;
+		// ---------- slide one row down and reverse direction ----------
+		CopyOneRow(image,mask,r-bok_maski,k-bok_maski,leaving);		// top row of current window
+		CopyOneRow(image,mask,r+bok_maski+1,k-bok_maski,entering);	// bottom row of next window
+		HuangSwap(hist,leaving,entering,1,mask,mdm,lmdm);
+		hist.Recenter(th,mdm,lmdm);
+		r++;
+		step = -step;
+	}
+}
+
+/** 
+ * Filters image with median using Huang algorithm that advances several output rows per sweep.
+ * Windows of BANK::ROWS consecutive rows share mask-1 rows of pixels, so every column step loads one column of
+ * mask+BANK::ROWS-1 pixels and updates all histograms of the group from it, instead of loading mask pixels per row.
+ * \param[in] image		input image
+ * \param[out] tabout	pointer to output array of size of input image
+ * \param[in] mask		size of the mask, odd and square
+ * \param[in] row_start	first row of the band to be filtered
+ * \param[in] row_end	one past the last row of the band to be filtered
+ * \param[in] ws		workspace providing histograms and buffers, NULL to allocate them locally
+ * \tparam BANK		C_TwoLevelHistBank of bit depth of the image
+ * \remarks Output is identical to FastMedian_Huang. Pixel at position q of the loaded column belongs to windows
+ * q-mask+1..q of the group, their counters are adjacent in BANK so one pixel touches one cache line.
+ * \remarks Pays off for large masks and images of up to 12 bits. Bank of 16 bit histograms takes MULTIROW_ROWS*128 kB
+ * and does not fit in cache, then HuangBand is usually faster.
+*/
+template<class BANK>
+static void HuangMultiRowBand(	OBRAZ *image,
+								unsigned short *tabout,
+								unsigned short mask,
+								unsigned int row_start,
+								unsigned int row_end,
+								C_MedianWorkspace *ws)
+{
+	C_MedianWorkspace local_ws;				// used if caller does not provide workspace
+	unsigned short *row_buf = NULL;			// one row of initial windows
+	unsigned short *left_column = NULL;		// column leaving windows of the group
+	unsigned short *right_column = NULL;	// column entering windows of the group
+	const unsigned short *leaving, *entering;	// columns read in place or buffers above
+	unsigned int stride;					// distance between pixels of leaving and entering
+	unsigned short mdm[BANK::ROWS];			// median of every window of the group
+	unsigned int lmdm[BANK::ROWS];			// number of pixels in window smaller than mdm
+	int bok_maski = (mask-1)/2;				// half of the mask
+	int rows = static_cast<int>(image->rows);
+	int cols = static_cast<int>(image->cols);
+	unsigned int th = (mask*mask)/2;		// rank of median
+	bool rows_inside;						// all rows of all windows of the group are inside the image
+	int r0, n, h;							// first row of the group, number of rows in the group, height of loaded column
+	int k, q, i, a;							// column, position in loaded column, window of the group, pixel of row
+
+	if(row_start>=row_end || 0==cols)
+		return;
+	if(NULL==ws)
+		ws = &local_ws;
+	BANK &bank = ws->GetHist<BANK>();		// histograms of the group
+	row_buf = static_cast<unsigned short*>(ws->GetBuffer(WS_WINDOW,mask*sizeof(unsigned short)));
+	left_column = static_cast<unsigned short*>(ws->GetBuffer(WS_LEAVING,(mask+BANK::ROWS-1)*sizeof(unsigned short)));
+	right_column = static_cast<unsigned short*>(ws->GetBuffer(WS_ENTERING,(mask+BANK::ROWS-1)*sizeof(unsigned short)));
+	for(r0=static_cast<int>(row_start);r0<static_cast<int>(row_end);r0+=n)
+	{
+		n = std::min<int>(BANK::ROWS,static_cast<int>(row_end)-r0);
+		h = mask+n-1;
+		rows_inside = r0>=bok_maski && r0+n-1+bok_maski<rows;
+		// ---------- windows at the first column ----------
+		bank.Clear();
+		for(q=0;q<h;q++)
+		{
+			CopyOneRow(image,mask,r0-bok_maski+q,-bok_maski,row_buf);
+			for(i=std::max(0,q-mask+1);i<=std::min(n-1,q);i++)
+				for(a=0;a<mask;a++)
+					bank.Add(i,row_buf[a]);
+		}
+		for(i=0;i<n;i++)
+		{
+			mdm[i] = bank.GetRank(i,th,lmdm[i]);
+			tabout[(r0+i)*image->out_pitch] = mdm[i];
+		}
+		// ---------- slide all windows of the group along the rows ----------
+		for(k=1;k<cols;k++)
+		{
+			if(rows_inside && k-bok_maski-1>=0 && k+bok_maski<cols)	// interior - columns read in place
+			{
+				leaving = image->tab + (r0-bok_maski)*image->pitch + k-bok_maski-1;
+				entering = leaving + mask;
+				stride = image->pitch;
+			}
+			else
+			{
+				CopyOneColumn(image,static_cast<unsigned short>(h),r0-bok_maski,k-bok_maski-1,left_column);
+				CopyOneColumn(image,static_cast<unsigned short>(h),r0-bok_maski,k+bok_maski,right_column);
+				leaving = left_column;
+				entering = right_column;
+				stride = 1;
+			}
+			for(q=0;q<h;q++)
+			{
+				unsigned short vout = leaving[q*stride];
+				unsigned short vin = entering[q*stride];
+				if(vout==vin)
+					continue;
+				if(n==BANK::ROWS && q>=n-1 && q<mask)	// pixel shared by all windows of the full group
+				{
+					bank.SwapAll(vout,vin);
+					for(i=0;i<BANK::ROWS;i++)
+						lmdm[i] += static_cast<int>(vin<mdm[i]) - static_cast<int>(vout<mdm[i]);
+					continue;
+				}
+				for(i=std::max(0,q-mask+1);i<=std::min(n-1,q);i++)
+				{
+					bank.Remove(i,vout);
+					if(vout<mdm[i])
+						lmdm[i]--;
+					bank.Add(i,vin);
+					if(vin<mdm[i])
+						lmdm[i]++;
+				}
+			}
+			for(i=0;i<n;i++)
+			{
+				bank.Recenter(i,th,mdm[i],lmdm[i]);
+				tabout[(r0+i)*image->out_pitch+k] = mdm[i];
+			}
+		}
+	}
+}
+
+/** 
+ * Filters image with median using Huang algorithm specialised for bit depth of the image
+ * \param[in] image		input image, all values must be smaller than 2^BITS
+ * \param[out] tabout	pointer to output array of size of input image
+ * \param[in] mask		size of the mask, odd and square
+ * \param[in] row_start	first row of the band to be filtered
+ * \param[in] row_end	one past the last row of the band to be filtered
+ * \param[in] ws		workspace reused between calls, may be NULL
+ * \tparam BITS			effective bit depth of the image
+ * \remarks 16 bit counters are used if mask*mask<65536, then histogram of 12 bit image takes 8 kB
+*/
+template<unsigned int BITS>
+void FastMedian_HuangBits(OBRAZ *image, unsigned short *tabout, unsigned short mask, unsigned int row_start, unsigned int row_end, C_MedianWorkspace *ws)
+{
+	if(static_cast<unsigned int>(mask)*mask<65536)
+		HuangBand< C_TwoLevelHist<BITS,unsigned short> >(image,tabout,mask,row_start,row_end,ws);
+	else
+		HuangBand< C_TwoLevelHist<BITS,unsigned int> >(image,tabout,mask,row_start,row_end,ws);
+}
+
+/** 
+ * Filters image with median using serpentine Huang algorithm specialised for bit depth of the image
+ * \param[in] image		input image, all values must be smaller than 2^BITS
+ * \param[out] tabout	pointer to output array of size of input image
+ * \param[in] mask		size of the mask, odd and square
+ * \param[in] row_start	first row of the band to be filtered
+ * \param[in] row_end	one past the last row of the band to be filtered
+ * \param[in] ws		workspace reused between calls, may be NULL
+ * \tparam BITS			effective bit depth of the image
+ * \see FastMedian_HuangBits
+*/
+template<unsigned int BITS>
+void FastMedian_HuangSerpentineBits(OBRAZ *image, unsigned short *tabout, unsigned short mask, unsigned int row_start, unsigned int row_end, C_MedianWorkspace *ws)
+{
+	if(static_cast<unsigned int>(mask)*mask<65536)
+		HuangSerpentineBand< C_TwoLevelHist<BITS,unsigned short> >(image,tabout,mask,row_start,row_end,0,image->cols,ws);
+	else
+		HuangSerpentineBand< C_TwoLevelHist<BITS,unsigned int> >(image,tabout,mask,row_start,row_end,0,image->cols,ws);
+}
+
+/** 
+ * Filters image with median using multi-row Huang algorithm specialised for bit depth of the image
+ * \param[in] image		input image, all values must be smaller than 2^BITS
+ * \param[out] tabout	pointer to output array of size of input image
+ * \param[in] mask		size of the mask, odd and square
+ * \param[in] row_start	first row of the band to be filtered
+ * \param[in] row_end	one past the last row of the band to be filtered
+ * \param[in] ws		workspace reused between calls, may be NULL
+ * \tparam BITS			effective bit depth of the image
+ * \see HuangMultiRowBand, FastMedian_HuangBits
+*/
+template<unsigned int BITS>
+void FastMedian_HuangMultiRowBits(OBRAZ *image, unsigned short *tabout, unsigned short mask, unsigned int row_start, unsigned int row_end, C_MedianWorkspace *ws)
+{
+	if(static_cast<unsigned int>(mask)*mask<65536)
+		HuangMultiRowBand< C_TwoLevelHistBank<BITS,unsigned short,MULTIROW_ROWS> >(image,tabout,mask,row_start,row_end,ws);
+	else
+		HuangMultiRowBand< C_TwoLevelHistBank<BITS,unsigned int,MULTIROW_ROWS> >(image,tabout,mask,row_start,row_end,ws);
+}
+
+/** 
+ * Filters rectangle of the image with median using serpentine Huang algorithm, rest of tabout is not modified
+ * \param[in] image		input image
+ * \param[out] tabout	pointer to output array of size of input image
+ * \param[in] mask		size of the mask, odd and square
+ * \param[in] row_start	first row of the rectangle
+ * \param[in] row_end	one past the last row of the rectangle
+ * \param[in] col_start	first column of the rectangle
+ * \param[in] col_end	one past the last column of the rectangle
+ * \param[in] ws		workspace reused between calls, may be NULL
+ * \remarks Output inside the rectangle is identical to filtering the whole image
+*/
+void FastMedian_HuangRect(OBRAZ *image, unsigned short *tabout, unsigned short mask, unsigned int row_start, unsigned int row_end, unsigned int col_start, unsigned int col_end, C_MedianWorkspace *ws)
+{
+	if(static_cast<unsigned int>(mask)*mask<65536)
+		HuangSerpentineBand< C_TwoLevelHist<16,unsigned short> >(image,tabout,mask,row_start,row_end,col_start,col_end,ws);
+	else
+		HuangSerpentineBand< C_TwoLevelHist<16,unsigned int> >(image,tabout,mask,row_start,row_end,col_start,col_end,ws);
+}
+
+/** 
+ * Filters 16 bit image with median, Huang algorithm
+ * \see HuangBand
+*/
+void FastMedian_Huang(OBRAZ *image, unsigned short *tabout, unsigned short mask, unsigned int row_start, unsigned int row_end, C_MedianWorkspace *ws)
+{
+	FastMedian_HuangBits<16>(image,tabout,mask,row_start,row_end,ws);
+}
+
+/** 
+ * Filters 16 bit image with median, serpentine Huang algorithm
+ * \see HuangSerpentineBand
+*/
+void FastMedian_HuangSerpentine(OBRAZ *image, unsigned short *tabout, unsigned short mask, unsigned int row_start, unsigned int row_end, C_MedianWorkspace *ws)
+{
+	FastMedian_HuangSerpentineBits<16>(image,tabout,mask,row_start,row_end,ws);
+}
+
+/** 
+ * Filters 16 bit image with median, multi-row Huang algorithm
+ * \see HuangMultiRowBand
+*/
+void FastMedian_HuangMultiRow(OBRAZ *image, unsigned short *tabout, unsigned short mask, unsigned int row_start, unsigned int row_end, C_MedianWorkspace *ws)
+{
+	FastMedian_HuangMultiRowBits<16>(image,tabout,mask,row_start,row_end,ws);
 }
 
 /** 
@@ -225,18 +596,170 @@ void FastMedian_Huang(	OBRAZ *image,
  * \param[in] k			kolumna startowa	
  * \param[out] out		tablica o rozmiarze mask z kolumn	
  * \remarks Procedura dopuszcza ujemne kolumny i rzdy, co odpowiada sytuacji gdy kolumna nie miesci si
- * na obrazie, czyli dla berzegw
+ * na obrazie, czyli dla berzegw. Piksele spoza obrazu zale od input_image->border (getPointBorder).
 */
 void CopyOneColumn( OBRAZ *input_image, unsigned short mask, int r, int k, unsigned short *out )
 {
 	unsigned short a;
+	if(r>=0 && r+mask<=static_cast<int>(input_image->rows) && k>=0 && k<static_cast<int>(input_image->cols))	// whole column inside
+	{
+		const unsigned short *p = input_image->tab + r*input_image->pitch + k;
+		for (a=0;a<mask;a++,p+=input_image->pitch)
+			out[a] = *p;
+		return;
+	}
 	for (a=0;a<mask;a++)
+		out[a] = getPointBorder(input_image,r+a,k);
+}
+
+/** 
+ * Copies one row of the window starting at position [r,k]
+ * \param[in] input_image		input image
+ * \param[in] mask		size of the mask, odd and square
+ * \param[in] r			row
+ * \param[in] k			first column
+ * \param[out] out		array of size mask with the row
+ * \remarks Negative and out of image indexes are allowed, border pixels are copied as in CopyOneColumn
+*/
+void CopyOneRow( OBRAZ *input_image, unsigned short mask, int r, int k, unsigned short *out )
+{
+	unsigned short a;
+	if(r>=0 && r<static_cast<int>(input_image->rows) && k>=0 && k+mask<=static_cast<int>(input_image->cols))	// whole row inside
 	{
-		if(r<0 || r>=static_cast<int>(input_image->rows) || k<0 || k>=static_cast<int>(input_image->cols))	// jeli rzd lub kolumna poza obrazem t owpisywane s 0
-			out[a] = 0;
-		else
-			out[a] = getPoint(input_image,r,k);
-		r++;
+		memcpy(out, input_image->tab + r*input_image->pitch + k, mask*sizeof(unsigned short));
+		return;
+	}
+	for (a=0;a<mask;a++)
+		out[a] = getPointBorder(input_image,r,k+a);
+}
+
+/** 
+ * Runs task concurrently on horizontal bands of the image.
+ * \param[in] rows		number of rows of the image
+ * \param[in] nthreads	number of threads to use, 0 means number of cores reported by the system
+ * \param[in] task		called once for every band [row_start,row_end), bands cover all rows
+ * \return true if every band finished, false if task threw an exception in any band
+ * \remarks The calling thread processes the last band. If a thread can not be created its band is processed
+ * by the calling thread.
+ * \remarks Exceptions do not leave bands, e.g. std::bad_alloc from C_MedianWorkspace. Remaining bands are still
+ * processed and all threads are joined before return, output rows of the failed band are undefined.
+*/
+bool ParallelBands(unsigned int rows, unsigned int nthreads, const BAND_TASK &task)
+{
+	std::vector<std::thread> workers;	// threads processing bands 0..nbands-2
+	std::atomic<bool> failed(false);	// any band thrown
+	unsigned int nbands;				// number of bands the image is split into
+	unsigned int band;					// band counter
+	unsigned int row_start, row_end;	// rows of current band
+	BAND_TASK guarded = [&](unsigned int first, unsigned int last)
+	{
+		try
+		{
+			task(first,last);
+		}
+		catch(...)
+		{
+			failed = true;
+		}
+	};
+
+	if(0==nthreads)
+		nthreads = std::thread::hardware_concurrency();
+	nbands = std::max(1u,std::min(nthreads,rows));
+	for(band=0;band<nbands-1;band++)
+	{
+		row_start = static_cast<unsigned int>(static_cast<unsigned long long>(rows)*band/nbands);
+		row_end = static_cast<unsigned int>(static_cast<unsigned long long>(rows)*(band+1)/nbands);
+		try
+		{
+			workers.push_back(std::thread([=,&guarded]() { guarded(row_start,row_end); }));
+		}
+		catch(std::exception&)	// no resources for next thread - do it here
+		{
+			guarded(row_start,row_end);
+		}
+	}
+	row_start = static_cast<unsigned int>(static_cast<unsigned long long>(rows)*(nbands-1)/nbands);
+	guarded(row_start,rows);	// last band in calling thread
+	for(band=0;band<workers.size();band++)
+		workers[band].join();
+	return !failed;
+}
+
+/** 
+ * Filters image using band filter run concurrently on horizontal bands of the image.
+ * \param[in] image		input image
+ * \param[out] tabout	pointer to output array of size of input image
+ * \param[in] mask		size of the mask, odd and square
+ * \param[in] nthreads	number of threads to use, 0 means number of cores reported by the system
+ * \param[in] filter		median engine applied to every band, e.g. FastMedian_Huang
+ * \return true on success, false if workspace of any band could not be allocated
+ * \remarks Every band allocates its own workspace. Bands do not share any state
+ * thus output is bit-identical to the serial call. \see ParallelBands
+*/
+bool FastMedian_Parallel(	OBRAZ *image,
+							unsigned short *tabout,
+							unsigned short mask,
+							unsigned int nthreads,
+							BAND_FILTER filter)
+{
+	return ParallelBands(image->rows,nthreads,[=](unsigned int row_start, unsigned int row_end) { filter(image,tabout,mask,row_start,row_end,NULL); });
+}
+
+/** 
+ * Returns band filter implementing given engine
+ * \param[in] engine		median engine
+ * \param[in] bits		effective bit depth of the image, 8, 10, 12, 14 or 16
+ * \return pointer to band filter or NULL if engine or bit depth is unknown
+ * \remarks Huang and constant time engines are specialised for bit depth, sorting network works on full 16 bit range.
+ * Histogram memory of specialised engines scales with 2^bits, see FastMedian_ConstantTimeBits for constant time engine.
+*/
+BAND_FILTER getBandFilter(MEDIAN_ENGINE engine, unsigned int bits)
+{
+	if(bits!=8 && bits!=10 && bits!=12 && bits!=14 && bits!=16)
+		return NULL;
+	switch(engine)
+	{
+	case HUANG:
+		switch(bits)
+		{
+		case 8:		return FastMedian_HuangBits<8>;
+		case 10:	return FastMedian_HuangBits<10>;
+		case 12:	return FastMedian_HuangBits<12>;
+		case 14:	return FastMedian_HuangBits<14>;
+		default:	return FastMedian_HuangBits<16>;
+		}
+	case HUANG_SERPENTINE:
+		switch(bits)
+		{
+		case 8:		return FastMedian_HuangSerpentineBits<8>;
+		case 10:	return FastMedian_HuangSerpentineBits<10>;
+		case 12:	return FastMedian_HuangSerpentineBits<12>;
+		case 14:	return FastMedian_HuangSerpentineBits<14>;
+		default:	return FastMedian_HuangSerpentineBits<16>;
+		}
+	case CONSTANT_TIME:
+		switch(bits)
+		{
+		case 8:		return FastMedian_ConstantTimeBits<8>;
+		case 10:	return FastMedian_ConstantTimeBits<10>;
+		case 12:	return FastMedian_ConstantTimeBits<12>;
+		case 14:	return FastMedian_ConstantTimeBits<14>;
+		default:	return FastMedian_ConstantTimeBits<16>;
+		}
+	case HUANG_MULTIROW:
+		switch(bits)
+		{
+		case 8:		return FastMedian_HuangMultiRowBits<8>;
+		case 10:	return FastMedian_HuangMultiRowBits<10>;
+		case 12:	return FastMedian_HuangMultiRowBits<12>;
+		case 14:	return FastMedian_HuangMultiRowBits<14>;
+		default:	return FastMedian_HuangMultiRowBits<16>;
+		}
+	case SORTING_NETWORK:
+		return FastMedian_SortingNetwork;
+	default:
+		return NULL;
 	}
 }
 
@@ -257,8 +780,19 @@ extern "C" __declspec(dllexport) void LV_MedFilt31(const UINT16* input_image, UI
 	obraz.tab = input_image;
 	obraz.rows = nrows;
 	obraz.cols = ncols;
+	obraz.pitch = ncols;
+	obraz.out_pitch = ncols;
 	obraz.tabsize = nrows*ncols;
-	FastMedian_Huang(&obraz,output_image,mask);
+	obraz.border = BORDER_ZERO;
+	obraz.border_value = 0;
+	try
+	{
+		FastMedian_Huang(&obraz,output_image,mask,0,obraz.rows,NULL);
+	}
+	catch(std::bad_alloc&)	// exception must not leave DLL, output is undefined
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+	}
 }
 
 /** 
@@ -269,6 +803,10 @@ extern "C" __declspec(dllexport) void LV_MedFilt31(const UINT16* input_image, UI
  * \param[in] ncols liczba kolumn
  * \param[in] mask Rozmiar maski
  * \remarks Funckja dokonuje transformacji parametrw wejciowych na format z poprzedniego projektu
+ * \remarks Engine, bit depth and number of threads are selected by FastMedian_Dispatch, see LV_MedFiltDispatchSet
+ * and LV_MedFiltCalibrate. Output does not depend on the selection.
+ * \remarks Function does not return status, output is undefined if memory could not be allocated. Use LV_MedFiltMT
+ * or LV_MedFiltView to detect it.
 */
 extern "C" __declspec(dllexport) void LV_MedFilt(const UINT16* input_image, UINT16* output_image, UINT16 nrows, UINT16 ncols, UINT16 mask)
 {
@@ -276,6 +814,226 @@ extern "C" __declspec(dllexport) void LV_MedFilt(const UINT16* input_image, UINT
 	obraz.tab = input_image;
 	obraz.rows = nrows;
 	obraz.cols = ncols;
+	obraz.pitch = ncols;
+	obraz.out_pitch = ncols;
+	obraz.tabsize = nrows*ncols;
+	obraz.border = BORDER_ZERO;
+	obraz.border_value = 0;
+	if(!FastMedian_Dispatch(&obraz,output_image,mask,0))
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+}
+
+/** 
+ * \details Filters image with median using several threads. Image is passed row by row in 1D array.
+ * The image is split into horizontal bands filtered concurrently. Output is identical to LV_MedFilt.
+ * \param[in] input_image		input image
+ * \param[out] output_image	pointer to output array of size of input image
+ * \param[in] nrows		number of rows
+ * \param[in] ncols		number of columns
+ * \param[in] mask		size of the mask, odd
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask
+ * \li OTHER_ERROR - memory could not be allocated
+ * \see FastMedian_Parallel
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltMT(const UINT16* input_image, UINT16* output_image, UINT16 nrows, UINT16 ncols, UINT16 mask, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// shallow copy of input image
+	if(NULL==input_image || NULL==output_image)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Mask must be odd"));
+		return WRONG_PARAMETER;
+	}
+	obraz.tab = input_image;
+	obraz.rows = nrows;
+	obraz.cols = ncols;
+	obraz.pitch = ncols;
+	obraz.out_pitch = ncols;
+	obraz.tabsize = nrows*ncols;
+	obraz.border = BORDER_ZERO;
+	obraz.border_value = 0;
+	PANTHEIOS_TRACE_DEBUG(PSTR("Image size [rows;cols]"),  PSTR("["),pantheios::integer(nrows), PSTR(","), pantheios::integer(ncols), PSTR("] threads: "), pantheios::integer(nthreads));
+	if(!FastMedian_Parallel(&obraz,output_image,mask,nthreads,FastMedian_Huang))
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/** 
+ * \details Filters image with median using selected engine. Image is passed row by row in 1D array.
+ * All engines return identical output, they differ in speed only.
+ * \param[in] input_image		input image
+ * \param[out] output_image	pointer to output array of size of input image
+ * \param[in] nrows		number of rows
+ * \param[in] ncols		number of columns
+ * \param[in] mask		size of the mask, odd
+ * \param[in] engine		median engine, one of MEDIAN_ENGINE
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - unknown engine or even mask
+ * \li OTHER_ERROR - memory could not be allocated
+ * \see MEDIAN_ENGINE
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltEngine(const UINT16* input_image, UINT16* output_image, UINT16 nrows, UINT16 ncols, UINT16 mask, UINT16 engine, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// shallow copy of input image
+	BAND_FILTER filter;
+	if(NULL==input_image || NULL==output_image)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Mask must be odd"));
+		return WRONG_PARAMETER;
+	}
+	filter = getBandFilter(static_cast<MEDIAN_ENGINE>(engine),16);
+	if(NULL==filter)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Unknown engine: "), pantheios::integer(engine));
+		return WRONG_PARAMETER;
+	}
+	obraz.tab = input_image;
+	obraz.rows = nrows;
+	obraz.cols = ncols;
+	obraz.pitch = ncols;
+	obraz.out_pitch = ncols;
+	obraz.tabsize = nrows*ncols;
+	obraz.border = BORDER_ZERO;
+	obraz.border_value = 0;
+	PANTHEIOS_TRACE_DEBUG(PSTR("Engine: "), pantheios::integer(engine), PSTR(" threads: "), pantheios::integer(nthreads));
+	if(!FastMedian_Parallel(&obraz,output_image,mask,nthreads,filter))
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/** 
+ * \details Filters image with median using histograms sized for effective bit depth of the image.
+ * For example 12 bit image uses histogram of 4096 bins with 16 bit counters (8 kB) instead of 65536 bins.
+ * Image is passed row by row in 1D array.
+ * \param[in] input_image		input image, all values must be smaller than 2^bits
+ * \param[out] output_image	pointer to output array of size of input image
+ * \param[in] nrows		number of rows
+ * \param[in] ncols		number of columns
+ * \param[in] mask		size of the mask, odd
+ * \param[in] bits		effective bit depth, 8, 10, 12, 14 or 16
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - unsupported bit depth or even mask
+ * \li UNSUPPORTED_IMAGE - image contains values not fitting in bits
+ * \li OTHER_ERROR - memory could not be allocated
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltBits(const UINT16* input_image, UINT16* output_image, UINT16 nrows, UINT16 ncols, UINT16 mask, UINT16 bits, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// shallow copy of input image
+	BAND_FILTER filter;
+	if(NULL==input_image || NULL==output_image)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	filter = getBandFilter(HUANG,bits);
+	if(NULL==filter || 0==mask%2)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong bit depth or mask: "), pantheios::integer(bits), PSTR(" "), pantheios::integer(mask));
+		return WRONG_PARAMETER;
+	}
+	if(0==nrows || 0==ncols)
+		return OK;
+	obraz.tab = input_image;
+	obraz.rows = nrows;
+	obraz.cols = ncols;
+	obraz.pitch = ncols;
+	obraz.out_pitch = ncols;
+	obraz.tabsize = nrows*ncols;
+	obraz.border = BORDER_ZERO;
+	obraz.border_value = 0;
+	if(*std::max_element(input_image,input_image+obraz.tabsize) >> bits)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Image exceeds bit depth: "), pantheios::integer(bits));
+		return UNSUPPORTED_IMAGE;
+	}
+	if(!FastMedian_Parallel(&obraz,output_image,mask,nthreads,filter))
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/** 
+ * \details Filters image with median using selected handling of pixels outside the image. Zero padding used by
+ * LV_MedFilt darkens the edges, replicate and reflect modes avoid it. Image is passed row by row in 1D array.
+ * \param[in] input_image		input image
+ * \param[out] output_image	pointer to output array of size of input image
+ * \param[in] nrows		number of rows
+ * \param[in] ncols		number of columns
+ * \param[in] mask		size of the mask, odd
+ * \param[in] border		border mode, one of BORDER_MODE
+ * \param[in] border_value	value outside the image for BORDER_CONSTANT, ignored otherwise
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - unknown border mode or even mask
+ * \li OTHER_ERROR - memory could not be allocated
+ * \see BORDER_MODE
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltBorder(const UINT16* input_image, UINT16* output_image, UINT16 nrows, UINT16 ncols, UINT16 mask, UINT16 border, UINT16 border_value, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// shallow copy of input image
+	if(NULL==input_image || NULL==output_image)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2 || border>BORDER_CONSTANT)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong border mode or mask: "), pantheios::integer(border), PSTR(" "), pantheios::integer(mask));
+		return WRONG_PARAMETER;
+	}
+	obraz.tab = input_image;
+	obraz.rows = nrows;
+	obraz.cols = ncols;
+	obraz.pitch = ncols;
+	obraz.out_pitch = ncols;
 	obraz.tabsize = nrows*ncols;
-	FastMedian_Huang(&obraz,output_image,mask);
+	obraz.border = static_cast<BORDER_MODE>(border);
+	obraz.border_value = border_value;
+	if(!FastMedian_Parallel(&obraz,output_image,mask,nthreads,getBandFilter(HUANG,16)))
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
 }
\ No newline at end of file
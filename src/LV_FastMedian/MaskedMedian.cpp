@@ -0,0 +1,277 @@
+/**
+ * \file    MaskedMedian.cpp
+ * \brief	Median filter ignoring invalid pixels (dead or saturated detector pixels)
+ * \details Invalid pixels are never added to the histogram, window traverses the band in serpentine order as in
+ * FastMedian_HuangSerpentine. Number of valid pixels in the window is tracked together with the histogram and the
+ * rank of the median follows it, so every output pixel is median of valid pixels only.
+ * \author  PB
+ * \date    2014/02/25
+ */
+
+#include "stdafx.h"
+
+/**
+ * Image with information which pixels take part in filtering
+ */
+struct MASKED_OBRAZ
+{
+	const OBRAZ *image;				///< input image
+	const unsigned char *valid;		///< non-zero for valid pixels, size of the image, NULL if invalid_value is used
+	unsigned short invalid_value;	///< pixels of this value are invalid if valid is NULL
+};
+
+/**
+ * Tells whether pixel takes part in filtering
+ * \param[in] masked	image with mask
+ * \param[in] r			row of the pixel
+ * \param[in] k			column of the pixel
+ * \return true if pixel is valid
+*/
+static inline bool isValid(const MASKED_OBRAZ *masked, unsigned int r, unsigned int k)
+{
+	if(masked->valid)
+		return 0!=masked->valid[r*masked->image->cols + k];
+	return masked->image->tab[r*masked->image->pitch + k]!=masked->invalid_value;
+}
+
+/**
+ * Adds or removes valid pixels of rectangle to/from histogram, part of the rectangle outside the image is skipped
+ * \param[in,out] hist		histogram of the window
+ * \param[in] masked		image with mask
+ * \param[in] r0			first row of the rectangle
+ * \param[in] r1			last row of the rectangle
+ * \param[in] k0			first column of the rectangle
+ * \param[in] k1			last column of the rectangle
+ * \param[in] add			true to add pixels, false to remove them
+ * \param[in] mdm			current median
+ * \param[in,out] lmdm		number of pixels in histogram smaller than mdm
+ * \param[in,out] nvalid	number of pixels in histogram
+ * \tparam HIST				C_TwoLevelHist
+*/
+template<class HIST>
+static inline void MaskedUpdate(HIST &hist, const MASKED_OBRAZ *masked, int r0, int r1, int k0, int k1, bool add, unsigned short mdm, unsigned int &lmdm, unsigned int &nvalid)
+{
+	const OBRAZ *image = masked->image;
+	r0 = std::max(r0,0);
+	k0 = std::max(k0,0);
+	r1 = std::min(r1,static_cast<int>(image->rows)-1);
+	k1 = std::min(k1,static_cast<int>(image->cols)-1);
+	for(int r=r0;r<=r1;r++)
+		for(int k=k0;k<=k1;k++)
+		{
+			if(!isValid(masked,r,k))
+				continue;
+			unsigned short v = image->tab[r*image->pitch + k];
+			if(add)
+			{
+				hist.Add(v);
+				nvalid++;
+				lmdm += v<mdm;
+			}
+			else
+			{
+				hist.Remove(v);
+				nvalid--;
+				lmdm -= v<mdm;
+			}
+		}
+}
+
+/**
+ * Filters band of rows with median of valid pixels
+ * \param[in] masked		image with mask
+ * \param[out] tabout		output image
+ * \param[in] mask			size of the mask, odd
+ * \param[in] empty_value	output for windows without valid pixels
+ * \param[in] row_start		first row of the band to be filtered
+ * \param[in] row_end		one past the last row of the band to be filtered
+ * \param[in] ws			workspace providing histogram
+ * \tparam HIST				C_TwoLevelHist
+ * \remarks For even number of valid pixels lower median is returned. Pixels outside the image are invalid.
+*/
+template<class HIST>
+static void MaskedBand(const MASKED_OBRAZ *masked, unsigned short *tabout, unsigned short mask, unsigned short empty_value, unsigned int row_start, unsigned int row_end, C_MedianWorkspace *ws)
+{
+	const OBRAZ *image = masked->image;
+	unsigned short mdm = 0;		// median of valid pixels
+	unsigned int lmdm = 0;		// number of valid pixels smaller than mdm
+	unsigned int nvalid = 0;	// number of valid pixels in window
+	int cols = static_cast<int>(image->cols);
+	int bok_maski = (mask-1)/2;
+	int r, k, step;
+
+	if(row_start>=row_end || 0==image->cols)
+		return;
+	HIST &hist = ws->GetHist<HIST>();
+	hist.Clear();
+	r = static_cast<int>(row_start);
+	k = 0;
+	MaskedUpdate(hist,masked,r-bok_maski,r+bok_maski,-bok_maski,bok_maski,true,mdm,lmdm,nvalid);
+	step = 1;
+	for(;;)
+	{
+		for(;;)
+		{
+			if(nvalid)
+			{
+				hist.Recenter((nvalid-1)/2,mdm,lmdm);
+				tabout[r*image->out_pitch + k] = mdm;
+			}
+			else
+				tabout[r*image->out_pitch + k] = empty_value;
+			if( (step>0 && k+1>=cols) || (step<0 && k<=0) )
+				break;
+			// ---------- slide along the row ----------
+			int kout = step>0 ? k-bok_maski : k+bok_maski;
+			int kin = step>0 ? k+bok_maski+1 : k-bok_maski-1;
+			MaskedUpdate(hist,masked,r-bok_maski,r+bok_maski,kout,kout,false,mdm,lmdm,nvalid);
+			MaskedUpdate(hist,masked,r-bok_maski,r+bok_maski,kin,kin,true,mdm,lmdm,nvalid);
+			k += step;
+		}
+		if(r+1>=static_cast<int>(row_end))
+			break;
+		// ---------- slide one row down and reverse direction ----------
+		MaskedUpdate(hist,masked,r-bok_maski,r-bok_maski,k-bok_maski,k+bok_maski,false,mdm,lmdm,nvalid);
+		MaskedUpdate(hist,masked,r+bok_maski+1,r+bok_maski+1,k-bok_maski,k+bok_maski,true,mdm,lmdm,nvalid);
+		r++;
+		step = -step;
+	}
+}
+
+/**
+ * Filters image with median of valid pixels, common part of LV_MedFiltMasked and LV_MedFiltMaskedView
+ * \param[in] image			input image, pitch and out_pitch set
+ * \param[in] valid			mask of image->rows x image->cols, rows not padded, NULL to use invalid_value
+ * \param[out] tabout		output image
+ * \param[in] mask			size of the mask, odd
+ * \param[in] invalid_value	pixels of this value are invalid, used only if valid is NULL
+ * \param[in] empty_value	output for windows without any valid pixel
+ * \param[in] nthreads		number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li OTHER_ERROR - memory could not be allocated
+*/
+static BYTE MaskedImage(const OBRAZ *image, const UINT8 *valid, UINT16 *tabout, UINT16 mask, UINT16 invalid_value, UINT16 empty_value, UINT16 nthreads)
+{
+	MASKED_OBRAZ masked;
+	unsigned int n = static_cast<unsigned int>(mask)*mask;
+	masked.image = image;
+	masked.valid = valid;
+	masked.invalid_value = invalid_value;
+	std::atomic<bool> failed(false);	// any band failed to allocate memory
+	ParallelBands(image->rows,nthreads,[&](unsigned int row_start, unsigned int row_end)
+	{
+		try
+		{
+			C_MedianWorkspace ws;
+			if(n<65536)
+				MaskedBand< C_TwoLevelHist<16,unsigned short> >(&masked,tabout,mask,empty_value,row_start,row_end,&ws);
+			else
+				MaskedBand< C_TwoLevelHist<16,unsigned int> >(&masked,tabout,mask,empty_value,row_start,row_end,&ws);
+		}
+		catch(std::bad_alloc&)
+		{
+			failed = true;
+		}
+	});
+	if(failed)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	return OK;
+}
+
+/**
+ * \details Filters image with median of valid pixels only. Dead and saturated pixels are not added to the histogram
+ * and the median is taken over remaining pixels of the window, so no separate inpainting pass is needed. Invalid
+ * pixels are given either by mask or by their value. Image is passed row by row in 1D array.
+ * \param[in] input_image		input image
+ * \param[in] valid				mask of size of input image, non-zero for valid pixels, NULL to use invalid_value
+ * \param[out] output_image	pointer to output array of size of input image
+ * \param[in] nrows		number of rows
+ * \param[in] ncols		number of columns
+ * \param[in] mask		size of the mask, odd
+ * \param[in] invalid_value	pixels of this value are invalid, used only if valid is NULL
+ * \param[in] empty_value	output for windows without any valid pixel
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask
+ * \li OTHER_ERROR - memory could not be allocated
+ * \remarks For even number of valid pixels in the window lower of two middle values is returned. Pixels outside the
+ * image are treated as invalid, so with all pixels valid the interior is identical to LV_MedFilt and the window
+ * shrinks at the edges instead of being padded with zeros.
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltMasked(const UINT16* input_image, const UINT8* valid, UINT16* output_image, UINT16 nrows, UINT16 ncols, UINT16 mask, UINT16 invalid_value, UINT16 empty_value, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// shallow copy of input image
+	BYTE ret;
+	if(NULL==input_image || NULL==output_image)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong mask: "), pantheios::integer(mask));
+		return WRONG_PARAMETER;
+	}
+	obraz.tab = input_image;
+	obraz.rows = nrows;
+	obraz.cols = ncols;
+	obraz.pitch = ncols;
+	obraz.out_pitch = ncols;
+	obraz.tabsize = nrows*ncols;
+	obraz.border = BORDER_ZERO;
+	obraz.border_value = 0;
+	ret = MaskedImage(&obraz,valid,output_image,mask,invalid_value,empty_value,nthreads);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return ret;
+}
+
+/**
+ * \details Filters view of the image with median of valid pixels only, as LV_MedFiltMasked. Views address rectangles
+ * of buffers with arbitrary row pitch, see LV_MedFiltView.
+ * \param[in] input		view of input image
+ * \param[in] valid		mask of input->rows x input->cols pixels without padding, non-zero for valid pixels, NULL to use invalid_value
+ * \param[in,out] output	view of output image, the same size as input, must not overlap input
+ * \param[in] mask		size of the mask, odd
+ * \param[in] invalid_value	pixels of this value are invalid, used only if valid is NULL
+ * \param[in] empty_value	output for windows without any valid pixel
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask, empty or inconsistent views
+ * \li OTHER_ERROR - memory could not be allocated
+ * \remarks Pixels outside the input view are invalid, even if the buffer contains them.
+ * \see MEDFILT_VIEW
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltMaskedView(const MEDFILT_VIEW *input, const UINT8* valid, const MEDFILT_VIEW *output, UINT16 mask, UINT16 invalid_value, UINT16 empty_value, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// input view
+	unsigned short *tabout;	// first pixel of output view
+	BYTE ret;
+	if(NULL==input || NULL==output || NULL==input->tab || NULL==output->tab)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong mask: "), pantheios::integer(mask));
+		return WRONG_PARAMETER;
+	}
+	if(OK!=viewToImage(input,output,&obraz,&tabout))
+		return WRONG_PARAMETER;
+	ret = MaskedImage(&obraz,valid,tabout,mask,invalid_value,empty_value,nthreads);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return ret;
+}
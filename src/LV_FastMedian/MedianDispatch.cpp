@@ -0,0 +1,377 @@
+/**
+ * \file    MedianDispatch.cpp
+ * \brief	Runtime selection of median engine
+ * \details Engine is chosen from decision table MEDFILT_DISPATCH on mask size, bit depth of the image, height of
+ * bands processed by threads and instruction sets found by getCpuFeatures. Default table can be replaced by
+ * LV_MedFiltDispatchSet or measured on the host by LV_MedFiltCalibrate.
+ * \author  PB
+ * \date    2014/03/05
+ */
+
+#include "stdafx.h"
+
+/// size of synthetic image filtered by calibration
+#define CALIB_SIZE 256
+/// largest mask tried by calibration when looking for CONSTANT_TIME crossover
+#define CALIB_MAX_MASK 151
+/// precision of CONSTANT_TIME crossover found by calibration
+#define CALIB_MASK_STEP 8
+/// number of runs of every measurement, the fastest one is taken
+#define CALIB_REPEAT 2
+/// band of one thread must take at least this many times the time of starting the thread
+#define CALIB_THREAD_FACTOR 4
+/// mask value disabling CONSTANT_TIME in MEDFILT_DISPATCH::ct_min_mask
+#define CT_DISABLED 0xFFFF
+
+/// bit depths of MEDFILT_DISPATCH::network_max_mask and MEDFILT_DISPATCH::ct_min_mask
+static const unsigned int dispatch_bits[DISPATCH_NBITS] = {8, 10, 12, 14, 16};
+
+static std::mutex dispatch_lock;			///< guards dispatch_table and dispatch_valid
+static MEDFILT_DISPATCH dispatch_table;		///< table used by dispatcher
+static bool dispatch_valid = false;			///< dispatch_table has been initialised
+static std::once_flag calibration_once;		///< calibration is run once per process
+
+/**
+ * Fills decision table with defaults for instruction sets of this machine
+ * \param[out] table		decision table
+ * \remarks Huang and constant time engines are specialised on bit depth. Sorting networks pay off for larger masks at
+ * 16 bits than at 8 bits and beat Huang only when evaluated on wide vectors. Constant time engine scans 2^bits bins per
+ * column, so it wins from mask 21 at 8 and 10 bits, from mask 41 at 12 bits and from mask 151 at 14 bits. On 16 bit noise
+ * it does not beat serpentine Huang for any practical mask.
+*/
+static void DefaultDispatch(MEDFILT_DISPATCH &table)
+{
+	static const UINT16 network_max_mask[3][DISPATCH_NBITS] = {
+		{3, 3, 3, 5, 7},	// AVX2
+		{3, 3, 3, 5, 5},	// SSE4.1
+		{0, 0, 0, 3, 3}};	// scalar
+	static const UINT16 ct_min_mask[DISPATCH_NBITS] = {21, 21, 41, 151, CT_DISABLED};
+	unsigned int features = getCpuFeatures();
+	unsigned int isa;	// row of network_max_mask
+	if(features & CPU_AVX2)
+		isa = 0;
+	else if(features & CPU_SSE41)
+		isa = 1;
+	else
+		isa = 2;
+	for(unsigned int b=0;b<DISPATCH_NBITS;b++)
+	{
+		table.network_max_mask[b] = network_max_mask[isa][b];
+		table.ct_min_mask[b] = ct_min_mask[b];
+	}
+	table.min_band_pixels = 16384;
+}
+
+/**
+ * Returns copy of decision table in use
+ * \return decision table
+ * \remarks Defaults are set on first use, getCpuFeatures is not ready during static initialisation of other units.
+*/
+static MEDFILT_DISPATCH getDispatch()
+{
+	std::lock_guard<std::mutex> guard(dispatch_lock);
+	if(!dispatch_valid)
+	{
+		DefaultDispatch(dispatch_table);
+		dispatch_valid = true;
+	}
+	return dispatch_table;
+}
+
+/**
+ * Replaces decision table in use
+ * \param[in] table		new decision table
+*/
+static void setDispatch(const MEDFILT_DISPATCH &table)
+{
+	std::lock_guard<std::mutex> guard(dispatch_lock);
+	dispatch_table = table;
+	dispatch_valid = true;
+}
+
+/**
+ * Returns smallest supported bit depth holding all pixels of the image
+ * \param[in] image		input image
+ * \return 8, 10, 12, 14 or 16
+*/
+static unsigned int getImageBits(const OBRAZ *image)
+{
+	unsigned short max_val = 0;
+	for(unsigned int r=0;r<image->rows && image->cols>0;r++)
+		max_val = std::max(max_val,*std::max_element(image->tab+r*image->pitch,image->tab+r*image->pitch+image->cols));
+	for(unsigned int b=0;b<DISPATCH_NBITS-1;b++)
+		if(0==(max_val >> dispatch_bits[b]))
+			return dispatch_bits[b];
+	return dispatch_bits[DISPATCH_NBITS-1];
+}
+
+/**
+ * Selects engine according to decision table
+ * \param[in] table		decision table
+ * \param[in] mask		size of the mask
+ * \param[in] bits		index of bit depth in dispatch_bits
+ * \param[in] band_rows	number of rows filtered by one call of band filter
+ * \return engine
+ * \remarks Constant time engine initialises column histograms from mask rows for every band, so it is not used for bands
+ * lower than the mask.
+*/
+static MEDIAN_ENGINE EngineFromTable(const MEDFILT_DISPATCH &table, unsigned short mask, unsigned int bits, unsigned int band_rows)
+{
+	if(0==mask%2)
+		return HUANG;
+	if(mask>=3 && mask<=table.network_max_mask[bits] && mask<=NETWORK_MAX_MASK)
+		return SORTING_NETWORK;
+	if(mask>=table.ct_min_mask[bits] && band_rows>=mask)
+		return CONSTANT_TIME;
+	return HUANG_SERPENTINE;
+}
+
+/**
+ * Selects engine for image
+ * \param[in] mask		size of the mask
+ * \param[in] image		input image scanned for bit depth, if NULL full 16 bit range is assumed
+ * \param[in] band_rows	number of rows filtered by one call of band filter
+ * \param[out] bits		bit depth to be passed to getBandFilter
+ * \return engine
+*/
+MEDIAN_ENGINE selectEngine(unsigned short mask, const OBRAZ *image, unsigned int band_rows, unsigned int &bits)
+{
+	unsigned int b = DISPATCH_NBITS-1;
+	if(NULL!=image)
+	{
+		bits = getImageBits(image);
+		while(dispatch_bits[b]!=bits)
+			b--;
+	}
+	bits = dispatch_bits[b];
+	return EngineFromTable(getDispatch(),mask,b,band_rows);
+}
+
+/**
+ * Selects engine for plans and streaming filter
+ * \param[in] mask		size of the mask
+ * \return engine for 16 bit images filtered in bands higher than the mask
+ * \see selectEngine
+*/
+MEDIAN_ENGINE getDefaultEngine(unsigned short mask)
+{
+	return EngineFromTable(getDispatch(),mask,DISPATCH_NBITS-1,mask);
+}
+
+/**
+ * Filters image with median choosing engine, bit depth and number of threads from decision table.
+ * \param[in] image		input image
+ * \param[out] tabout	pointer to output array of size of input image
+ * \param[in] mask		size of the mask
+ * \param[in] nthreads	largest number of threads, 0 means number of cores reported by the system
+ * \return true on success, false if workspace could not be allocated
+ * \remarks Number of threads is reduced so every thread gets at least MEDFILT_DISPATCH::min_band_pixels pixels.
+ * All engines return identical output.
+*/
+bool FastMedian_Dispatch(	OBRAZ *image,
+							unsigned short *tabout,
+							unsigned short mask,
+							unsigned int nthreads)
+{
+	MEDFILT_DISPATCH table = getDispatch();
+	unsigned int bits;
+	unsigned int band_rows;
+	MEDIAN_ENGINE engine;
+	BAND_FILTER filter;
+
+	if(0==nthreads)
+		nthreads = std::max(1u,std::thread::hardware_concurrency());
+	nthreads = std::min(nthreads,std::max(1u,image->tabsize/std::max(1u,static_cast<unsigned int>(table.min_band_pixels))));
+	nthreads = std::max(1u,std::min(nthreads,image->rows));
+	band_rows = image->rows/nthreads;
+	engine = selectEngine(mask,image,band_rows,bits);
+	filter = getBandFilter(engine,bits);
+	PANTHEIOS_TRACE_DEBUG(PSTR("Engine: "), pantheios::integer(engine), PSTR(" bits: "), pantheios::integer(bits), PSTR(" threads: "), pantheios::integer(nthreads));
+	return FastMedian_Parallel(image,tabout,mask,nthreads,filter);
+}
+
+/**
+ * Measures time of filtering whole image by band filter in calling thread
+ * \param[in] filter		band filter
+ * \param[in] image		input image
+ * \param[out] tabout	output image
+ * \param[in] mask		size of the mask
+ * \param[in] ws		workspace reused by all runs
+ * \return the shortest time of CALIB_REPEAT runs in seconds
+*/
+static double TimeFilter(BAND_FILTER filter, OBRAZ *image, unsigned short *tabout, unsigned short mask, C_MedianWorkspace *ws)
+{
+	double best = HUGE_VAL;
+	for(unsigned int rep=0;rep<CALIB_REPEAT;rep++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		filter(image,tabout,mask,0,image->rows,ws);
+		best = std::min(best,std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count());
+	}
+	return best;
+}
+
+/**
+ * Measures time of starting and joining one thread by ParallelBands
+ * \return the shortest time of CALIB_REPEAT runs in seconds
+*/
+static double TimeThreadStart()
+{
+	double best = HUGE_VAL;
+	for(unsigned int rep=0;rep<CALIB_REPEAT;rep++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		ParallelBands(2,2,[](unsigned int, unsigned int) {});
+		best = std::min(best,std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count());
+	}
+	return best;
+}
+
+/**
+ * Finds smallest mask for which constant time engine beats Huang
+ * \param[in] image		input image
+ * \param[out] tabout	output image
+ * \param[in] bits		bit depth of the image
+ * \param[in] ws		workspace reused by all runs
+ * \return smallest mask up to precision CALIB_MASK_STEP or CT_DISABLED if Huang is faster for CALIB_MAX_MASK
+ * \remarks Bisection assumes that Huang slows down with mask and constant time engine does not
+*/
+static unsigned short CalibrateConstantTime(OBRAZ *image, unsigned short *tabout, unsigned int bits, C_MedianWorkspace *ws)
+{
+	BAND_FILTER huang = getBandFilter(HUANG_SERPENTINE,bits);
+	BAND_FILTER ct = getBandFilter(CONSTANT_TIME,bits);
+	unsigned short lo = NETWORK_MAX_MASK;	// Huang is faster
+	unsigned short hi = CALIB_MAX_MASK;		// constant time is faster
+	unsigned short mid;
+	if(TimeFilter(ct,image,tabout,hi,ws)>=TimeFilter(huang,image,tabout,hi,ws))
+		return CT_DISABLED;
+	while(hi-lo>CALIB_MASK_STEP)
+	{
+		mid = ((lo+hi)/2) | 1;
+		if(TimeFilter(ct,image,tabout,mid,ws)<TimeFilter(huang,image,tabout,mid,ws))
+			hi = mid;
+		else
+			lo = mid;
+	}
+	return hi;
+}
+
+/**
+ * Measures crossover points between engines on this machine and installs them as decision table.
+ * \remarks Engines are timed single threaded on CALIB_SIZE x CALIB_SIZE noise image of every bit depth. Sorting networks are
+ * kept while they beat Huang, constant time engine is used from the mask it beats Huang (CalibrateConstantTime).
+ * Threads are limited so one band takes CALIB_THREAD_FACTOR times longer than starting a thread.
+ * \exception std::bad_alloc if memory for images can not be allocated
+*/
+static void CalibrateDispatch()
+{
+	MEDFILT_DISPATCH table;
+	std::vector<unsigned short> input(CALIB_SIZE*CALIB_SIZE), output(CALIB_SIZE*CALIB_SIZE);
+	OBRAZ image = {&input[0], CALIB_SIZE, CALIB_SIZE, CALIB_SIZE*CALIB_SIZE, CALIB_SIZE, CALIB_SIZE, BORDER_ZERO, 0};
+	C_MedianWorkspace ws;
+	unsigned int seed = 1;
+	double t_huang, t_network, t_pixel = HUGE_VAL;
+	unsigned short mask;
+
+	for(unsigned int a=0;a<input.size();a++)
+	{
+		seed = seed*1664525u + 1013904223u;	// deterministic noise, rand() is not thread safe
+		input[a] = static_cast<unsigned short>(seed >> 16);
+	}
+	for(unsigned int b=DISPATCH_NBITS;b-->0;)	// from 16 bits down as image is truncated in place
+	{
+		for(unsigned int a=0;a<input.size();a++)
+			input[a] = static_cast<unsigned short>(input[a] & ((1u<<dispatch_bits[b])-1));
+		table.network_max_mask[b] = 0;
+		for(mask=3;mask<=NETWORK_MAX_MASK;mask+=2)
+		{
+			t_huang = TimeFilter(getBandFilter(HUANG_SERPENTINE,dispatch_bits[b]),&image,&output[0],mask,&ws);
+			t_network = TimeFilter(getBandFilter(SORTING_NETWORK,dispatch_bits[b]),&image,&output[0],mask,&ws);
+			t_pixel = std::min(t_pixel,std::min(t_huang,t_network)/image.tabsize);
+			if(t_network>=t_huang)
+				break;
+			table.network_max_mask[b] = mask;
+		}
+		table.ct_min_mask[b] = CalibrateConstantTime(&image,&output[0],dispatch_bits[b],&ws);
+	}
+	table.min_band_pixels = static_cast<UINT32>(std::max(1.0,std::min(1e9,CALIB_THREAD_FACTOR*TimeThreadStart()/t_pixel)));
+	PANTHEIOS_TRACE_DEBUG(PSTR("Network max mask (16 bit): "), pantheios::integer(table.network_max_mask[DISPATCH_NBITS-1]), PSTR(" CT min mask (16 bit): "), pantheios::integer(table.ct_min_mask[DISPATCH_NBITS-1]), PSTR(" min band pixels: "), pantheios::integer(table.min_band_pixels));
+	setDispatch(table);
+}
+
+/**
+ * \details Returns decision table used by LV_MedFilt to select median engine.
+ * \param[out] table		decision table in use
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \see MEDFILT_DISPATCH
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltDispatchGet(MEDFILT_DISPATCH *table)
+{
+	if(NULL==table)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	*table = getDispatch();
+	return OK;
+}
+
+/**
+ * \details Replaces decision table used by LV_MedFilt to select median engine. Output of LV_MedFilt does not depend on
+ * the table, only its speed.
+ * \param[in] table		new decision table, NULL restores defaults for this machine
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li WRONG_PARAMETER - min_band_pixels is 0
+ * \see MEDFILT_DISPATCH
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltDispatchSet(const MEDFILT_DISPATCH *table)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	MEDFILT_DISPATCH defaults;
+	if(NULL==table)
+	{
+		DefaultDispatch(defaults);
+		table = &defaults;
+	}
+	if(0==table->min_band_pixels)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong min_band_pixels"));
+		return WRONG_PARAMETER;
+	}
+	setDispatch(*table);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * \details Measures crossover points between median engines on this machine and installs them as decision table of
+ * LV_MedFilt. Measurement is done once per process and takes up to few seconds, following calls only return the table in use.
+ * \param[out] table		decision table in use after calibration, may be NULL
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li OTHER_ERROR - memory could not be allocated, defaults are kept
+ * \remarks Table set by LV_MedFiltDispatchSet after calibration replaces measured one.
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltCalibrate(MEDFILT_DISPATCH *table)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	try
+	{
+		std::call_once(calibration_once,CalibrateDispatch);
+	}
+	catch(std::exception &ex)	// bad_alloc or system_error, next call tries again
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Calibration failed: "), ex.what());
+		return OTHER_ERROR;
+	}
+	if(NULL!=table)
+		*table = getDispatch();
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
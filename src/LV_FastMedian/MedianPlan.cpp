@@ -0,0 +1,382 @@
+/**
+ * \file    MedianPlan.cpp
+ * \brief	Median filter plans - preallocated state for filtering many images of the same geometry
+ * \details Plan is created once for given image size, mask and number of threads. It owns a pool of worker threads
+ * and one C_MedianWorkspace per worker, both warmed up in LV_MedFiltPlanCreate, so LV_MedFiltPlanExecute does not
+ * create threads nor allocate memory. Stacks of frames are filtered by LV_MedFiltPlanExecuteBatch or LV_MedFiltBatch.
+ * \author  PB
+ * \date    2014/02/18
+ */
+
+#include "stdafx.h"
+
+/// marks valid plan, cleared on destruction. Best-effort debug check only, destroyed plan is freed so stale pointer is not reliably detected
+#define PLAN_MAGIC 0x4D504C4E
+
+/**
+ * State of median filter plan, opaque for the caller
+ */
+struct MEDFILT_PLAN
+{
+	unsigned int magic;						///< PLAN_MAGIC for valid plan
+	OBRAZ image;							///< geometry of filtered images, tab set by every execution
+	unsigned short *tabout;					///< output of current execution
+	unsigned short mask;					///< size of the mask
+	MEDIAN_ENGINE engine;					///< engine used by the plan
+	BAND_FILTER filter;						///< band filter of engine
+	unsigned int nbands;					///< number of bands the image is split into
+	C_ThreadPool *pool;						///< worker threads
+	C_MedianWorkspace *workspaces;			///< one workspace per worker
+	std::vector<C_ThreadPool::TASK> tasks;	///< one task per band, built once
+	std::mutex lock;						///< serializes executions of the same plan
+};
+
+/**
+ * Filters one band of the image of current plan execution
+ * \param[in] plan		plan
+ * \param[in] band		band index
+ * \param[in] worker	index of worker running the band, selects workspace
+*/
+static void PlanBand(MEDFILT_PLAN *plan, unsigned int band, unsigned int worker)
+{
+	unsigned int row_start = static_cast<unsigned int>(static_cast<unsigned long long>(plan->image.rows)*band/plan->nbands);
+	unsigned int row_end = static_cast<unsigned int>(static_cast<unsigned long long>(plan->image.rows)*(band+1)/plan->nbands);
+	plan->filter(&plan->image,plan->tabout,plan->mask,row_start,row_end,&plan->workspaces[worker]);
+}
+
+/**
+ * Filters band of one frame of the stack
+ * \param[in] plan			plan
+ * \param[in] input_stack	input frames
+ * \param[out] output_stack	output frames
+ * \param[in] frame			frame index
+ * \param[in] band			band index within frame
+ * \param[in] nbands		number of bands of every frame
+ * \param[in] worker		index of worker running the band, selects workspace
+*/
+static void PlanFrameBand(MEDFILT_PLAN *plan, const UINT16 *input_stack, UINT16 *output_stack, unsigned int frame, unsigned int band, unsigned int nbands, unsigned int worker)
+{
+	OBRAZ image = plan->image;
+	size_t offset = static_cast<size_t>(frame)*plan->image.tabsize;
+	unsigned int row_start = static_cast<unsigned int>(static_cast<unsigned long long>(image.rows)*band/nbands);
+	unsigned int row_end = static_cast<unsigned int>(static_cast<unsigned long long>(image.rows)*(band+1)/nbands);
+	image.tab = input_stack + offset;
+	plan->filter(&image,output_stack + offset,plan->mask,row_start,row_end,&plan->workspaces[worker]);
+}
+
+/**
+ * Releases plan resources
+ * \param[in] plan		plan, may be partially constructed
+*/
+static void FreePlan(MEDFILT_PLAN *plan)
+{
+	plan->magic = 0;
+	delete plan->pool;	// joins workers before workspaces are released
+	delete[] plan->workspaces;
+	delete plan;
+}
+
+/**
+ * \details Creates plan for filtering images of given size with median. Threads and all scratch memory are
+ * allocated here and reused by every LV_MedFiltPlanExecute.
+ * \param[in] nrows		number of rows
+ * \param[in] ncols		number of columns
+ * \param[in] mask		size of the mask, odd
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \param[out] plan		created plan, must be released by LV_MedFiltPlanDestroy
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask or empty image
+ * \li OTHER_ERROR - threads or memory could not be allocated
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltPlanCreate(UINT16 nrows, UINT16 ncols, UINT16 mask, UINT16 nthreads, MEDFILT_PLAN **plan)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	MEDFILT_PLAN *p = NULL;
+	if(NULL==plan)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	*plan = NULL;
+	if(0==mask%2 || 0==nrows || 0==ncols)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong mask or image size: "), pantheios::integer(mask), PSTR(" "), pantheios::integer(nrows), PSTR("x"), pantheios::integer(ncols));
+		return WRONG_PARAMETER;
+	}
+	try
+	{
+		p = new MEDFILT_PLAN;
+		p->magic = 0;
+		p->pool = NULL;
+		p->workspaces = NULL;
+		p->image.tab = NULL;
+		p->image.rows = nrows;
+		p->image.cols = ncols;
+		p->image.pitch = ncols;
+		p->image.out_pitch = ncols;
+		p->image.tabsize = nrows*ncols;
+		p->image.border = BORDER_ZERO;
+		p->image.border_value = 0;
+		p->tabout = NULL;
+		p->mask = mask;
+		p->engine = getDefaultEngine(mask);
+		p->filter = getBandFilter(p->engine,16);
+		p->pool = new C_ThreadPool(nthreads);
+		p->workspaces = new C_MedianWorkspace[p->pool->GetSize()];
+		p->nbands = std::min(p->pool->GetSize(),static_cast<unsigned int>(nrows));
+		for(unsigned int band=0;band<p->nbands;band++)
+			p->tasks.push_back([p,band](unsigned int worker) { PlanBand(p,band,worker); });
+		// warm up workspaces - buffers depend on mask only, one pixel image is enough
+		unsigned short dummy_in = 0, dummy_out;
+		OBRAZ dummy = {&dummy_in, 1, 1, 1, 1, 1, BORDER_ZERO, 0};
+		for(unsigned int w=0;w<p->pool->GetSize();w++)
+			p->filter(&dummy,&dummy_out,mask,0,1,&p->workspaces[w]);
+	}
+	catch(std::exception &ex)	// bad_alloc or system_error
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Plan not created: "), ex.what());
+		if(p)
+			FreePlan(p);
+		return OTHER_ERROR;
+	}
+	p->magic = PLAN_MAGIC;
+	*plan = p;
+	PANTHEIOS_TRACE_DEBUG(PSTR("Engine: "), pantheios::integer(p->engine), PSTR(" threads: "), pantheios::integer(p->pool->GetSize()));
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * \details Filters image with median using plan. Image must have size given in LV_MedFiltPlanCreate. Image is
+ * passed row by row in 1D array. Output is identical to LV_MedFilt.
+ * \param[in] plan		plan created by LV_MedFiltPlanCreate
+ * \param[in] input_image		input image
+ * \param[out] output_image	pointer to output array of size of input image
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - plan is not valid
+ * \li OTHER_ERROR - filtering failed
+ * \remarks Calls with the same plan from different threads are serialized.
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltPlanExecute(MEDFILT_PLAN *plan, const UINT16* input_image, UINT16* output_image)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	bool ok;
+	if(NULL==plan || NULL==input_image || NULL==output_image)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(PLAN_MAGIC!=plan->magic)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Invalid plan"));
+		return WRONG_PARAMETER;
+	}
+	{
+		std::lock_guard<std::mutex> guard(plan->lock);
+		plan->image.tab = input_image;
+		plan->tabout = output_image;
+		ok = plan->pool->Run(plan->tasks);
+		plan->image.tab = NULL;
+		plan->tabout = NULL;
+	}
+	if(!ok)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Band filter failed"));
+		return OTHER_ERROR;
+	}
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * \details Filters view of the image with median using plan. Views must have size given in LV_MedFiltPlanCreate,
+ * they address rectangles of buffers with arbitrary row pitch, see LV_MedFiltView. Output is identical to
+ * LV_MedFiltPlanExecute of the input rectangle copied to dense array.
+ * \param[in] plan		plan created by LV_MedFiltPlanCreate
+ * \param[in] input		view of input image
+ * \param[in,out] output	view of output image, must not overlap input
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - plan is not valid, views are inconsistent or of other size than plan
+ * \li OTHER_ERROR - filtering failed
+ * \remarks Calls with the same plan from different threads are serialized. Zeros are assumed outside the input view.
+ * \see MEDFILT_VIEW
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltPlanExecuteView(MEDFILT_PLAN *plan, const MEDFILT_VIEW *input, const MEDFILT_VIEW *output)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// input view
+	unsigned short *tabout;	// first pixel of output view
+	bool ok;
+	if(NULL==plan || NULL==input || NULL==output || NULL==input->tab || NULL==output->tab)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(PLAN_MAGIC!=plan->magic)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Invalid plan"));
+		return WRONG_PARAMETER;
+	}
+	if(OK!=viewToImage(input,output,&obraz,&tabout))
+		return WRONG_PARAMETER;
+	if(obraz.rows!=plan->image.rows || obraz.cols!=plan->image.cols)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("View size differs from plan: "), pantheios::integer(obraz.rows), PSTR("x"), pantheios::integer(obraz.cols));
+		return WRONG_PARAMETER;
+	}
+	{
+		std::lock_guard<std::mutex> guard(plan->lock);
+		plan->image.tab = obraz.tab;
+		plan->image.pitch = obraz.pitch;
+		plan->image.out_pitch = obraz.out_pitch;
+		plan->tabout = tabout;
+		ok = plan->pool->Run(plan->tasks);
+		plan->image.tab = NULL;
+		plan->image.pitch = plan->image.cols;
+		plan->image.out_pitch = plan->image.cols;
+		plan->tabout = NULL;
+	}
+	if(!ok)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Band filter failed"));
+		return OTHER_ERROR;
+	}
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * \details Releases plan created by LV_MedFiltPlanCreate, stops its threads.
+ * \param[in] plan		plan, invalid after this call
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - plan is not valid
+ * \warning Plan must not be executed while it is destroyed
+ * \warning Memory of destroyed plan is freed, so destroying or executing it again is undefined and is not reliably
+ * reported as WRONG_PARAMETER. Magic is a best-effort debug check only.
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltPlanDestroy(MEDFILT_PLAN *plan)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	if(NULL==plan)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(PLAN_MAGIC!=plan->magic)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Invalid plan"));
+		return WRONG_PARAMETER;
+	}
+	FreePlan(plan);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * \details Filters stack of frames with median using plan. Frames are spread over workers and, if there are fewer
+ * frames than workers, every frame is split into row bands as well, so all workers are busy for any stack depth.
+ * \param[in] plan		plan created by LV_MedFiltPlanCreate
+ * \param[in] input_stack		nframes images of size given in LV_MedFiltPlanCreate, one after another
+ * \param[out] output_stack	output array of the same size as input_stack
+ * \param[in] nframes	number of frames in stack
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - plan is not valid
+ * \li OTHER_ERROR - filtering failed
+ * \remarks Every frame is filtered exactly as by LV_MedFiltPlanExecute.
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltPlanExecuteBatch(MEDFILT_PLAN *plan, const UINT16* input_stack, UINT16* output_stack, UINT32 nframes)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	std::vector<C_ThreadPool::TASK> tasks;	// one task per band of every frame
+	unsigned int nbands;					// bands per frame
+	bool ok;
+	if(NULL==plan || NULL==input_stack || NULL==output_stack)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(PLAN_MAGIC!=plan->magic)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Invalid plan"));
+		return WRONG_PARAMETER;
+	}
+	if(0==nframes)
+		return OK;
+	nbands = (plan->pool->GetSize() + nframes - 1)/nframes;
+	nbands = std::min(nbands,plan->image.rows);
+	try
+	{
+		tasks.reserve(static_cast<size_t>(nframes)*nbands);
+		for(unsigned int frame=0;frame<nframes;frame++)
+			for(unsigned int band=0;band<nbands;band++)
+				tasks.push_back([=](unsigned int worker) { PlanFrameBand(plan,input_stack,output_stack,frame,band,nbands,worker); });
+	}
+	catch(std::bad_alloc&)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory for tasks"));
+		return OTHER_ERROR;
+	}
+	PANTHEIOS_TRACE_DEBUG(PSTR("Frames: "), pantheios::integer(nframes), PSTR(" bands per frame: "), pantheios::integer(nbands));
+	{
+		std::lock_guard<std::mutex> guard(plan->lock);
+		ok = plan->pool->Run(tasks);
+	}
+	if(!ok)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Band filter failed"));
+		return OTHER_ERROR;
+	}
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * \details Filters stack of frames with median in one call. Equivalent to LV_MedFiltPlanCreate,
+ * LV_MedFiltPlanExecuteBatch and LV_MedFiltPlanDestroy. Use plan directly if stacks are filtered repeatedly.
+ * \param[in] input_stack		nframes images of size nrows x ncols, one after another
+ * \param[out] output_stack	output array of the same size as input_stack
+ * \param[in] nframes	number of frames in stack
+ * \param[in] nrows		number of rows of every frame
+ * \param[in] ncols		number of columns of every frame
+ * \param[in] mask		size of the mask, odd
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask or empty image
+ * \li OTHER_ERROR - threads or memory could not be allocated
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltBatch(const UINT16* input_stack, UINT16* output_stack, UINT32 nframes, UINT16 nrows, UINT16 ncols, UINT16 mask, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	MEDFILT_PLAN *plan = NULL;
+	BYTE err;
+	if(NULL==input_stack || NULL==output_stack)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	err = LV_MedFiltPlanCreate(nrows,ncols,mask,nthreads,&plan);
+	if(OK!=err)
+		return err;
+	err = LV_MedFiltPlanExecuteBatch(plan,input_stack,output_stack,nframes);
+	LV_MedFiltPlanDestroy(plan);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return err;
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+/**
+ * \file    MedianWorkspace.h
+ * \brief	Scratch memory of median engines that can be reused between calls
+ * \author  PB
+ * \date    2014/02/18
+ */
+
+#ifndef MedianWorkspace_h__
+#define MedianWorkspace_h__
+
+/**
+ * Buffers held by C_MedianWorkspace. Every engine uses its own buffers so their contents do not mix.
+ */
+enum WORKSPACE_BUFFER
+{
+	WS_WINDOW = 0,		/**< Huang engines - initial window */
+	WS_LEAVING,			/**< Huang engines - column or row leaving the window */
+	WS_ENTERING,		/**< Huang engines - column or row entering the window */
+	WS_CT_COARSE,		/**< constant time engine - coarse level of column histograms, kept zeroed between calls */
+	WS_CT_FINE,			/**< constant time engine - fine level of column histograms, kept zeroed between calls */
+	WS_CT_KERNEL,		/**< constant time engine - fine level of kernel histogram */
+	WS_BUFFERS			/**< number of buffers */
+};
+
+/**
+ * \class C_MedianWorkspace
+ *
+ * \brief Histogram and buffers used by one thread running a median engine
+ *
+ * Engines take memory from workspace instead of allocating it. If the same workspace is passed to the next call
+ * with the same mask, no allocation takes place. Buffers are zeroed only when they grow, engines that need zeroed
+ * memory on entry must leave it zeroed on exit.
+ */
+class C_MedianWorkspace
+{
+public:
+	C_MedianWorkspace() : hist(NULL), hist_deleter(NULL), hist_type(NULL)
+	{
+	}
+	~C_MedianWorkspace()
+	{
+		if(hist)
+			hist_deleter(hist);
+	}
+	/**
+	 * Returns histogram of type HIST, creates it if the workspace holds histogram of other type
+	 * \return histogram, content is undefined and must be cleared by caller
+	 * \tparam HIST	C_TwoLevelHist
+	 */
+	template<class HIST>
+	HIST& GetHist()
+	{
+		if(hist_type!=&HistDeleter<HIST>::id)
+		{
+			if(hist)
+				hist_deleter(hist);
+			hist = NULL;	// in case new throws
+			hist_type = NULL;
+			hist = new HIST;
+			hist_deleter = &HistDeleter<HIST>::Delete;
+			hist_type = &HistDeleter<HIST>::id;
+		}
+		return *static_cast<HIST*>(hist);
+	}
+	/**
+	 * Returns buffer of at least given size
+	 * \param[in] buffer	buffer identifier
+	 * \param[in] bytes		required size in bytes
+	 * \return pointer to buffer, zeroed if it has been just allocated
+	 */
+	void* GetBuffer(WORKSPACE_BUFFER buffer, size_t bytes)
+	{
+		_ASSERT(buffer<WS_BUFFERS);
+		if(buffers[buffer].size()<bytes || buffers[buffer].empty())
+			buffers[buffer].assign(std::max<size_t>(bytes,1), 0);
+		return &buffers[buffer][0];
+	}
+private:
+	/// Deletes histogram of given type. Address of static member identifies the type, identical Delete functions may be folded by linker.
+	template<class HIST>
+	struct HistDeleter
+	{
+		static void Delete(void *p) { delete static_cast<HIST*>(p); }
+		static char id;		///< address is unique for every HIST, never written, not const so that linker does not fold it
+	};
+	C_MedianWorkspace(const C_MedianWorkspace&);				// not copyable
+	C_MedianWorkspace& operator=(const C_MedianWorkspace&);
+	void *hist;											///< histogram of last used type
+	void (*hist_deleter)(void*);						///< deletes hist
+	const char *hist_type;								///< identifies type of hist, &HistDeleter<HIST>::id
+	std::vector<unsigned char> buffers[WS_BUFFERS];		///< buffers indexed by WORKSPACE_BUFFER
+};
+
+template<class HIST> char C_MedianWorkspace::HistDeleter<HIST>::id = 0;
+
+#endif // MedianWorkspace_h__
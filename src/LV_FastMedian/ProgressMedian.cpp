@@ -0,0 +1,222 @@
+/**
+ * \file    ProgressMedian.cpp
+ * \brief	Median filter reporting progress and allowing cancellation
+ * \details Image is split into chunks of PROGRESS_CHUNK rows taken by threads one by one from shared counter. Between
+ * chunks every thread checks cancel flag, the calling thread additionally reports progress through callback. After
+ * cancellation no new chunk is started, so threads stop within time of filtering one chunk.
+ * \author  PB
+ * \date    2014/03/03
+ */
+
+#include "stdafx.h"
+
+#define PROGRESS_CHUNK 16	///< number of rows filtered between checks of cancellation
+
+/**
+ * State shared by threads of LV_MedFiltProgress
+ */
+struct PROGRESS_JOB
+{
+	OBRAZ *image;						///< input image
+	unsigned short *tabout;				///< output image
+	unsigned short mask;				///< size of the mask
+	BAND_FILTER filter;					///< engine
+	unsigned int nchunks;				///< number of chunks
+	std::atomic<unsigned int> next;		///< next chunk to be filtered
+	std::atomic<unsigned int> done;		///< number of rows filtered
+	std::atomic<bool> stop;				///< cancelled or failed, no new chunk is started
+	std::atomic<bool> failed;			///< memory could not be allocated
+	volatile LONG *cancel;				///< cancel flag set by caller, may be NULL
+	MEDFILT_PROGRESS progress;			///< progress callback, may be NULL
+	void *user;							///< passed to progress
+};
+
+/**
+ * Filters chunks until all are taken or job is stopped
+ * \param[in,out] job		shared state
+ * \param[in] report		true for calling thread, it calls progress callback after every chunk
+*/
+static void ProgressWorker(PROGRESS_JOB *job, bool report)
+{
+	try
+	{
+		C_MedianWorkspace ws;	// reused by all chunks of this thread
+		while(!job->stop)
+		{
+			unsigned int chunk = job->next++;
+			if(chunk>=job->nchunks)
+				break;
+			unsigned int row_start = chunk*PROGRESS_CHUNK;
+			unsigned int row_end = std::min(row_start+PROGRESS_CHUNK,job->image->rows);
+			job->filter(job->image,job->tabout,job->mask,row_start,row_end,&ws);
+			unsigned int done = (job->done += row_end-row_start);
+			if(job->cancel && *job->cancel)
+				job->stop = true;
+			if(report && job->progress && OK!=job->progress(job->user,done,job->image->rows))
+				job->stop = true;
+		}
+	}
+	catch(std::bad_alloc&)
+	{
+		job->failed = true;
+		job->stop = true;
+	}
+}
+
+/**
+ * Filters image with median reporting progress, common part of LV_MedFiltProgress and LV_MedFiltProgressView
+ * \param[in] image		input image, pitch and out_pitch set
+ * \param[out] tabout	output image
+ * \param[in] mask		size of the mask, odd
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \param[in] progress	called by the calling thread with number of filtered rows, may be NULL
+ * \param[in] user		passed to progress
+ * \param[in] cancel	filtering stops when flag becomes non-zero, may be NULL
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li CANCELLED - cancelled by flag or callback, output is incomplete
+ * \li OTHER_ERROR - memory could not be allocated
+*/
+static BYTE ProgressImage(OBRAZ *image, UINT16 *tabout, UINT16 mask, UINT16 nthreads, MEDFILT_PROGRESS progress, void *user, volatile LONG *cancel)
+{
+	PROGRESS_JOB job;
+	std::vector<std::thread> workers;
+	unsigned int bits;	// bit depth of engine, selected for full range as image is not scanned
+	unsigned int nrows = image->rows;
+	job.image = image;
+	job.tabout = tabout;
+	job.mask = mask;
+	MEDIAN_ENGINE engine = selectEngine(mask,NULL,PROGRESS_CHUNK,bits);	// bits is set here, must be read after the call
+	job.filter = getBandFilter(engine,bits);
+	job.nchunks = (nrows+PROGRESS_CHUNK-1)/PROGRESS_CHUNK;
+	job.next = 0;
+	job.done = 0;
+	job.stop = false;
+	job.failed = false;
+	job.cancel = cancel;
+	job.progress = progress;
+	job.user = user;
+	if(0==nthreads)
+		nthreads = std::thread::hardware_concurrency();
+	nthreads = std::max(1u,std::min<unsigned int>(nthreads,job.nchunks));
+	try
+	{
+		workers.reserve(nthreads-1);
+		for(unsigned int t=0;t+1<nthreads;t++)
+			workers.push_back(std::thread([&job]() { ProgressWorker(&job,false); }));
+	}
+	catch(std::exception&)	// no resources for more threads, the others take their chunks
+	{
+	}
+	ProgressWorker(&job,true);
+	for(size_t t=0;t<workers.size();t++)
+		workers[t].join();
+	if(job.failed)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	if(job.done<nrows)	// stopped before all chunks were taken
+	{
+		PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Cancelled after rows: "), pantheios::integer(job.done.load()));
+		return CANCELLED;
+	}
+	if(progress)
+		progress(user,nrows,nrows);
+	return OK;
+}
+
+/**
+ * \details Filters image with median like LV_MedFilt, reporting progress and checking for cancellation after every
+ * 16 rows. Long runs with large masks can be aborted either by setting cancel flag from another thread or by
+ * returning non-zero from progress callback. Image is passed row by row in 1D array.
+ * \param[in] input_image		input image
+ * \param[out] output_image	pointer to output array of size of input image
+ * \param[in] nrows		number of rows
+ * \param[in] ncols		number of columns
+ * \param[in] mask		size of the mask, odd
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \param[in] progress	called by the calling thread with number of filtered rows, returns OK to continue, may be NULL
+ * \param[in] user		passed to progress
+ * \param[in] cancel	filtering stops when flag becomes non-zero, may be NULL
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask
+ * \li CANCELLED - cancelled by flag or callback, output is incomplete
+ * \li OTHER_ERROR - memory could not be allocated
+ * \remarks Progress is reported only while the calling thread filters its chunks, final call with all rows done is
+ * made after all threads finished. Zeros are assumed outside the image.
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltProgress(const UINT16* input_image, UINT16* output_image, UINT16 nrows, UINT16 ncols, UINT16 mask, UINT16 nthreads, MEDFILT_PROGRESS progress, void *user, volatile LONG *cancel)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// shallow copy of input image
+	BYTE ret;
+	if(NULL==input_image || NULL==output_image)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong mask: "), pantheios::integer(mask));
+		return WRONG_PARAMETER;
+	}
+	obraz.tab = input_image;
+	obraz.rows = nrows;
+	obraz.cols = ncols;
+	obraz.pitch = ncols;
+	obraz.out_pitch = ncols;
+	obraz.tabsize = nrows*ncols;
+	obraz.border = BORDER_ZERO;
+	obraz.border_value = 0;
+	ret = ProgressImage(&obraz,output_image,mask,nthreads,progress,user,cancel);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return ret;
+}
+
+/**
+ * \details Filters view of the image with median reporting progress and checking for cancellation, as
+ * LV_MedFiltProgress. Views address rectangles of buffers with arbitrary row pitch, see LV_MedFiltView.
+ * \param[in] input		view of input image
+ * \param[in,out] output	view of output image, the same size as input, must not overlap input
+ * \param[in] mask		size of the mask, odd
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \param[in] progress	called by the calling thread with number of filtered rows of the view, returns OK to continue, may be NULL
+ * \param[in] user		passed to progress
+ * \param[in] cancel	filtering stops when flag becomes non-zero, may be NULL
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask, empty or inconsistent views
+ * \li CANCELLED - cancelled by flag or callback, output view is incomplete
+ * \li OTHER_ERROR - memory could not be allocated
+ * \remarks Zeros are assumed outside the input view, even if the buffer contains pixels there.
+ * \see MEDFILT_VIEW
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltProgressView(const MEDFILT_VIEW *input, const MEDFILT_VIEW *output, UINT16 mask, UINT16 nthreads, MEDFILT_PROGRESS progress, void *user, volatile LONG *cancel)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// input view
+	unsigned short *tabout;	// first pixel of output view
+	BYTE ret;
+	if(NULL==input || NULL==output || NULL==input->tab || NULL==output->tab)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong mask: "), pantheios::integer(mask));
+		return WRONG_PARAMETER;
+	}
+	if(OK!=viewToImage(input,output,&obraz,&tabout))
+		return WRONG_PARAMETER;
+	ret = ProgressImage(&obraz,tabout,mask,nthreads,progress,user,cancel);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return ret;
+}
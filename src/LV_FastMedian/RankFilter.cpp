@@ -0,0 +1,310 @@
+/**
+ * \file    RankFilter.cpp
+ * \brief	Rank (percentile) filters, several ranks computed from one sliding histogram
+ * \details Window traverses the band in serpentine order as in FastMedian_HuangSerpentine. For every requested rank
+ * its value and number of pixels below it are tracked, after each histogram update every rank is moved by
+ * C_TwoLevelHist::Recenter. Cost of additional rank is small compared to histogram update.
+ * \author  PB
+ * \date    2014/02/24
+ */
+
+#include "stdafx.h"
+
+/**
+ * Removes one column (or row) of the window from histogram and adds another one, updates counters of all ranks
+ * \param[in,out] hist		histogram of the window
+ * \param[in] out_vals		pixels leaving the window
+ * \param[in] in_vals		pixels entering the window
+ * \param[in] stride		distance between consecutive pixels in out_vals and in_vals
+ * \param[in] mask			number of pixels in out_vals and in_vals
+ * \param[in] val			current values of ranks
+ * \param[in,out] below		number of pixels in window smaller than val, for every rank
+ * \param[in] nranks		number of ranks
+ * \tparam HIST				C_TwoLevelHist
+*/
+template<class HIST>
+static inline void RankSwap(HIST &hist, const unsigned short *out_vals, const unsigned short *in_vals, unsigned int stride, unsigned short mask, const unsigned short *val, unsigned int *below, unsigned int nranks)
+{
+	for(unsigned int l=0;l<mask*stride;l+=stride)
+	{
+		unsigned short x = out_vals[l];
+		unsigned short y = in_vals[l];
+		hist.Remove(x);
+		hist.Add(y);
+		for(unsigned int i=0;i<nranks;i++)
+			below[i] += (y<val[i]) - (x<val[i]);
+	}
+}
+
+/**
+ * Filters band of rows with several rank filters at once
+ * \param[in] image		input image
+ * \param[out] tabout	output, first pixel of nranks images of size of input image
+ * \param[in] out_pitch	row pitch of every output image
+ * \param[in] mask		size of the mask, odd and square
+ * \param[in] ranks		ranks to compute, 0 is minimum and mask*mask-1 maximum
+ * \param[in] row_start	first row of the band to be filtered
+ * \param[in] row_end	one past the last row of the band to be filtered
+ * \param[in] ws		workspace providing histogram and buffers
+ * \tparam HIST			C_TwoLevelHist
+ * \remarks For rank mask*mask/2 output is identical to FastMedian_Huang. Pixels outside the image follow image->border.
+*/
+template<class HIST>
+static void RankBand(OBRAZ *image, const std::vector<unsigned short*> &tabout, const std::vector<unsigned int> &out_pitch, unsigned short mask, const std::vector<unsigned int> &ranks, unsigned int row_start, unsigned int row_end, C_MedianWorkspace *ws)
+{
+	unsigned int nranks = static_cast<unsigned int>(ranks.size());
+	std::vector<unsigned short> val(nranks);	// current value of every rank
+	std::vector<unsigned int> below(nranks);	// pixels smaller than val
+	unsigned short *window, *leaving, *entering;
+	const unsigned short *out_vals, *in_vals;	// pixels passed to RankSwap, buffers above or image itself
+	unsigned int stride;
+	int cols = static_cast<int>(image->cols);
+	int bok_maski = (mask-1)/2;
+	int r, k, step, i;
+	bool rows_inside;
+
+	if(row_start>=row_end || 0==image->cols || 0==nranks)
+		return;
+	HIST &hist = ws->GetHist<HIST>();
+	leaving = static_cast<unsigned short*>(ws->GetBuffer(WS_LEAVING,mask*sizeof(unsigned short)));
+	entering = static_cast<unsigned short*>(ws->GetBuffer(WS_ENTERING,mask*sizeof(unsigned short)));
+	window = static_cast<unsigned short*>(ws->GetBuffer(WS_WINDOW,static_cast<unsigned int>(mask)*mask*sizeof(unsigned short)));
+	// initial window on the left side of the first row
+	r = static_cast<int>(row_start);
+	k = 0;
+	hist.Clear();
+	for(i=0;i<mask;i++)
+		CopyOneRow(image,mask,r-bok_maski+i,-bok_maski,window+i*mask);
+	for(unsigned int a=0;a<static_cast<unsigned int>(mask)*mask;a++)
+		hist.Add(window[a]);
+	for(i=0;i<static_cast<int>(nranks);i++)
+		val[i] = hist.GetRank(ranks[i],below[i]);
+	step = 1;
+	for(;;)
+	{
+		for(i=0;i<static_cast<int>(nranks);i++)
+			tabout[i][r*out_pitch[i] + k] = val[i];
+		rows_inside = r>=bok_maski && r+bok_maski<static_cast<int>(image->rows);
+		// ---------- slide along the row ----------
+		while( (step>0 && k+1<cols) || (step<0 && k>0) )
+		{
+			int kout = step>0 ? k-bok_maski : k+bok_maski;
+			int kin = step>0 ? k+bok_maski+1 : k-bok_maski-1;
+			if(rows_inside && std::min(kout,kin)>=0 && std::max(kout,kin)<cols)	// interior - columns read in place
+			{
+				out_vals = image->tab + (r-bok_maski)*image->pitch + kout;
+				in_vals = image->tab + (r-bok_maski)*image->pitch + kin;
+				stride = image->pitch;
+			}
+			else
+			{
+				CopyOneColumn(image,mask,r-bok_maski,kout,leaving);
+				CopyOneColumn(image,mask,r-bok_maski,kin,entering);
+				out_vals = leaving;
+				in_vals = entering;
+				stride = 1;
+			}
+			RankSwap(hist,out_vals,in_vals,stride,mask,&val[0],&below[0],nranks);
+			k += step;
+			for(i=0;i<static_cast<int>(nranks);i++)
+			{
+				hist.Recenter(ranks[i],val[i],below[i]);
+				tabout[i][r*out_pitch[i] + k] = val[i];
+			}
+		}
+		if(r+1>=static_cast<int>(row_end))
+			break;
+		// ---------- slide one row down and reverse direction ----------
+		CopyOneRow(image,mask,r-bok_maski,k-bok_maski,leaving);
+		CopyOneRow(image,mask,r+bok_maski+1,k-bok_maski,entering);
+		RankSwap(hist,leaving,entering,1,mask,&val[0],&below[0],nranks);
+		for(i=0;i<static_cast<int>(nranks);i++)
+			hist.Recenter(ranks[i],val[i],below[i]);
+		r++;
+		step = -step;
+	}
+}
+
+/**
+ * Converts percentile to rank in window of n pixels
+ * \param[in] percentile	percentile in range [0,100]
+ * \param[in] n				number of pixels in window
+ * \return rank, 0 for 0%, n-1 for 100% and n/2 for 50% if n is odd
+*/
+static unsigned int percentileToRank(double percentile, unsigned int n)
+{
+	return static_cast<unsigned int>(floor(percentile/100.0*(n-1) + 0.5));
+}
+
+/**
+ * Filters image with several rank filters, common part of LV_RankFilt and LV_RankFiltView
+ * \param[in] image			input image, pitch set
+ * \param[out] tabout		first pixel of every output image
+ * \param[in] out_pitch		row pitch of every output image
+ * \param[in] mask			size of the mask, odd
+ * \param[in] percentiles	percentiles to compute, as many as output images
+ * \param[in] nthreads		number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li WRONG_PARAMETER - percentile out of range
+ * \li OTHER_ERROR - memory could not be allocated
+*/
+static BYTE RankImage(OBRAZ *image, const std::vector<unsigned short*> &tabout, const std::vector<unsigned int> &out_pitch, UINT16 mask, const double* percentiles, UINT16 nthreads)
+{
+	std::vector<unsigned int> ranks;
+	unsigned int n = static_cast<unsigned int>(mask)*mask;
+	for(unsigned int i=0;i<tabout.size();i++)
+	{
+		if(!(percentiles[i]>=0.0 && percentiles[i]<=100.0))	// also NaN
+		{
+			PANTHEIOS_TRACE_ERROR(PSTR("Percentile out of range at "), pantheios::integer(i));
+			return WRONG_PARAMETER;
+		}
+		ranks.push_back(percentileToRank(percentiles[i],n));
+	}
+	std::atomic<bool> failed(false);	// any band failed to allocate memory
+	ParallelBands(image->rows,nthreads,[&](unsigned int row_start, unsigned int row_end)
+	{
+		try
+		{
+			C_MedianWorkspace ws;
+			if(n<65536)
+				RankBand< C_TwoLevelHist<16,unsigned short> >(image,tabout,out_pitch,mask,ranks,row_start,row_end,&ws);
+			else
+				RankBand< C_TwoLevelHist<16,unsigned int> >(image,tabout,out_pitch,mask,ranks,row_start,row_end,&ws);
+		}
+		catch(std::bad_alloc&)
+		{
+			failed = true;
+		}
+	});
+	if(failed)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	return OK;
+}
+
+/**
+ * \details Filters image with several rank filters in one pass. For every percentile p output image contains value
+ * of rank round(p/100*(mask*mask-1)) in the window: 0 gives minimum, 100 maximum and 50 median (LV_MedFilt).
+ * Image is passed row by row in 1D array.
+ * \param[in] input_image		input image
+ * \param[out] output_images	output array of npercentiles*nrows*ncols, image for percentiles[0] first
+ * \param[in] nrows		number of rows
+ * \param[in] ncols		number of columns
+ * \param[in] mask		size of the mask, odd
+ * \param[in] percentiles	percentiles to compute, each in range [0,100]
+ * \param[in] npercentiles	number of percentiles
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask, no percentiles or percentile out of range
+ * \li OTHER_ERROR - memory could not be allocated
+ * \remarks Zeros are assumed outside the image as in LV_MedFilt.
+*/
+extern "C" __declspec(dllexport) BYTE LV_RankFilt(const UINT16* input_image, UINT16* output_images, UINT16 nrows, UINT16 ncols, UINT16 mask, const double* percentiles, UINT16 npercentiles, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// shallow copy of input image
+	std::vector<unsigned short*> tabout;	// output images one after another
+	std::vector<unsigned int> out_pitch;
+	BYTE ret;
+	if(NULL==input_image || NULL==output_images || NULL==percentiles)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2 || 0==npercentiles)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong mask or number of percentiles: "), pantheios::integer(mask), PSTR(" "), pantheios::integer(npercentiles));
+		return WRONG_PARAMETER;
+	}
+	obraz.tab = input_image;
+	obraz.rows = nrows;
+	obraz.cols = ncols;
+	obraz.pitch = ncols;
+	obraz.out_pitch = ncols;
+	obraz.tabsize = nrows*ncols;
+	obraz.border = BORDER_ZERO;
+	obraz.border_value = 0;
+	try
+	{
+		for(unsigned int i=0;i<npercentiles;i++)
+			tabout.push_back(output_images + static_cast<size_t>(i)*nrows*ncols);
+		out_pitch.assign(npercentiles,ncols);
+	}
+	catch(std::bad_alloc&)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	ret = RankImage(&obraz,tabout,out_pitch,mask,percentiles,nthreads);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return ret;
+}
+
+/**
+ * \details Filters view of the image with several rank filters in one pass, as LV_RankFilt. Every percentile is
+ * written to its own output view, views address rectangles of buffers with arbitrary row pitch, see LV_MedFiltView.
+ * \param[in] input			view of input image
+ * \param[in,out] outputs	npercentiles views of output images, the same size as input, must not overlap input nor each other
+ * \param[in] mask			size of the mask, odd
+ * \param[in] percentiles	percentiles to compute, each in range [0,100]
+ * \param[in] npercentiles	number of percentiles
+ * \param[in] nthreads		number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask, no percentiles, percentile out of range, empty or inconsistent views
+ * \li OTHER_ERROR - memory could not be allocated
+ * \remarks Zeros are assumed outside the input view, even if the buffer contains pixels there.
+ * \see MEDFILT_VIEW
+*/
+extern "C" __declspec(dllexport) BYTE LV_RankFiltView(const MEDFILT_VIEW *input, const MEDFILT_VIEW *outputs, UINT16 mask, const double* percentiles, UINT16 npercentiles, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// input view
+	unsigned short *first;	// first pixel of output view
+	std::vector<unsigned short*> tabout;
+	std::vector<unsigned int> out_pitch;
+	BYTE ret;
+	if(NULL==input || NULL==outputs || NULL==percentiles || NULL==input->tab)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2 || 0==npercentiles)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong mask or number of percentiles: "), pantheios::integer(mask), PSTR(" "), pantheios::integer(npercentiles));
+		return WRONG_PARAMETER;
+	}
+	try
+	{
+		for(unsigned int i=0;i<npercentiles;i++)
+		{
+			if(NULL==outputs[i].tab)
+			{
+				PANTHEIOS_TRACE_CRITICAL(PSTR("NULL output view at "), pantheios::integer(i));
+				return NULL_POINTER;
+			}
+			if(OK!=viewToImage(input,&outputs[i],&obraz,&first))
+				return WRONG_PARAMETER;
+			tabout.push_back(first);
+			out_pitch.push_back(outputs[i].pitch);
+		}
+	}
+	catch(std::bad_alloc&)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	ret = RankImage(&obraz,tabout,out_pitch,mask,percentiles,nthreads);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return ret;
+}
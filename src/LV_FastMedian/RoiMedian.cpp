@@ -0,0 +1,144 @@
+/**
+ * \file    RoiMedian.cpp
+ * \brief	Incremental median filtering of frames changed only inside some rectangles
+ * \details Output pixel depends only on the input pixels under the mask, so if input changed inside a rectangle only
+ * the rectangle enlarged by mask/2 has to be filtered again. Enlarged rectangles that overlap are merged, then every
+ * rectangle is filtered by serpentine Huang restricted to its columns and split into bands of rows between threads.
+ * \author  PB
+ * \date    2014/02/28
+ */
+
+#include "stdafx.h"
+
+/**
+ * Rectangle of output pixels to be filtered again, [row_start,row_end) x [col_start,col_end)
+ */
+struct MEDFILT_RECT
+{
+	unsigned int row_start;		///< first row
+	unsigned int row_end;		///< one past the last row
+	unsigned int col_start;		///< first column
+	unsigned int col_end;		///< one past the last column
+};
+
+/**
+ * Merges overlapping rectangles into their bounding box until all rectangles are disjoint
+ * \param[in,out] rects	rectangles
+ * \remarks Disjoint rectangles can be filtered in any order and in parallel without writing the same pixel twice
+*/
+static void MergeRects(std::vector<MEDFILT_RECT> &rects)
+{
+	bool merged = true;
+	while(merged)
+	{
+		merged = false;
+		for(size_t i=0;i<rects.size() && !merged;i++)
+			for(size_t j=i+1;j<rects.size() && !merged;j++)
+			{
+				MEDFILT_RECT &a = rects[i];
+				const MEDFILT_RECT &b = rects[j];
+				if(a.row_start<b.row_end && b.row_start<a.row_end && a.col_start<b.col_end && b.col_start<a.col_end)
+				{
+					a.row_start = std::min(a.row_start,b.row_start);
+					a.row_end = std::max(a.row_end,b.row_end);
+					a.col_start = std::min(a.col_start,b.col_start);
+					a.col_end = std::max(a.col_end,b.col_end);
+					rects.erase(rects.begin()+j);
+					merged = true;
+				}
+			}
+	}
+}
+
+/**
+ * \details Updates median filtered frame after input changed inside given rectangles. output_image must hold result
+ * of LV_MedFilt of previous frame and input_image must be equal to previous frame outside the rectangles. Only
+ * output pixels whose mask covers any of rectangles are computed again, the result is identical to LV_MedFilt of
+ * input_image. Image is passed row by row in 1D array.
+ * \param[in] input_image		new frame
+ * \param[in,out] output_image	median of previous frame, updated to median of input_image
+ * \param[in] nrows		number of rows
+ * \param[in] ncols		number of columns
+ * \param[in] mask		size of the mask, odd
+ * \param[in] rects		changed rectangles, 4 values per rectangle: first row, first column, number of rows and number
+ * of columns. Parts outside the image are ignored.
+ * \param[in] nrects	number of rectangles
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - even mask
+ * \li OTHER_ERROR - memory could not be allocated
+ * \remarks Zeros are assumed outside the image as in LV_MedFilt.
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltUpdate(const UINT16* input_image, UINT16* output_image, UINT16 nrows, UINT16 ncols, UINT16 mask, const UINT16* rects, UINT16 nrects, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// shallow copy of input image
+	std::vector<MEDFILT_RECT> dirty;	// rectangles of output to be filtered
+	unsigned int bok_maski = (mask-1)/2;
+	if(NULL==input_image || NULL==output_image || (NULL==rects && nrects>0))
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong mask: "), pantheios::integer(mask));
+		return WRONG_PARAMETER;
+	}
+	obraz.tab = input_image;
+	obraz.rows = nrows;
+	obraz.cols = ncols;
+	obraz.pitch = ncols;
+	obraz.out_pitch = ncols;
+	obraz.tabsize = nrows*ncols;
+	obraz.border = BORDER_ZERO;
+	obraz.border_value = 0;
+	try
+	{
+		for(unsigned int i=0;i<nrects;i++)
+		{
+			const UINT16 *rc = rects + 4*i;	// row, col, rows, cols
+			MEDFILT_RECT d;
+			if(0==rc[2] || 0==rc[3] || rc[0]>=nrows || rc[1]>=ncols)
+				continue;
+			d.row_start = rc[0]>bok_maski ? rc[0]-bok_maski : 0;
+			d.col_start = rc[1]>bok_maski ? rc[1]-bok_maski : 0;
+			d.row_end = std::min<unsigned int>(rc[0]+rc[2]+bok_maski,nrows);
+			d.col_end = std::min<unsigned int>(rc[1]+rc[3]+bok_maski,ncols);
+			dirty.push_back(d);
+		}
+		MergeRects(dirty);
+	}
+	catch(std::bad_alloc&)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	std::atomic<bool> failed(false);	// any band failed to allocate memory
+	for(size_t i=0;i<dirty.size();i++)
+	{
+		const MEDFILT_RECT &d = dirty[i];
+		ParallelBands(d.row_end-d.row_start,nthreads,[&](unsigned int row_start, unsigned int row_end)
+		{
+			try
+			{
+				C_MedianWorkspace ws;
+				FastMedian_HuangRect(&obraz,output_image,mask,d.row_start+row_start,d.row_start+row_end,d.col_start,d.col_end,&ws);
+			}
+			catch(std::bad_alloc&)
+			{
+				failed = true;
+			}
+		});
+	}
+	if(failed)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
@@ -0,0 +1,251 @@
+/**
+ * \file    SortingNetworkMedian.cpp
+ * \brief	Median filter for small masks (3x3, 5x5, 7x7) based on min/max sorting networks
+ * \details Selection network is derived from Batcher odd-even merge sort and pruned to comparators that have
+ * influence on the median. The same network is applied to 16 (AVX2), 8 (SSE4.1) or 1 (scalar) pixels at once,
+ * instruction set is selected at runtime.
+ * \author  PB
+ * \date    2014/02/14
+ */
+
+#include "stdafx.h"
+
+/// largest number of elements sorted by network
+#define NETWORK_MAX_SIZE (NETWORK_MAX_MASK*NETWORK_MAX_MASK)
+
+/**
+ * Single comparator of sorting network. After it element a holds minimum and b maximum.
+ * Outputs that are not needed by median are not computed.
+ */
+struct COMPARATOR
+{
+	unsigned char a;	///< index of element receiving minimum
+	unsigned char b;	///< index of element receiving maximum
+	bool need_min;		///< minimum is used later
+	bool need_max;		///< maximum is used later
+};
+
+/**
+ * Median selection network for n elements
+ */
+struct SELECTION_NETWORK
+{
+	std::vector<COMPARATOR> ops;	///< comparators in order of execution
+	unsigned int n;					///< number of elements
+};
+
+/**
+ * Builds median selection network for n elements.
+ * Batcher odd-even merge sort is generated for next power of two, comparators touching elements above n
+ * are removed (these elements behave as +inf). Then comparators not leading to element n/2 are pruned.
+ * \param[in] n		number of elements, not greater than NETWORK_MAX_SIZE
+ * \param[out] net	network
+*/
+static void BuildSelectionNetwork(unsigned int n, SELECTION_NETWORK &net)
+{
+	std::vector<COMPARATOR> all;
+	COMPARATOR op;
+	unsigned int p2, p, k, j, i;
+	bool needed[64];
+
+	for(p2=1;p2<n;p2<<=1);
+	// Batcher odd-even merge sort, iterative form
+	for(p=1;p<p2;p<<=1)
+		for(k=p;k>=1;k>>=1)
+			for(j=k%p;j+k<p2;j+=2*k)
+				for(i=0;i<k && i+j+k<p2;i++)
+					if((i+j)/(2*p)==(i+j+k)/(2*p) && i+j+k<n)
+					{
+						op.a = static_cast<unsigned char>(i+j);
+						op.b = static_cast<unsigned char>(i+j+k);
+						op.need_min = op.need_max = true;
+						all.push_back(op);
+					}
+	// backward pruning
+	memset(needed, 0, sizeof(needed));
+	needed[n/2] = true;
+	net.ops.clear();
+	net.n = n;
+	for(i=static_cast<unsigned int>(all.size());i-->0;)
+	{
+		op = all[i];
+		op.need_min = needed[op.a];
+		op.need_max = needed[op.b];
+		if(op.need_min || op.need_max)
+		{
+			needed[op.a] = needed[op.b] = true;
+			net.ops.push_back(op);
+		}
+	}
+	std::reverse(net.ops.begin(),net.ops.end());
+}
+
+/**
+ * Networks for all supported masks, built once when DLL is loaded
+ */
+struct NETWORK_TABLE
+{
+	SELECTION_NETWORK net[NETWORK_MAX_MASK+1];	///< network for mask m at index m, odd masks from 3 only
+	NETWORK_TABLE()
+	{
+		for(unsigned int m=3;m<=NETWORK_MAX_MASK;m+=2)
+			BuildSelectionNetwork(m*m,net[m]);
+	}
+};
+
+/// selection networks shared by all calls
+static const NETWORK_TABLE networks;
+
+/// Scalar implementation of network operations, one pixel at once
+struct ISA_SCALAR
+{
+	typedef unsigned short T;
+	enum { W = 1 };
+	static T load(const unsigned short *p) { return *p; }
+	static void store(unsigned short *p, T v) { *p = v; }
+	static T vmin(T a, T b) { return a<b ? a : b; }
+	static T vmax(T a, T b) { return a<b ? b : a; }
+	static void finish() {}
+};
+
+/// SSE4.1 implementation of network operations, 8 pixels at once
+struct ISA_SSE41
+{
+	typedef __m128i T;
+	enum { W = 8 };
+	static T load(const unsigned short *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+	static void store(unsigned short *p, T v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+	static T vmin(T a, T b) { return _mm_min_epu16(a,b); }
+	static T vmax(T a, T b) { return _mm_max_epu16(a,b); }
+	static void finish() {}
+};
+
+/// AVX2 implementation of network operations, 16 pixels at once
+struct ISA_AVX2
+{
+	typedef __m256i T;
+	enum { W = 16 };
+	static T load(const unsigned short *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+	static void store(unsigned short *p, T v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+	static T vmin(T a, T b) { return _mm256_min_epu16(a,b); }
+	static T vmax(T a, T b) { return _mm256_max_epu16(a,b); }
+	static void finish() { _mm256_zeroupper(); }	// avoid SSE/AVX transition penalty in caller
+};
+
+/**
+ * Applies selection network to set of elements
+ * \param[in] net		network
+ * \param[in,out] v		elements, median is placed at v[net.n/2]
+*/
+template<class ISA>
+static inline void ApplyNetwork(const SELECTION_NETWORK &net, typename ISA::T *v)
+{
+	const COMPARATOR *op = &net.ops[0];
+	const COMPARATOR *end = op + net.ops.size();
+	for(;op<end;++op)
+	{
+		typename ISA::T a = v[op->a];
+		typename ISA::T b = v[op->b];
+		if(op->need_min)
+			v[op->a] = ISA::vmin(a,b);
+		if(op->need_max)
+			v[op->b] = ISA::vmax(a,b);
+	}
+}
+
+/**
+ * Computes median at [r,k] for pixels near the border, pixels outside the image follow image->border
+ * \param[in] image		input image
+ * \param[in] mask		size of the mask
+ * \param[in] net		selection network for mask*mask elements
+ * \param[in] r			row
+ * \param[in] k			column
+ * \return median
+*/
+static unsigned short NetworkBorderPixel(OBRAZ *image, unsigned short mask, const SELECTION_NETWORK &net, int r, int k)
+{
+	unsigned short v[NETWORK_MAX_SIZE];
+	int bok_maski = (mask-1)/2;
+	for(int dr=-bok_maski;dr<=bok_maski;dr++)
+		CopyOneRow(image,mask,r+dr,k-bok_maski,v+(dr+bok_maski)*mask);
+	ApplyNetwork<ISA_SCALAR>(net,v);
+	return v[net.n/2];
+}
+
+/**
+ * Filters band of rows with sorting network using instruction set ISA
+ * \param[in] image		input image
+ * \param[out] tabout	pointer to output array of size of input image
+ * \param[in] mask		size of the mask, 3, 5 or 7
+ * \param[in] net		selection network for mask*mask elements
+ * \param[in] row_start	first row of the band to be filtered
+ * \param[in] row_end	one past the last row of the band to be filtered
+ * \remarks Interior is computed ISA::W pixels at once, pixels closer than mask/2 to the border and row tails
+ * narrower than ISA::W are computed by scalar network with border handling (CopyOneRow).
+*/
+template<class ISA>
+static void NetworkBand(OBRAZ *image, unsigned short *tabout, unsigned short mask, const SELECTION_NETWORK &net, unsigned int row_start, unsigned int row_end)
+{
+	typename ISA::T v[NETWORK_MAX_SIZE];
+	int bok_maski = (mask-1)/2;
+	int rows = static_cast<int>(image->rows);
+	int cols = static_cast<int>(image->cols);
+	int r, k, dr, dc, l;
+
+	for(r=static_cast<int>(row_start);r<static_cast<int>(row_end);r++)
+	{
+		unsigned short *out = tabout + r*image->out_pitch;
+		k = 0;
+		if(r>=bok_maski && r+bok_maski<rows)	// whole mask fits vertically
+		{
+			for(;k<bok_maski && k<cols;k++)
+				out[k] = NetworkBorderPixel(image,mask,net,r,k);
+			const unsigned short *top = image->tab + (r-bok_maski)*image->pitch;
+			for(;k+ISA::W+bok_maski<=cols;k+=ISA::W)
+			{
+				for(dr=0,l=0;dr<mask;dr++)
+					for(dc=-bok_maski;dc<=bok_maski;dc++)
+						v[l++] = ISA::load(top + dr*image->pitch + k + dc);
+				ApplyNetwork<ISA>(net,v);
+				ISA::store(out+k,v[net.n/2]);
+			}
+		}
+		for(;k<cols;k++)
+			out[k] = NetworkBorderPixel(image,mask,net,r,k);
+	}
+	ISA::finish();
+}
+
+/**
+ * Filters image with median using min/max sorting networks, intended for small masks.
+ * \param[in] image		input image
+ * \param[out] tabout	pointer to output array of size of input image
+ * \param[in] mask		size of the mask, odd and square
+ * \param[in] row_start	first row of the band to be filtered
+ * \param[in] row_end	one past the last row of the band to be filtered
+ * \param[in] ws		workspace, used only by fallback to FastMedian_Huang
+ * \remarks Masks 3, 5 and 7 are supported, for other masks FastMedian_Huang is called. Networks are built once at load. AVX2 is used if available,
+ * then SSE4.1, otherwise the same network is evaluated on scalars. Output is identical to FastMedian_Huang.
+*/
+void FastMedian_SortingNetwork(	OBRAZ *image,
+								unsigned short *tabout,
+								unsigned short mask,
+								unsigned int row_start,
+								unsigned int row_end,
+								C_MedianWorkspace *ws)
+{
+	unsigned int features = getCpuFeatures();
+
+	if(mask<3 || mask>NETWORK_MAX_MASK || 0==mask%2)
+	{
+		FastMedian_Huang(image,tabout,mask,row_start,row_end,ws);
+		return;
+	}
+	const SELECTION_NETWORK &net = networks.net[mask];
+	if(features & CPU_AVX2)
+		NetworkBand<ISA_AVX2>(image,tabout,mask,net,row_start,row_end);
+	else if(features & CPU_SSE41)
+		NetworkBand<ISA_SSE41>(image,tabout,mask,net,row_start,row_end);
+	else
+		NetworkBand<ISA_SCALAR>(image,tabout,mask,net,row_start,row_end);
+}
@@ -0,0 +1,162 @@
+/**
+ * \file    StreamMedian.cpp
+ * \brief	Median filter of images that do not fit in memory, rows are streamed in strips
+ * \details Rows are requested from MEDFILT_SOURCE strip by strip and filtered rows are passed to MEDFILT_SINK.
+ * Only strip_rows+mask-1 input rows and the same number of output rows are resident. Every strip together with its
+ * halo (mask/2 rows above and below) is presented to engines as ordinary OBRAZ, filtered rows are at least mask/2
+ * rows away from the edges of this view unless the edge is the edge of the image, so engines and border modes work
+ * unchanged and output is identical to filtering the whole image at once.
+ * \author  PB
+ * \date    2014/02/20
+ */
+
+#include "stdafx.h"
+
+/**
+ * Strip currently filtered by worker threads
+ */
+struct STREAM_STRIP
+{
+	OBRAZ view;							///< strip with halo
+	unsigned short *tabout;				///< output of size of view
+	unsigned short mask;				///< size of the mask
+	BAND_FILTER filter;					///< engine
+	unsigned int row_start;				///< first row of view to be filtered
+	unsigned int row_end;				///< one past last row of view to be filtered
+	unsigned int nbands;				///< number of bands the strip is split into
+	C_MedianWorkspace *workspaces;		///< one workspace per worker
+};
+
+/**
+ * Filters one band of the strip
+ * \param[in] strip		strip
+ * \param[in] band		band index
+ * \param[in] worker	index of worker running the band, selects workspace
+*/
+static void StripBand(STREAM_STRIP *strip, unsigned int band, unsigned int worker)
+{
+	unsigned int n = strip->row_end - strip->row_start;
+	unsigned int row_start = strip->row_start + static_cast<unsigned int>(static_cast<unsigned long long>(n)*band/strip->nbands);
+	unsigned int row_end = strip->row_start + static_cast<unsigned int>(static_cast<unsigned long long>(n)*(band+1)/strip->nbands);
+	strip->filter(&strip->view,strip->tabout,strip->mask,row_start,row_end,&strip->workspaces[worker]);
+}
+
+/**
+ * \details Filters image of any height with median reading and writing rows through callbacks. Image is read in
+ * strips of strip_rows rows, every strip is filtered by nthreads threads and passed to sink before the next one
+ * is read. Every image row is read from source exactly once and written to sink exactly once, in order.
+ * \param[in] nrows		number of rows of the image
+ * \param[in] ncols		number of columns of the image
+ * \param[in] mask		size of the mask, odd
+ * \param[in] strip_rows	number of rows filtered at once
+ * \param[in] border		border mode, one of BORDER_MODE
+ * \param[in] border_value	value outside the image for BORDER_CONSTANT
+ * \param[in] source		provides input rows
+ * \param[in] sink		receives filtered rows
+ * \param[in] user		passed to source and sink
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL callback passed to function
+ * \li WRONG_PARAMETER - even mask, unknown border, empty image or strip with halo exceeding 2^31 pixels
+ * \li OTHER_ERROR - threads or memory could not be allocated
+ * \li any other code returned by source or sink
+ * \remarks Resident memory is 2*(strip_rows+mask-1)*ncols pixels plus engine workspaces.
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltStream(UINT64 nrows, UINT32 ncols, UINT16 mask, UINT32 strip_rows, UINT16 border, UINT16 border_value, MEDFILT_SOURCE source, MEDFILT_SINK sink, void *user, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	STREAM_STRIP strip;						// strip shared with workers
+	C_ThreadPool *pool = NULL;
+	C_MedianWorkspace *workspaces = NULL;
+	std::vector<C_ThreadPool::TASK> tasks;	// one task per band, built once
+	std::vector<UINT16> input, output;		// strip with halo
+	UINT64 bok_maski = (mask-1)/2;			// halo
+	UINT64 s, e;							// rows of image filtered in current strip [s,e)
+	UINT64 buf_first = 0, buf_last = 0;		// rows of image held in input [buf_first,buf_last)
+	UINT64 need;							// one past last row needed by current strip
+	UINT64 buf_rows;						// capacity of input in rows
+	BYTE err = OK;
+
+	if(NULL==source || NULL==sink)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	buf_rows = std::min<UINT64>(static_cast<UINT64>(strip_rows) + 2*bok_maski, nrows);
+	if(0==mask%2 || border>BORDER_CONSTANT || 0==nrows || 0==ncols || 0==strip_rows || buf_rows*ncols>0x7FFFFFFF)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong parameters: mask "), pantheios::integer(mask), PSTR(" border "), pantheios::integer(border), PSTR(" strip "), pantheios::integer(strip_rows));
+		return WRONG_PARAMETER;
+	}
+	try
+	{
+		input.resize(static_cast<size_t>(buf_rows*ncols));
+		output.resize(static_cast<size_t>(buf_rows*ncols));
+		pool = new C_ThreadPool(nthreads);
+		workspaces = new C_MedianWorkspace[pool->GetSize()];
+		strip.nbands = std::min(pool->GetSize(),strip_rows);
+		for(unsigned int band=0;band<strip.nbands;band++)
+			tasks.push_back([&strip,band](unsigned int worker) { StripBand(&strip,band,worker); });
+	}
+	catch(std::exception &ex)	// bad_alloc or system_error
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Stream not started: "), ex.what());
+		delete pool;
+		delete[] workspaces;
+		return OTHER_ERROR;
+	}
+	strip.view.tab = &input[0];
+	strip.view.cols = ncols;
+	strip.view.pitch = ncols;
+	strip.view.out_pitch = ncols;
+	strip.view.border = static_cast<BORDER_MODE>(border);
+	strip.view.border_value = border_value;
+	strip.tabout = &output[0];
+	strip.mask = mask;
+	strip.filter = getBandFilter(getDefaultEngine(mask),16);
+	strip.workspaces = workspaces;
+
+	for(s=0;s<nrows && OK==err;s=e)
+	{
+		e = std::min<UINT64>(s+strip_rows,nrows);
+		need = std::min<UINT64>(e+bok_maski,nrows);
+		// ---------- keep halo of previous strip, read new rows after it ----------
+		UINT64 first = s>bok_maski ? s-bok_maski : 0;
+		if(first>buf_first)
+		{
+			memmove(&input[0], &input[static_cast<size_t>((first-buf_first)*ncols)], static_cast<size_t>((buf_last-first)*ncols)*sizeof(UINT16));
+			buf_first = first;
+		}
+		if(need>buf_last)
+		{
+			err = source(user,buf_last,static_cast<UINT32>(need-buf_last),&input[static_cast<size_t>((buf_last-buf_first)*ncols)]);
+			if(OK!=err)
+			{
+				PANTHEIOS_TRACE_ERROR(PSTR("Source failed at row "), pantheios::integer(buf_last));
+				break;
+			}
+			buf_last = need;
+		}
+		// ---------- filter strip ----------
+		strip.view.rows = static_cast<unsigned int>(buf_last-buf_first);
+		strip.view.tabsize = strip.view.rows*ncols;
+		strip.row_start = static_cast<unsigned int>(s-buf_first);
+		strip.row_end = static_cast<unsigned int>(e-buf_first);
+		if(!pool->Run(tasks))
+		{
+			PANTHEIOS_TRACE_CRITICAL(PSTR("Band filter failed"));
+			err = OTHER_ERROR;
+			break;
+		}
+		err = sink(user,s,static_cast<UINT32>(e-s),&output[static_cast<size_t>(strip.row_start)*ncols]);
+		if(OK!=err)
+			PANTHEIOS_TRACE_ERROR(PSTR("Sink failed at row "), pantheios::integer(s));
+	}
+
+	delete pool;
+	delete[] workspaces;
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return err;
+}
@@ -0,0 +1,327 @@
+/**
+ * \file    TemporalMedian.cpp
+ * \brief	Per-pixel median over sliding window of frames
+ * \details Every pixel keeps values from the last window frames in a sorted array. When a frame enters, value of
+ * the oldest frame is found by binary search and the hole left by it is moved to the place of the new value, so
+ * one update costs O(log window) plus number of values between old and new one. Arrays of neighbouring pixels are
+ * adjacent in memory and pixels are processed in tiles of TM_TILE pixels.
+ * \author  PB
+ * \date    2014/02/21
+ */
+
+#include "stdafx.h"
+
+/// marks valid temporal median state, cleared on destruction. Best-effort debug check only, destroyed state is freed so stale pointer is not reliably detected
+#define TEMPORAL_MAGIC 0x544D4544
+/// number of pixels processed together, sorted arrays of a tile should fit in L2 cache for typical windows
+#define TM_TILE 2048
+
+/**
+ * Updates sorted windows of pixels [p0,p1) with one frame and returns medians
+ * \param[in,out] sorted	sorted values of every pixel, window values per pixel, pixel p0 first
+ * \param[in] window	length of window
+ * \param[in] count		number of values in window before update, equal to window if leaving is given
+ * \param[in] p0		first pixel
+ * \param[in] p1		one past last pixel
+ * \param[in] leaving	frame leaving the window or NULL if window is not full yet
+ * \param[in] entering	frame entering the window
+ * \param[out] median	median of window after update, element of rank n/2 for n values (upper median if n even)
+*/
+static void TemporalUpdate(unsigned short *sorted, unsigned int window, unsigned int count, size_t p0, size_t p1, const UINT16 *leaving, const UINT16 *entering, UINT16 *median)
+{
+	unsigned int n = leaving ? window : count+1;	// values after update
+	unsigned int j;								// position of hole
+	for(size_t p=p0;p<p1;p++,sorted+=window)
+	{
+		unsigned short x = entering[p];
+		if(leaving)
+		{
+			j = static_cast<unsigned int>(std::lower_bound(sorted,sorted+window,leaving[p]) - sorted);
+			_ASSERT(j<window && sorted[j]==leaving[p]);
+			while(j+1<window && sorted[j+1]<x)	// hole moves up
+			{
+				sorted[j] = sorted[j+1];
+				j++;
+			}
+		}
+		else
+			j = count;
+		while(j>0 && sorted[j-1]>x)				// hole moves down
+		{
+			sorted[j] = sorted[j-1];
+			j--;
+		}
+		sorted[j] = x;
+		median[p] = sorted[n/2];
+	}
+}
+
+/**
+ * State of temporal median filter fed frame by frame, opaque for the caller
+ */
+struct TEMPORAL_MEDIAN
+{
+	unsigned int magic;						///< TEMPORAL_MAGIC for valid state
+	size_t npix;							///< pixels in frame
+	unsigned int window;					///< length of window
+	unsigned int count;						///< frames in window, up to window
+	unsigned int slot;						///< slot of ring holding the oldest frame
+	std::vector<UINT16> ring;				///< last window frames
+	std::vector<unsigned short> sorted;		///< sorted window of every pixel
+	const UINT16 *entering;					///< frame of current push
+	UINT16 *median;							///< output of current push
+	unsigned int nchunks;					///< number of pixel ranges processed in parallel
+	C_ThreadPool *pool;						///< worker threads
+	std::vector<C_ThreadPool::TASK> tasks;	///< one task per pixel range, built once
+	std::mutex lock;						///< serializes pushes
+};
+
+/**
+ * Updates pixel range of state with current frame
+ * \param[in] tm		state
+ * \param[in] chunk		index of pixel range
+*/
+static void TemporalChunk(TEMPORAL_MEDIAN *tm, unsigned int chunk)
+{
+	size_t p0 = tm->npix*chunk/tm->nchunks;
+	size_t p1 = tm->npix*(chunk+1)/tm->nchunks;
+	const UINT16 *leaving = tm->count==tm->window ? &tm->ring[tm->slot*tm->npix] : NULL;
+	TemporalUpdate(&tm->sorted[p0*tm->window],tm->window,tm->count,p0,p1,leaving,tm->entering,tm->median);
+}
+
+/**
+ * \details Creates temporal median filter. Every LV_TemporalMedianPush adds one frame and returns per-pixel median
+ * of the last window frames.
+ * \param[in] nrows		number of rows of frames
+ * \param[in] ncols		number of columns of frames
+ * \param[in] window	number of frames in median
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \param[out] tm		created filter, must be released by LV_TemporalMedianDestroy
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - empty frame or window
+ * \li OTHER_ERROR - threads or memory could not be allocated
+ * \remarks Memory used is 2*window*nrows*ncols pixels.
+*/
+extern "C" __declspec(dllexport) BYTE LV_TemporalMedianCreate(UINT16 nrows, UINT16 ncols, UINT16 window, UINT16 nthreads, TEMPORAL_MEDIAN **tm)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	TEMPORAL_MEDIAN *t = NULL;
+	if(NULL==tm)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	*tm = NULL;
+	if(0==nrows || 0==ncols || 0==window)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong frame size or window: "), pantheios::integer(nrows), PSTR("x"), pantheios::integer(ncols), PSTR(" "), pantheios::integer(window));
+		return WRONG_PARAMETER;
+	}
+	try
+	{
+		t = new TEMPORAL_MEDIAN;
+		t->magic = 0;
+		t->pool = NULL;
+		t->npix = static_cast<size_t>(nrows)*ncols;
+		t->window = window;
+		t->count = 0;
+		t->slot = 0;
+		t->entering = NULL;
+		t->median = NULL;
+		t->ring.resize(t->npix*window);
+		t->sorted.resize(t->npix*window);
+		t->pool = new C_ThreadPool(nthreads);
+		t->nchunks = static_cast<unsigned int>(std::min<size_t>(t->pool->GetSize(),t->npix));
+		for(unsigned int chunk=0;chunk<t->nchunks;chunk++)
+			t->tasks.push_back([t,chunk](unsigned int) { TemporalChunk(t,chunk); });
+	}
+	catch(std::exception &ex)	// bad_alloc or system_error
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Temporal median not created: "), ex.what());
+		if(t)
+		{
+			delete t->pool;
+			delete t;
+		}
+		return OTHER_ERROR;
+	}
+	t->magic = TEMPORAL_MAGIC;
+	*tm = t;
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * \details Adds frame to temporal median filter, the oldest frame leaves if window is full.
+ * \param[in] tm		filter created by LV_TemporalMedianCreate
+ * \param[in] frame		new frame
+ * \param[out] median	per-pixel median of frames in window including the new one. Until window is full it is
+ * median of frames pushed so far, for even number of frames the upper median.
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - filter is not valid
+ * \li OTHER_ERROR - update failed
+*/
+extern "C" __declspec(dllexport) BYTE LV_TemporalMedianPush(TEMPORAL_MEDIAN *tm, const UINT16* frame, UINT16* median)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	bool ok;
+	if(NULL==tm || NULL==frame || NULL==median)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(TEMPORAL_MAGIC!=tm->magic)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Invalid temporal median"));
+		return WRONG_PARAMETER;
+	}
+	{
+		std::lock_guard<std::mutex> guard(tm->lock);
+		tm->entering = frame;
+		tm->median = median;
+		ok = tm->pool->Run(tm->tasks);
+		// new frame takes slot of the oldest one
+		unsigned int slot = tm->count==tm->window ? tm->slot : tm->count;
+		memcpy(&tm->ring[slot*tm->npix], frame, tm->npix*sizeof(UINT16));
+		if(tm->count==tm->window)
+			tm->slot = (tm->slot+1)%tm->window;
+		else
+			tm->count++;
+		tm->entering = NULL;
+		tm->median = NULL;
+	}
+	if(!ok)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Update failed"));
+		return OTHER_ERROR;
+	}
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * \details Releases temporal median filter created by LV_TemporalMedianCreate, stops its threads.
+ * \param[in] tm		filter, invalid after this call
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - filter is not valid
+ * \warning Memory of destroyed filter is freed, so destroying or updating it again is undefined and is not reliably
+ * reported as WRONG_PARAMETER. Magic is a best-effort debug check only.
+*/
+extern "C" __declspec(dllexport) BYTE LV_TemporalMedianDestroy(TEMPORAL_MEDIAN *tm)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	if(NULL==tm)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(TEMPORAL_MAGIC!=tm->magic)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Invalid temporal median"));
+		return WRONG_PARAMETER;
+	}
+	tm->magic = 0;
+	delete tm->pool;
+	delete tm;
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * Filters all frames of the stack for pixels of given range, tile by tile
+ * \param[in] input_stack		input frames
+ * \param[out] output_stack	output frames
+ * \param[in] nframes	number of frames
+ * \param[in] npix		pixels in frame
+ * \param[in] window	length of window
+ * \param[in] p0		first pixel
+ * \param[in] p1		one past last pixel
+ * \remarks Sorted arrays are needed only for one tile, they stay in cache while all frames pass through it.
+*/
+static void TemporalStackRange(const UINT16 *input_stack, UINT16 *output_stack, UINT32 nframes, size_t npix, unsigned int window, size_t p0, size_t p1)
+{
+	std::vector<unsigned short> sorted(static_cast<size_t>(TM_TILE)*window);	// sorted windows of tile
+	for(size_t t0=p0;t0<p1;t0+=TM_TILE)
+	{
+		size_t t1 = std::min<size_t>(t0+TM_TILE,p1);
+		for(UINT32 f=0;f<nframes;f++)
+		{
+			const UINT16 *leaving = f>=window ? input_stack + (f-window)*npix : NULL;
+			// sorted array of pixel t0 is at the beginning, TemporalUpdate addresses frames by absolute pixel index
+			TemporalUpdate(&sorted[0],window,std::min(f,window),t0,t1,leaving,input_stack + f*npix,output_stack + f*npix);
+		}
+	}
+}
+
+/**
+ * \details Computes temporal median of every frame of the stack over window of frames ending at this frame.
+ * Output frame f is per-pixel median of input frames max(0,f-window+1)..f, equal to result of
+ * LV_TemporalMedianPush for frames pushed in order.
+ * \param[in] input_stack		nframes frames of size nrows x ncols, one after another
+ * \param[out] output_stack	output array of the same size as input_stack
+ * \param[in] nframes	number of frames in stack
+ * \param[in] nrows		number of rows of every frame
+ * \param[in] ncols		number of columns of every frame
+ * \param[in] window	number of frames in median
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - empty window
+ * \li OTHER_ERROR - threads or memory could not be allocated
+*/
+extern "C" __declspec(dllexport) BYTE LV_TemporalMedianStack(const UINT16* input_stack, UINT16* output_stack, UINT32 nframes, UINT16 nrows, UINT16 ncols, UINT16 window, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	size_t npix = static_cast<size_t>(nrows)*ncols;
+	std::vector<C_ThreadPool::TASK> tasks;	// one task per pixel range
+	bool ok;
+	if(NULL==input_stack || NULL==output_stack)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==window)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Empty window"));
+		return WRONG_PARAMETER;
+	}
+	if(0==npix || 0==nframes)
+		return OK;
+	try
+	{
+		C_ThreadPool pool(nthreads);
+		unsigned int nchunks = static_cast<unsigned int>(std::min<size_t>(pool.GetSize(),(npix+TM_TILE-1)/TM_TILE));
+		for(unsigned int chunk=0;chunk<nchunks;chunk++)
+		{
+			// ranges aligned to tiles
+			size_t ntiles = (npix+TM_TILE-1)/TM_TILE;
+			size_t p0 = std::min(npix,ntiles*chunk/nchunks*TM_TILE);
+			size_t p1 = std::min(npix,ntiles*(chunk+1)/nchunks*TM_TILE);
+			tasks.push_back([=](unsigned int) { TemporalStackRange(input_stack,output_stack,nframes,npix,window,p0,p1); });
+		}
+		ok = pool.Run(tasks);
+	}
+	catch(std::exception &ex)	// bad_alloc or system_error
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Temporal median failed: "), ex.what());
+		return OTHER_ERROR;
+	}
+	if(!ok)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Temporal median failed"));
+		return OTHER_ERROR;
+	}
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
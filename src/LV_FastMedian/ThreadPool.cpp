@@ -0,0 +1,102 @@
+/**
+ * \file    ThreadPool.cpp
+ * \brief	Persistent worker threads used by median filter plans
+ * \author  PB
+ * \date    2014/02/18
+ */
+
+#include "stdafx.h"
+
+/**
+ * Starts worker threads
+ * \param[in] nthreads	number of threads, 0 means number of cores reported by the system
+ * \remarks If some threads can not be created the pool works with those that have been started. It has always at
+ * least one thread, std::system_error is thrown if even that fails.
+*/
+C_ThreadPool::C_ThreadPool(unsigned int nthreads) : batch(NULL), next(0), pending(0), failed(false), quit(false)
+{
+	if(0==nthreads)
+		nthreads = std::max(1u,std::thread::hardware_concurrency());
+	threads.reserve(nthreads);
+	for(unsigned int i=0;i<nthreads;i++)
+	{
+		try
+		{
+			threads.push_back(std::thread(&C_ThreadPool::Worker,this,i));
+		}
+		catch(std::system_error&)	// no resources for next thread
+		{
+			if(threads.empty())
+				throw;
+			break;
+		}
+	}
+}
+
+/**
+ * Stops and joins all workers
+*/
+C_ThreadPool::~C_ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		quit = true;
+	}
+	work_ready.notify_all();
+	for(size_t i=0;i<threads.size();i++)
+		threads[i].join();
+}
+
+/**
+ * Executes all tasks on worker threads and waits until they finish
+ * \param[in] tasks		tasks to execute, order of execution is not defined
+ * \return false if any task has thrown an exception, remaining tasks are executed anyway
+*/
+bool C_ThreadPool::Run(const std::vector<TASK> &tasks)
+{
+	std::lock_guard<std::mutex> run_guard(run_lock);
+	std::unique_lock<std::mutex> guard(lock);
+	if(tasks.empty())
+		return true;
+	batch = &tasks;
+	next = 0;
+	pending = tasks.size();
+	failed = false;
+	work_ready.notify_all();
+	while(pending>0)
+		work_done.wait(guard);
+	batch = NULL;
+	return !failed;
+}
+
+/**
+ * Body of worker thread, takes tasks of current batch until pool is closed
+ * \param[in] index		index of this worker passed to tasks
+*/
+void C_ThreadPool::Worker(unsigned int index)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	for(;;)
+	{
+		while(!quit && (NULL==batch || next>=batch->size()))
+			work_ready.wait(guard);
+		if(quit)
+			return;
+		const TASK &task = (*batch)[next++];
+		guard.unlock();
+		bool ok = true;
+		try
+		{
+			task(index);
+		}
+		catch(...)
+		{
+			ok = false;
+		}
+		guard.lock();
+		if(!ok)
+			failed = true;
+		if(0==--pending)
+			work_done.notify_all();
+	}
+}
@@ -0,0 +1,46 @@
+/**
+ * \file    ThreadPool.h
+ * \brief	Persistent worker threads used by median filter plans
+ * \author  PB
+ * \date    2014/02/18
+ */
+
+#ifndef ThreadPool_h__
+#define ThreadPool_h__
+
+/**
+ * \class C_ThreadPool
+ *
+ * \brief Fixed set of threads executing batches of tasks
+ *
+ * Threads are created once in constructor and wait for work, so repeated calls do not pay for thread creation.
+ * Every task receives index of the worker that runs it, which allows to keep per-worker data (e.g. C_MedianWorkspace).
+ * Run() blocks until the whole batch is finished, only one batch can be executed at once.
+ */
+class C_ThreadPool
+{
+public:
+	/// Task of the batch, parameter is index of worker in range [0,GetSize())
+	typedef std::function<void(unsigned int)> TASK;
+	explicit C_ThreadPool(unsigned int nthreads);
+	~C_ThreadPool();
+	/// Number of worker threads
+	unsigned int GetSize() const { return static_cast<unsigned int>(threads.size()); }
+	bool Run(const std::vector<TASK> &tasks);
+private:
+	C_ThreadPool(const C_ThreadPool&);				// not copyable
+	C_ThreadPool& operator=(const C_ThreadPool&);
+	void Worker(unsigned int index);
+	std::vector<std::thread> threads;	///< worker threads
+	std::mutex run_lock;				///< serializes calls to Run
+	std::mutex lock;					///< protects fields below
+	std::condition_variable work_ready;	///< signalled when batch is posted or pool is closing
+	std::condition_variable work_done;	///< signalled when last task of batch finishes
+	const std::vector<TASK> *batch;		///< current batch or NULL
+	size_t next;						///< next task of batch to be taken
+	size_t pending;						///< tasks of batch not finished yet
+	bool failed;						///< any task of batch has thrown
+	bool quit;							///< workers should exit
+};
+
+#endif // ThreadPool_h__
@@ -0,0 +1,277 @@
+/**
+ * \file    TwoLevelHist.h
+ * \brief	Two-level histogram of image used by Huang median engines
+ * \author  PB
+ * \date    2014/02/12
+ */
+
+#ifndef TwoLevelHist_h__
+#define TwoLevelHist_h__
+
+/**
+ * \class C_TwoLevelHist
+ *
+ * \brief Histogram of 2^BITS bins with additional coarse level
+ *
+ * Fine level is split into buckets of 2^(BITS/2) bins. Coarse level holds sum of every bucket and is updated on
+ * every Add() and Remove(). Searching for value of given rank scans at most all coarse buckets and one bucket of
+ * fine bins instead of whole range. For 12 bit image and 16 bit counters whole histogram takes 8 kB.
+ * \tparam BITS		effective bit depth of the image, values must be smaller than 2^BITS
+ * \tparam COUNTER	type of counters, must hold number of elements in histogram (mask*mask)
+ * \tparam VALUE	type of values, must hold 2^BITS-1
+ */
+template<unsigned int BITS, typename COUNTER, typename VALUE = unsigned short>
+class C_TwoLevelHist
+{
+public:
+	enum
+	{
+		BINS = 1<<BITS,							///< number of fine bins
+		BUCKET_SHIFT = BITS/2,					///< log2 of number of bins in bucket
+		BUCKET_SIZE = 1<<BUCKET_SHIFT,			///< number of fine bins in one coarse bucket
+		BUCKETS = BINS/BUCKET_SIZE				///< number of coarse buckets
+	};
+	/// Creates empty histogram
+	C_TwoLevelHist()
+	{
+		fine = new COUNTER[BINS]();
+		memset(coarse, 0, sizeof(coarse));
+	}
+	~C_TwoLevelHist()
+	{
+		delete[] fine;
+	}
+	/// Clears histogram touching only non-empty buckets
+	void Clear()
+	{
+		for(unsigned int b=0;b<BUCKETS;b++)
+			if(coarse[b])
+			{
+				memset(fine + (b<<BUCKET_SHIFT), 0, BUCKET_SIZE*sizeof(COUNTER));
+				coarse[b] = 0;
+			}
+	}
+	/// Adds value to histogram
+	void Add(VALUE v)
+	{
+		_ASSERT(v<BINS);
+		fine[v]++;
+		coarse[v>>BUCKET_SHIFT]++;
+	}
+	/// Removes value from histogram
+	void Remove(VALUE v)
+	{
+		_ASSERT(v<BINS && fine[v]>0);
+		fine[v]--;
+		coarse[v>>BUCKET_SHIFT]--;
+	}
+	/**
+	 * Returns value of given rank
+	 * \param[in] rank		number of elements that are smaller than or equal to returned value minus one (0 for minimum)
+	 * \param[out] below		number of elements smaller than returned value
+	 * \return value v for which below<=rank<below+count(v)
+	 * \warning rank must be smaller than number of elements in histogram
+	 */
+	VALUE GetRank(unsigned int rank, unsigned int &below) const
+	{
+		unsigned int b, v;
+		below = 0;
+		for(b=0;below+coarse[b]<=rank;b++)
+		{
+			_ASSERT(b<BUCKETS-1);
+			below += coarse[b];
+		}
+		for(v=b<<BUCKET_SHIFT;below+fine[v]<=rank;v++)
+			below += fine[v];
+		return static_cast<VALUE>(v);
+	}
+	/**
+	 * Moves median after histogram update until number of pixels below it fits the rank th.
+	 * Walks fine bins within current bucket and skips whole buckets using coarse level.
+	 * \param[in] th		rank of median in the window
+	 * \param[in,out] mdm	median
+	 * \param[in,out] lmdm	number of elements smaller than mdm
+	 */
+	void Recenter(unsigned int th, VALUE &mdm, unsigned int &lmdm) const
+	{
+		unsigned int m = mdm;	// int to avoid overflow at bucket boundaries
+		unsigned int b;
+		if(lmdm>th)
+			while(lmdm>th)
+			{
+				if(0==(m & (BUCKET_SIZE-1)))	// start of bucket, skip buckets below
+				{
+					for(b=(m>>BUCKET_SHIFT)-1;lmdm>th+coarse[b];b--)
+						lmdm -= coarse[b];
+					m = (b+1)<<BUCKET_SHIFT;
+				}
+				m--;
+				_ASSERT(lmdm>=fine[m]);
+				lmdm -= fine[m];
+			}
+		else
+			while(lmdm+fine[m]<=th)
+			{
+				lmdm += fine[m];
+				m++;
+				if(0==(m & (BUCKET_SIZE-1)))	// next bucket, skip buckets that are below th
+				{
+					for(b=m>>BUCKET_SHIFT;lmdm+coarse[b]<=th;b++)
+						lmdm += coarse[b];
+					m = b<<BUCKET_SHIFT;
+				}
+				_ASSERT(m<BINS);
+			}
+		mdm = static_cast<VALUE>(m);
+	}
+private:
+	C_TwoLevelHist(const C_TwoLevelHist&);				// not copyable
+	C_TwoLevelHist& operator=(const C_TwoLevelHist&);
+	COUNTER *fine;						///< fine level, BINS bins
+	COUNTER coarse[BUCKETS];			///< coarse level, sums of BUCKET_SIZE fine bins
+};
+
+/**
+ * \class C_TwoLevelHistBank
+ *
+ * \brief K two-level histograms of windows of K consecutive image rows, interleaved in memory
+ *
+ * Counters of value v of all K histograms are adjacent (fine[v*K+i]), so a pixel shared by windows of several rows
+ * updates one cache line instead of K distant ones. Interface follows C_TwoLevelHist with histogram index added.
+ * \tparam BITS		effective bit depth of the image, values must be smaller than 2^BITS
+ * \tparam COUNTER	type of counters, must hold number of elements in histogram (mask*mask)
+ * \tparam K		number of histograms
+ */
+template<unsigned int BITS, typename COUNTER, unsigned int K>
+class C_TwoLevelHistBank
+{
+public:
+	enum
+	{
+		ROWS = K,								///< number of histograms
+		BINS = 1<<BITS,							///< number of fine bins of every histogram
+		BUCKET_SHIFT = BITS/2,					///< log2 of number of bins in bucket
+		BUCKET_SIZE = 1<<BUCKET_SHIFT,			///< number of fine bins in one coarse bucket
+		BUCKETS = BINS/BUCKET_SIZE				///< number of coarse buckets of every histogram
+	};
+	/// Creates K empty histograms
+	C_TwoLevelHistBank()
+	{
+		fine = new COUNTER[BINS*K]();
+		memset(coarse, 0, sizeof(coarse));
+	}
+	~C_TwoLevelHistBank()
+	{
+		delete[] fine;
+	}
+	/// Clears all histograms touching only non-empty buckets
+	void Clear()
+	{
+		for(unsigned int b=0;b<BUCKETS;b++)
+			for(unsigned int i=0;i<K;i++)
+				if(coarse[b*K+i])
+				{
+					memset(fine + (b<<BUCKET_SHIFT)*K, 0, BUCKET_SIZE*K*sizeof(COUNTER));
+					memset(coarse + b*K, 0, K*sizeof(COUNTER));
+					break;
+				}
+	}
+	/// Adds value to histogram i
+	void Add(unsigned int i, unsigned short v)
+	{
+		_ASSERT(v<BINS && i<K);
+		fine[v*K+i]++;
+		coarse[(v>>BUCKET_SHIFT)*K+i]++;
+	}
+	/// Removes value from histogram i
+	void Remove(unsigned int i, unsigned short v)
+	{
+		_ASSERT(v<BINS && i<K && fine[v*K+i]>0);
+		fine[v*K+i]--;
+		coarse[(v>>BUCKET_SHIFT)*K+i]--;
+	}
+	/**
+	 * Replaces value vout by vin in all K histograms
+	 * \param[in] vout	value removed
+	 * \param[in] vin	value added
+	 * \remarks Counters of one value of all histograms are adjacent, loops have constant trip count and are unrolled
+	 */
+	void SwapAll(unsigned short vout, unsigned short vin)
+	{
+		_ASSERT(vout<BINS && vin<BINS);
+		COUNTER *fo = fine + vout*K;
+		COUNTER *fi = fine + vin*K;
+		COUNTER *co = coarse + (vout>>BUCKET_SHIFT)*K;
+		COUNTER *ci = coarse + (vin>>BUCKET_SHIFT)*K;
+		for(unsigned int i=0;i<K;i++)
+		{
+			fo[i]--;
+			co[i]--;
+		}
+		for(unsigned int i=0;i<K;i++)
+		{
+			fi[i]++;
+			ci[i]++;
+		}
+	}
+	/**
+	 * Returns value of given rank in histogram i
+	 * \see C_TwoLevelHist::GetRank
+	 */
+	unsigned short GetRank(unsigned int i, unsigned int rank, unsigned int &below) const
+	{
+		unsigned int b, v;
+		below = 0;
+		for(b=0;below+coarse[b*K+i]<=rank;b++)
+		{
+			_ASSERT(b<BUCKETS-1);
+			below += coarse[b*K+i];
+		}
+		for(v=b<<BUCKET_SHIFT;below+fine[v*K+i]<=rank;v++)
+			below += fine[v*K+i];
+		return static_cast<unsigned short>(v);
+	}
+	/**
+	 * Moves median of histogram i after update until number of pixels below it fits the rank th
+	 * \see C_TwoLevelHist::Recenter
+	 */
+	void Recenter(unsigned int i, unsigned int th, unsigned short &mdm, unsigned int &lmdm) const
+	{
+		unsigned int m = mdm;
+		unsigned int b;
+		if(lmdm>th)
+			while(lmdm>th)
+			{
+				if(0==(m & (BUCKET_SIZE-1)))	// start of bucket, skip buckets below
+				{
+					for(b=(m>>BUCKET_SHIFT)-1;lmdm>th+coarse[b*K+i];b--)
+						lmdm -= coarse[b*K+i];
+					m = (b+1)<<BUCKET_SHIFT;
+				}
+				m--;
+				_ASSERT(lmdm>=fine[m*K+i]);
+				lmdm -= fine[m*K+i];
+			}
+		else
+			while(lmdm+fine[m*K+i]<=th)
+			{
+				lmdm += fine[m*K+i];
+				m++;
+				if(0==(m & (BUCKET_SIZE-1)))	// next bucket, skip buckets that are below th
+				{
+					for(b=m>>BUCKET_SHIFT;lmdm+coarse[b*K+i]<=th;b++)
+						lmdm += coarse[b*K+i];
+					m = b<<BUCKET_SHIFT;
+				}
+				_ASSERT(m<BINS);
+			}
+		mdm = static_cast<unsigned short>(m);
+	}
+private:
+	C_TwoLevelHistBank(const C_TwoLevelHistBank&);				// not copyable
+	C_TwoLevelHistBank& operator=(const C_TwoLevelHistBank&);
+	COUNTER *fine;						///< fine level, BINS*K counters, value-major
+	COUNTER coarse[BUCKETS*K];			///< coarse level, bucket-major
+};
+
+#endif // TwoLevelHist_h__
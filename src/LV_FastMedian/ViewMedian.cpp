@@ -0,0 +1,122 @@
+/**
+ * \file    ViewMedian.cpp
+ * \brief	Median filtering of image views with row pitch and origin offset
+ * \details Engines address input and output through OBRAZ::pitch and OBRAZ::out_pitch, so a rectangle of a larger
+ * image or a buffer with padded rows is filtered in place of the caller's memory, without copying it in or out.
+ * LV_MedFiltView covers LV_MedFilt, LV_MedFiltMT, LV_MedFiltEngine and LV_MedFiltBorder. Other single image filters
+ * have their own view exports: LV_MedFiltMaskedView, LV_RankFiltView, LV_MedFiltBackgroundView,
+ * LV_MedFiltProgressView and LV_MedFiltPlanExecuteView. Exports without views:
+ * \li LV_MedFilt31 and LV_MedFiltBits - fixed mask and forced bit depth, LV_MedFiltView with ENGINE_AUTO scans the
+ * bit depth of the view itself
+ * \li LV_MedFiltBatch, LV_MedFiltPlanExecuteBatch and LV_TemporalMedian* - stacks of frames addressed by frame size,
+ * views of single frames are filtered by LV_MedFiltPlanExecuteView
+ * \li LV_MedFiltStream - caller's source and sink callbacks already decide where rows come from and go to
+ * \li LV_MedFiltFloat and LV_MedFiltDouble - MEDFILT_VIEW describes UINT16 buffers only
+ * \li LV_MedFiltUpdate - refilters rectangles of a previous full frame output, the rectangles select the region
+ * \author  PB
+ * \date    2014/03/10
+ */
+
+#include "stdafx.h"
+
+/**
+ * Checks that view is consistent
+ * \param[in] view		view to check
+ * \return true if view can be filtered
+*/
+static bool isValidView(const MEDFILT_VIEW *view)
+{
+	return view->cols>0 && view->rows>0 && view->pitch>=view->cols && view->col<=view->pitch-view->cols;
+}
+
+/**
+ * Describes input view as image and finds first pixel of output view, used by all *View exports
+ * \param[in] input		view of input image
+ * \param[in] output	view of output image, the same size as input
+ * \param[out] image	input view with pitch of both views, zeros outside the view (BORDER_ZERO)
+ * \param[out] tabout	first pixel of output view
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li WRONG_PARAMETER - empty or inconsistent views or views of different size
+ * \remarks Pointers are not checked, callers check them before to report NULL_POINTER.
+*/
+BYTE viewToImage(const MEDFILT_VIEW *input, const MEDFILT_VIEW *output, OBRAZ *image, unsigned short **tabout)
+{
+	if(!isValidView(input) || !isValidView(output) || input->rows!=output->rows || input->cols!=output->cols)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong views [rows;cols;pitch]: "), PSTR("["),pantheios::integer(input->rows), PSTR(","), pantheios::integer(input->cols), PSTR(","), pantheios::integer(input->pitch),
+							PSTR("] ["),pantheios::integer(output->rows), PSTR(","), pantheios::integer(output->cols), PSTR(","), pantheios::integer(output->pitch), PSTR("]"));
+		return WRONG_PARAMETER;
+	}
+	image->tab = input->tab + static_cast<size_t>(input->row)*input->pitch + input->col;
+	image->rows = input->rows;
+	image->cols = input->cols;
+	image->pitch = input->pitch;
+	image->out_pitch = output->pitch;
+	image->tabsize = input->rows*input->cols;
+	image->border = BORDER_ZERO;
+	image->border_value = 0;
+	*tabout = output->tab + static_cast<size_t>(output->row)*output->pitch + output->col;
+	return OK;
+}
+
+/**
+ * \details Filters view of the image with median. Views address rectangles of buffers with arbitrary row pitch, e.g.
+ * ROI of LabVIEW image or padded rows, the result is identical to copying the input rectangle to dense array, filtering
+ * it with LV_MedFiltBorder or LV_MedFiltEngine and copying the result to the output rectangle. Pixels of output
+ * buffer outside the output view are not modified.
+ * \param[in] input		view of input image
+ * \param[in,out] output	view of output image, the same size as input, must not overlap input
+ * \param[in] mask		size of the mask, odd
+ * \param[in] engine		median engine, one of MEDIAN_ENGINE, ENGINE_AUTO selects engine as LV_MedFilt
+ * \param[in] border		border mode, one of BORDER_MODE, applied at the edges of the input view
+ * \param[in] border_value	value outside the view for BORDER_CONSTANT, ignored otherwise
+ * \param[in] nthreads	number of threads, 0 uses all cores
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - unknown engine or border mode, even mask, empty or inconsistent views
+ * \li OTHER_ERROR - memory could not be allocated
+ * \remarks Pixels outside the input view are never read, even if the buffer contains them, border mode is used instead.
+ * \see MEDFILT_VIEW
+*/
+extern "C" __declspec(dllexport) BYTE LV_MedFiltView(const MEDFILT_VIEW *input, const MEDFILT_VIEW *output, UINT16 mask, UINT16 engine, UINT16 border, UINT16 border_value, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	OBRAZ obraz;	// input view
+	BAND_FILTER filter = NULL;
+	unsigned short *tabout;	// first pixel of output view
+	if(NULL==input || NULL==output || NULL==input->tab || NULL==output->tab)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(0==mask%2 || border>BORDER_CONSTANT)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong border mode or mask: "), pantheios::integer(border), PSTR(" "), pantheios::integer(mask));
+		return WRONG_PARAMETER;
+	}
+	if(ENGINE_AUTO!=engine)
+	{
+		filter = getBandFilter(static_cast<MEDIAN_ENGINE>(engine),16);
+		if(NULL==filter)
+		{
+			PANTHEIOS_TRACE_ERROR(PSTR("Unknown engine: "), pantheios::integer(engine));
+			return WRONG_PARAMETER;
+		}
+	}
+	if(OK!=viewToImage(input,output,&obraz,&tabout))
+		return WRONG_PARAMETER;
+	obraz.border = static_cast<BORDER_MODE>(border);
+	obraz.border_value = border_value;
+	PANTHEIOS_TRACE_DEBUG(PSTR("Engine: "), pantheios::integer(engine), PSTR(" threads: "), pantheios::integer(nthreads));
+	if(!(NULL==filter ? FastMedian_Dispatch(&obraz,tabout,mask,nthreads) : FastMedian_Parallel(&obraz,tabout,mask,nthreads,filter)))
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Not enough memory"));
+		return OTHER_ERROR;
+	}
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
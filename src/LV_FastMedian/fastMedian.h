@@ -8,6 +8,17 @@
 #ifndef fastMedian_h__
 #define fastMedian_h__
 
+/** 
+ * Handling of pixels outside the image, used by all median engines
+ */
+enum BORDER_MODE
+{
+	BORDER_ZERO = 0,		/**< zeros outside the image (original behaviour) */
+	BORDER_REPLICATE = 1,	/**< nearest edge pixel, aaa|abcd|ddd */
+	BORDER_REFLECT = 2,		/**< mirror including edge pixel, cba|abcd|dcb */
+	BORDER_CONSTANT = 3		/**< OBRAZ::border_value outside the image */
+};
+
 /** 
  * Struktura opisujca obraz lub bardziej generalnie obszar pamici
  */
@@ -17,11 +28,189 @@ struct OBRAZ
 	unsigned int rows; /** ilo rzdw */
 	unsigned int cols; /** ilo kolumn */
 	unsigned int tabsize;	/** ilo elementw tablicy = rows*cols */
+	unsigned int pitch;	/** distance between starts of consecutive rows of tab in elements, >= cols */
+	unsigned int out_pitch;	/** distance between starts of consecutive rows of output array in elements, >= cols */
+	BORDER_MODE border;	/** handling of pixels outside the image */
+	unsigned short border_value;	/** value outside the image for BORDER_CONSTANT */
 };
 
+/** 
+ * Maps index outside [0,n) to index inside for BORDER_REPLICATE and BORDER_REFLECT
+ * \param[in] i			index outside the image
+ * \param[in] n			size of the image in this direction
+ * \param[in] border	border mode, BORDER_REPLICATE or BORDER_REFLECT
+ * \return index in range [0,n)
+ * \remarks Reflection is periodic so masks larger than the image are supported
+*/
+inline int mapBorderIndex(int i, int n, BORDER_MODE border)
+{
+	if(BORDER_REPLICATE==border)
+		return i<0 ? 0 : n-1;
+	i %= 2*n;
+	if(i<0)
+		i += 2*n;
+	return i<n ? i : 2*n-1-i;
+}
+
+/** 
+ * Returns pixel [r,k] of the image, pixels outside the image are taken according to image->border
+ * \param[in] image		input image
+ * \param[in] r			row, may be negative or above the image
+ * \param[in] k			column, may be negative or above the image
+ * \return value of the pixel
+*/
+inline unsigned short getPointBorder(const OBRAZ *image, int r, int k)
+{
+	int rows = static_cast<int>(image->rows);
+	int cols = static_cast<int>(image->cols);
+	if(r>=0 && k>=0 && r<rows && k<cols)
+		return image->tab[r*image->pitch+k];
+	switch(image->border)
+	{
+	case BORDER_ZERO:
+		return 0;
+	case BORDER_CONSTANT:
+		return image->border_value;
+	default:
+		if(r<0 || r>=rows)
+			r = mapBorderIndex(r,rows,image->border);
+		if(k<0 || k>=cols)
+			k = mapBorderIndex(k,cols,image->border);
+		return image->tab[r*image->pitch+k];
+	}
+}
+
+class C_MedianWorkspace;
+
 void FastMedian_Huang(	OBRAZ *image,
  						unsigned short *tabout, 
-					 	unsigned short mask);
+					 	unsigned short mask,
+						unsigned int row_start,
+						unsigned int row_end,
+						C_MedianWorkspace *ws);
+void FastMedian_HuangSerpentine(OBRAZ *image,
+								unsigned short *tabout,
+								unsigned short mask,
+								unsigned int row_start,
+								unsigned int row_end,
+								C_MedianWorkspace *ws);
+void FastMedian_ConstantTime(	OBRAZ *image,
+								unsigned short *tabout,
+								unsigned short mask,
+								unsigned int row_start,
+								unsigned int row_end,
+								C_MedianWorkspace *ws);
+/// instantiated for BITS 8, 10, 12, 14 and 16 in ConstantTimeMedian.cpp
+template<unsigned int BITS>
+void FastMedian_ConstantTimeBits(	OBRAZ *image,
+									unsigned short *tabout,
+									unsigned short mask,
+									unsigned int row_start,
+									unsigned int row_end,
+									C_MedianWorkspace *ws);
+void FastMedian_SortingNetwork(	OBRAZ *image,
+								unsigned short *tabout,
+								unsigned short mask,
+								unsigned int row_start,
+								unsigned int row_end,
+								C_MedianWorkspace *ws);
+void FastMedian_HuangMultiRow(	OBRAZ *image,
+								unsigned short *tabout,
+								unsigned short mask,
+								unsigned int row_start,
+								unsigned int row_end,
+								C_MedianWorkspace *ws);
+void FastMedian_HuangRect(		OBRAZ *image,
+								unsigned short *tabout,
+								unsigned short mask,
+								unsigned int row_start,
+								unsigned int row_end,
+								unsigned int col_start,
+								unsigned int col_end,
+								C_MedianWorkspace *ws);
+
+/// Median engine filtering rows [row_start,row_end) of the image, scratch memory is taken from workspace ws (may be NULL)
+typedef void (*BAND_FILTER)(OBRAZ *image, unsigned short *tabout, unsigned short mask, unsigned int row_start, unsigned int row_end, C_MedianWorkspace *ws);
+
+/** 
+ * Median engines that can be selected in LV_MedFiltEngine
+ */
+enum MEDIAN_ENGINE
+{
+	HUANG = 0,				/**< FastMedian_Huang, histogram rebuilt for every row */
+	HUANG_SERPENTINE = 1,	/**< FastMedian_HuangSerpentine, histogram built once per band */
+	CONSTANT_TIME = 2,		/**< FastMedian_ConstantTime, per pixel cost independent of mask size */
+	SORTING_NETWORK = 3,	/**< FastMedian_SortingNetwork, SIMD min/max networks for masks 3, 5 and 7 */
+	HUANG_MULTIROW = 4,		/**< FastMedian_HuangMultiRow, MULTIROW_ROWS rows filtered per sweep from shared column loads */
+	ENGINE_AUTO = 5			/**< engine selected by FastMedian_Dispatch, accepted by LV_MedFiltView only */
+};
+
+/// Work on rows [row_start,row_end) of the image, used by ParallelBands
+typedef std::function<void(unsigned int row_start, unsigned int row_end)> BAND_TASK;
+
+/// number of output rows filtered together by HUANG_MULTIROW engine
+#define MULTIROW_ROWS 8
+
+/// largest mask supported by sorting network engine
+#define NETWORK_MAX_MASK 7
+
+/// number of bit depths with specialised Huang engines (8, 10, 12, 14, 16)
+#define DISPATCH_NBITS 5
+
+/** 
+ * Decision table of median dispatcher used by LV_MedFilt, see LV_MedFiltDispatchSet and LV_MedFiltCalibrate
+ */
+struct MEDFILT_DISPATCH
+{
+	UINT16 network_max_mask[DISPATCH_NBITS];	/**< largest mask filtered by SORTING_NETWORK for bit depths 8, 10, 12, 14 and 16, 0 disables the engine */
+	UINT16 ct_min_mask[DISPATCH_NBITS];		/**< smallest mask filtered by CONSTANT_TIME for bit depths 8, 10, 12, 14 and 16, smaller masks use HUANG_SERPENTINE */
+	UINT32 min_band_pixels;					/**< smallest number of pixels worth starting a thread for */
+};
+
+/** 
+ * Rectangular part of an image buffer with arbitrary row pitch, used by LV_MedFiltView and other *View exports
+ */
+struct MEDFILT_VIEW
+{
+	UINT16 *tab;		/**< first pixel of the buffer, not of the view */
+	UINT32 pitch;		/**< distance between starts of consecutive rows of the buffer in pixels */
+	UINT32 row;			/**< first row of the view in the buffer */
+	UINT32 col;			/**< first column of the view in the buffer */
+	UINT32 rows;		/**< number of rows of the view */
+	UINT32 cols;		/**< number of columns of the view, col+cols must not exceed pitch */
+};
+
+BAND_FILTER getBandFilter(MEDIAN_ENGINE engine, unsigned int bits);
+MEDIAN_ENGINE getDefaultEngine(unsigned short mask);
+MEDIAN_ENGINE selectEngine(unsigned short mask, const OBRAZ *image, unsigned int band_rows, unsigned int &bits);
+BYTE viewToImage(const MEDFILT_VIEW *input, const MEDFILT_VIEW *output, OBRAZ *image, unsigned short **tabout);
+
+/** 
+ * Source of rows for LV_MedFiltStream. Must fill nrows full rows starting at image row first_row.
+ * \return OK or error code that aborts filtering
+ */
+typedef BYTE (__cdecl *MEDFILT_SOURCE)(void *user, UINT64 first_row, UINT32 nrows, UINT16 *rows);
+/** 
+ * Sink of filtered rows for LV_MedFiltStream. Receives nrows full rows starting at image row first_row,
+ * rows are valid only during the call.
+ * \return OK or error code that aborts filtering
+ */
+typedef BYTE (__cdecl *MEDFILT_SINK)(void *user, UINT64 first_row, UINT32 nrows, const UINT16 *rows);
+/** 
+ * Progress of LV_MedFiltProgress, called from the calling thread after chunks of rows are filtered.
+ * \return OK to continue, any other value cancels filtering
+ */
+typedef BYTE (__cdecl *MEDFILT_PROGRESS)(void *user, UINT32 rows_done, UINT32 rows_total);
+bool FastMedian_Parallel(	OBRAZ *image,
+							unsigned short *tabout,
+							unsigned short mask,
+							unsigned int nthreads,
+							BAND_FILTER filter);
+bool ParallelBands(unsigned int rows, unsigned int nthreads, const BAND_TASK &task);
+bool FastMedian_Dispatch(	OBRAZ *image,
+							unsigned short *tabout,
+							unsigned short mask,
+							unsigned int nthreads);
 
 inline unsigned short getPoint(OBRAZ *image, unsigned int r, unsigned int k);
 unsigned short getMedian(const unsigned short *tab, unsigned int tabsize);
@@ -34,6 +223,18 @@ void CopyWindow(OBRAZ *input_image,
 				unsigned short *out,
 				unsigned int *hist);
 void CopyOneColumn( OBRAZ *input_image, unsigned short mask, int r, int k, unsigned short *out );
+void CopyOneRow( OBRAZ *input_image, unsigned short mask, int r, int k, unsigned short *out );
+
+/** 
+ * Instruction sets detected by getCpuFeatures
+ */
+enum CPU_FEATURE
+{
+	CPU_SSE41 = 1,	/**< SSE4.1 */
+	CPU_AVX2 = 2	/**< AVX2 supported by CPU and enabled by OS */
+};
+
+unsigned int getCpuFeatures();
 
 /// ilo poziomw szaroci w analizowanym obrazie
 #define GRAYSCALE 65536
@@ -11,10 +11,24 @@
 // Windows Header Files:
 #include <windows.h>
 #include <crtdbg.h>
+#include <intrin.h>
+#include <immintrin.h>
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <thread>
+#include <system_error>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <cmath>
+#include <chrono>
 #include "fastMedian.h"
+#include "TwoLevelHist.h"
+#include "MedianWorkspace.h"
+#include "ThreadPool.h"
 #include "Pantheios_header.h"
+#include "error_codes.h"
 
 // TODO: reference additional headers your program requires here
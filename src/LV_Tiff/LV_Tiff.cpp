@@ -4,6 +4,8 @@
  * \details Exports the following functions:
  * - Tiff_GetParams - Returns size of the image
  * - Tiff_ReadImage - Loads image into user's buffer
+ * - Tiff_ReadImageParallel - Loads image into user's buffer decoding strips on many threads
+ * - Tiff_WriteImage - Writes image to file
  * \pre libtiff3.dll and other dependencies must be on path
  * \author  PB
  * \date    2014/01/22
@@ -89,6 +91,197 @@ extern "C" __declspec(dllexport) BYTE Tiff_GetParams(const char* image_name, UIN
 	return OK;
 }
 
+/**
+ * Copies uncompressed strips from mapped view of the file to user's buffer
+ * \param[in] view	first byte of the view
+ * \param[in] base	offset of the view in the file
+ * \param[in] offsets	offsets of strips in the file
+ * \param[in] nstrips	number of strips
+ * \param[in] stripBytes	number of bytes of every strip but the last one
+ * \param[in] lastBytes	number of bytes of the last strip
+ * \param[out] _data	pointer to memory block that will hold read image
+ * \return true if all strips were copied, false if the mapped file could not be read (EXCEPTION_IN_PAGE_ERROR)
+ * \remarks Uses structured exception handling thus must not hold objects with destructors
+*/
+static bool CopyMappedStrips(const BYTE* view, ULONGLONG base, const toff_t* offsets, tstrip_t nstrips, size_t stripBytes, size_t lastBytes, UINT16* const _data)
+{
+	BYTE* out = reinterpret_cast<BYTE*>(_data);
+	__try
+	{
+		for(tstrip_t strip = 0; strip < nstrips; strip++)
+			memcpy(out + strip*stripBytes, view + static_cast<size_t>(offsets[strip] - base), strip+1 < nstrips ? stripBytes : lastBytes);
+	}
+	__except(EXCEPTION_IN_PAGE_ERROR==GetExceptionCode() ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+	{
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Opens file and creates its mapping object for ReadMappedStrips. Views are mapped later, one per image, so the file
+ * may be larger than address space of the process.
+ * \param[in] image_name	name and path to the input image
+ * \param[out] mapped	opened file, must be released by CloseMappedFile if OK is returned
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li FILE_READ_ERROR - file can not be opened or mapped
+ * \see http://msdn.microsoft.com/en-us/library/windows/desktop/aa366556(v=vs.85).aspx
+*/
+BYTE OpenMappedFile(const char* image_name, MAPPED_FILE* mapped)
+{
+	LARGE_INTEGER fileSize;
+	mapped->file = CreateFileA(image_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(INVALID_HANDLE_VALUE==mapped->file)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Error in CreateFile: "), pantheios::integer(GetLastError()));
+		return FILE_READ_ERROR;
+	}
+	if(0==GetFileSizeEx(mapped->file, &fileSize))
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Error in GetFileSizeEx: "), pantheios::integer(GetLastError()));
+		CloseHandle(mapped->file);
+		return FILE_READ_ERROR;
+	}
+	mapped->size = static_cast<ULONGLONG>(fileSize.QuadPart);
+	mapped->mapping = CreateFileMapping(mapped->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(NULL==mapped->mapping)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Error in CreateFileMapping: "), pantheios::integer(GetLastError()));
+		CloseHandle(mapped->file);
+		return FILE_READ_ERROR;
+	}
+	return OK;
+}
+
+/**
+ * Releases file opened by OpenMappedFile
+ * \param[in] mapped	opened file
+*/
+void CloseMappedFile(MAPPED_FILE* mapped)
+{
+	CloseHandle(mapped->mapping);
+	CloseHandle(mapped->file);
+}
+
+/**
+ * \details Reads uncompressed image without libtiff decoding. Only part of the file holding strips of the image is
+ * mapped to memory and every strip is copied to user's buffer by one memcpy, so reading runs at page cache bandwidth.
+ * Strip layout is taken from directory read by libtiff.
+ * \param[in] mapped	file opened by OpenMappedFile, the same as opened in \a tif
+ * \param[in] tif	handler from TIFFOpen, current directory must pass checkTIFF and checkRawTIFF
+ * \param[out] _data	pointer to memory block that will hold read image
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li FILE_READ_ERROR - view can not be mapped, strips lie outside the file or reading failed
+*/
+static BYTE ReadMappedStrips(const MAPPED_FILE* mapped, TIFF* tif, UINT16* const _data)
+{
+	UINT32 ncols, nrows, rowsPerStrip;
+	toff_t* offsets;
+	SYSTEM_INFO info;
+	ULONGLONG first, last, end;	// range of the file holding strips
+	const BYTE* view;
+	bool copied;
+	TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &ncols);
+	TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &nrows);
+	TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+	TIFFGetField(tif, TIFFTAG_STRIPOFFSETS, &offsets);
+	if(rowsPerStrip > nrows)
+		rowsPerStrip = nrows;
+	tstrip_t nstrips = TIFFNumberOfStrips(tif);
+	size_t stripBytes = static_cast<size_t>(rowsPerStrip)*ncols*sizeof(UINT16);
+	size_t lastBytes = static_cast<size_t>(nrows - (nstrips-1)*rowsPerStrip)*ncols*sizeof(UINT16);
+
+	first = mapped->size;
+	last = 0;
+	for(tstrip_t strip = 0; strip < nstrips; strip++)
+	{
+		end = static_cast<ULONGLONG>(offsets[strip]) + (strip+1 < nstrips ? stripBytes : lastBytes);
+		if(end > mapped->size)																// strips must lie inside the file
+		{
+			PANTHEIOS_TRACE_ERROR(PSTR("Strip outside the file: "), pantheios::integer(strip));
+			return FILE_READ_ERROR;
+		}
+		first = min(first, static_cast<ULONGLONG>(offsets[strip]));
+		last = max(last, end);
+	}
+	GetSystemInfo(&info);
+	first -= first % info.dwAllocationGranularity;										// views start at allocation granularity
+	if(last - first > static_cast<ULONGLONG>(static_cast<SIZE_T>(-1)))
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Strips too far apart to be mapped"));
+		return FILE_READ_ERROR;
+	}
+	view = static_cast<const BYTE*>(MapViewOfFile(mapped->mapping, FILE_MAP_READ, static_cast<DWORD>(first >> 32), static_cast<DWORD>(first), static_cast<SIZE_T>(last - first)));
+	if(NULL==view)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Error in MapViewOfFile: "), pantheios::integer(GetLastError()));
+		return FILE_READ_ERROR;
+	}
+	copied = CopyMappedStrips(view, first, offsets, nstrips, stripBytes, lastBytes, _data);
+	UnmapViewOfFile(view);
+	if(!copied)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Error in reading mapped file"));
+		return FILE_READ_ERROR;
+	}
+	PANTHEIOS_TRACE_DEBUG(PSTR("Copied "), pantheios::integer(nstrips), PSTR(" uncompressed strips from mapped file"));
+	return OK;
+}
+
+/**
+ * \details Reads image of current directory of \a tif. Uncompressed native-endian images (see checkRawTIFF) are copied
+ * from memory-mapped file by ReadMappedStrips, other images or images which can not be mapped are decoded by
+ * libtiff directly into \a _data, strip after strip. The last strip may hold less rows than the others.
+ * \param[in] mapped	file opened by OpenMappedFile, the same as opened in \a tif, NULL to always decode by libtiff
+ * \param[in] tif	handler from TIFFOpen, current directory must pass checkTIFF
+ * \param[out] _data	pointer to memory block that will hold read image
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li OTHER_ERROR - strip could not be decoded
+*/
+BYTE ReadCurrentImage(const MAPPED_FILE* mapped, TIFF* tif, UINT16* const _data)
+{
+	tsize_t sizeOfTiff;
+	tstrip_t strip;
+	UINT32 nrows;
+	// ---------- Uncompressed strips are copied directly from file ----------
+	if(NULL != mapped && OK == checkRawTIFF(tif) && OK == ReadMappedStrips(mapped, tif, _data))
+		return OK;
+	// ---------- Loading tiff ----------
+	// Every strip is decoded directly into user memory just after the previous one
+	TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &nrows);
+	BYTE* out = reinterpret_cast<BYTE*>(_data);
+	tsize_t imageBytes = TIFFScanlineSize(tif)*static_cast<tsize_t>(nrows);
+	tsize_t stripBytes = TIFFStripSize(tif);
+	tsize_t offset = 0;													// bytes of image already decoded
+	try
+	{
+		for (strip = 0; strip < TIFFNumberOfStrips(tif) && offset < imageBytes; strip++)
+		{
+			// the last strip is limited to rows remaining in the image, never writes beyond _data
+			sizeOfTiff = TIFFReadEncodedStrip(tif, strip, out + offset, min(stripBytes, imageBytes - offset));
+			if(-1==sizeOfTiff)
+			{
+				PANTHEIOS_TRACE_ERROR(PSTR("Error in TIFFReadEncodedStrip"));
+				return OTHER_ERROR;
+			}
+			offset += sizeOfTiff;
+		}
+	}
+	catch(TIFFException& e)	// ErrorHandler throws on decoding errors
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in TIFFReadEncodedStrip "),e.what());
+		return OTHER_ERROR;
+	}
+	PANTHEIOS_TRACE_DEBUG(PSTR("TIFFReadEncodedStrip put "), pantheios::integer(offset),PSTR(" bytes"));
+	return OK;
+}
+
 /** 
  * \details Reads Tiff image under following assumpions:
  * \li only one page
@@ -108,15 +301,15 @@ extern "C" __declspec(dllexport) BYTE Tiff_GetParams(const char* image_name, UIN
  * \see http://www.libtiff.org/libtiff.html
  * \see http://www.awaresystems.be/imaging/tiff/astifftagviewer.html to check Tiff tags
  * \see error_codes.h
- * \warning Assumes that every strip has the same number of bytes. In this case there are 'rows' strips of size 2*cols bytes.
+ * \see ReadCurrentImage
 */
 extern "C" __declspec(dllexport) BYTE Tiff_ReadImage(const char* image_name, UINT16* const _data)
 {
 	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
-	tsize_t sizeOfTiff;
-	tstrip_t strip;
-	tdata_t buf;
+	BYTE err;
 	TIFF* tif;										// handler of file
+	MAPPED_FILE mapped;								// file opened for copying uncompressed strips
+	bool isMapped;
 	if(NULL==_data)																				// Something wrong on LV side
 	{
 		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
@@ -144,43 +337,226 @@ extern "C" __declspec(dllexport) BYTE Tiff_ReadImage(const char* image_name, UIN
 	// test conditions: notiles, 16bit, 1sample per pixel	
 	if(OK == checkTIFF(tif))
 	{
-		// ---------- Loading tiff (example from doc) ----------
-		// Image is loaded into internally allocated memory and then coiped to user memory
-		buf = _TIFFmalloc(TIFFStripSize(tif));
-		UINT32 index = 0;
-		UINT16* p;
-		p = (UINT16 *)buf;
-		for (strip = 0; strip < TIFFNumberOfStrips(tif); strip++)
+		isMapped = OK == checkRawTIFF(tif) && OK == OpenMappedFile(image_name, &mapped);
+		err = ReadCurrentImage(isMapped ? &mapped : NULL, tif, _data);
+		if(isMapped)
+			CloseMappedFile(&mapped);
+		if(OK != err)
 		{
-			sizeOfTiff = TIFFReadEncodedStrip(tif, strip, buf, (tsize_t) -1);
-			if(-1==sizeOfTiff)
-			{
-				PANTHEIOS_TRACE_ERROR(PSTR("Error in TIFFReadEncodedStrip"));
-				TIFFClose(tif);
-				_TIFFfree(buf);
-				return OTHER_ERROR;
-			}
-			for(int i = 0; i < sizeOfTiff; i++)
+			TIFFClose(tif);
+			return err;
+		}
+	}
+	else
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Unsuported Tiff"));
+		TIFFClose(tif);
+		return FILE_READ_ERROR;
+	}
+	TIFFClose(tif);
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * Strips of one image shared by decoding threads
+ */
+struct STRIP_JOB
+{
+	const char* image_name;			///< file opened by every worker
+	BYTE* out;						///< user's buffer
+	tsize_t imageBytes;				///< size of decoded image in bytes
+	tsize_t stripBytes;				///< size of decoded full strip in bytes
+	tstrip_t nstrips;				///< number of strips
+	std::atomic<tstrip_t> next;		///< next strip to be decoded
+	std::atomic<bool> failed;		///< any strip could not be decoded
+};
+
+/**
+ * Decodes strips taken from the job until all are taken or any worker failed
+ * \param[in] tif	handler from TIFFOpen owned by calling thread
+ * \param[in,out] job	strips to decode
+ * \remarks Strips are taken one by one from common counter, so threads stay busy even if strips are compressed differently
+*/
+static void DecodeStrips(TIFF* tif, STRIP_JOB* job)
+{
+	tstrip_t strip;
+	tsize_t offset;
+	while(!job->failed && (strip = job->next++) < job->nstrips)
+	{
+		offset = static_cast<tsize_t>(strip)*job->stripBytes;			// every strip but the last one is full
+		if(offset >= job->imageBytes)
+			continue;
+		try
+		{
+			if(-1==TIFFReadEncodedStrip(tif, strip, job->out + offset, min(job->stripBytes, job->imageBytes - offset)))
 			{
-				_data[index] = *(p + i);
-				if(i == (sizeOfTiff / 2) - 1) {index++; break;}
-				index++;
+				PANTHEIOS_TRACE_ERROR(PSTR("Error in TIFFReadEncodedStrip: "), pantheios::integer(strip));
+				job->failed = true;
 			}
 		}
-		PANTHEIOS_TRACE_DEBUG(PSTR("TIFFReadEncodedStrip put "), pantheios::integer(sizeOfTiff),PSTR(" bytes"));
-		_TIFFfree(buf);
+		catch(TIFFException& e)		// ErrorHandler throws on decoding errors, must not leave the thread
+		{
+			PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in TIFFReadEncodedStrip "),e.what());
+			job->failed = true;
+		}
 	}
-	else
+}
+
+/**
+ * Opens own handler of the file and decodes strips of the job
+ * \param[in,out] job	strips to decode
+ * \remarks libtiff handlers can not be shared between threads
+*/
+static void StripWorker(STRIP_JOB* job)
+{
+	TIFF* tif;
+	try
+	{
+		tif = TIFFOpen(job->image_name, "r");
+	}
+	catch(TIFFException& e)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in TIFFOpen "),e.what());
+		tif = NULL;
+	}
+	if(NULL==tif)
+	{
+		job->failed = true;
+		return;
+	}
+	DecodeStrips(tif, job);
+	TIFFClose(tif);
+}
+
+/** 
+ * \details Reads Tiff image as Tiff_ReadImage decoding strips on many threads. Compressed (e.g. LZW or Deflate) strips
+ * are independent, so every thread opens own handler of the file and decodes strips directly into \a _data.
+ * Uncompressed native-endian images are copied from memory-mapped file as in Tiff_ReadImage, without threads.
+ * \param[in] image_name	name and path to the input image
+ * \param[out] _data	pointer to memory block that will hold read image
+ * \param[in] nthreads	number of threads, 0 uses all cores, limited to number of strips
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li FILE_READ_ERROR - Problem with file reading or interpreting
+ * \li OTHER_ERROR - Undefined error
+ * \see Tiff_ReadImage
+ * \remarks Image written as one strip (e.g. by Tiff_WriteImage) is decoded by one thread. Tiled images are not supported,
+ * see checkTIFF.
+*/
+extern "C" __declspec(dllexport) BYTE Tiff_ReadImageParallel(const char* image_name, UINT16* const _data, UINT16 nthreads)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	UINT32 nrows;
+	TIFF* tif;										// handler of file used by calling thread
+	STRIP_JOB job;
+	MAPPED_FILE mapped;								// file opened for copying uncompressed strips
+	BYTE err;
+	std::vector<std::thread> workers;				// threads decoding strips beside calling thread
+	if(NULL==_data)																				// Something wrong on LV side
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	// ---------- Reading tiff ----------
+	TIFFSetWarningHandler(WarnHandler);													// redirecting warnings to log
+	TIFFSetErrorHandler(ErrorHandler);													// redirecting errors to log
+	try
+	{
+		tif = TIFFOpen(image_name, "r");												// open image
+	}
+	catch(TIFFException& e)	// caught also read/write exceptions
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in TIFFOpen "),e.what());
+		return FILE_READ_ERROR;
+	}
+	PANTHEIOS_TRACE_DEBUG(PSTR("File to open: "), image_name);
+	if(NULL==tif)																								// error during opening
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Error in opening image: "), image_name);
+		return FILE_READ_ERROR;
+	}
+	if(OK != checkTIFF(tif))
 	{
 		PANTHEIOS_TRACE_ERROR(PSTR("Unsuported Tiff"));
 		TIFFClose(tif);
 		return FILE_READ_ERROR;
 	}
+	if(OK == checkRawTIFF(tif) && OK == OpenMappedFile(image_name, &mapped))			// nothing to decode
+	{
+		err = ReadMappedStrips(&mapped, tif, _data);
+		CloseMappedFile(&mapped);
+		if(OK == err)
+		{
+			TIFFClose(tif);
+			PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+			return OK;
+		}
+	}
+	// ---------- Decoding strips ----------
+	TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &nrows);
+	job.image_name = image_name;
+	job.out = reinterpret_cast<BYTE*>(_data);
+	job.imageBytes = TIFFScanlineSize(tif)*static_cast<tsize_t>(nrows);
+	job.stripBytes = TIFFStripSize(tif);
+	job.nstrips = TIFFNumberOfStrips(tif);
+	job.next = 0;
+	job.failed = false;
+	if(0==nthreads)
+		nthreads = static_cast<UINT16>(max(1u, std::thread::hardware_concurrency()));
+	if(nthreads > job.nstrips)
+		nthreads = static_cast<UINT16>(max(1u, job.nstrips));
+	PANTHEIOS_TRACE_DEBUG(PSTR("Strips: "), pantheios::integer(job.nstrips), PSTR(" threads: "), pantheios::integer(nthreads));
+	try
+	{
+		workers.reserve(nthreads-1);
+		for(UINT16 t = 1; t < nthreads; t++)
+			workers.push_back(std::thread(StripWorker, &job));
+	}
+	catch(std::exception&)	// no resources for more threads, the others take remaining strips
+	{
+	}
+	DecodeStrips(tif, &job);
+	for(size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
 	TIFFClose(tif);
+	if(job.failed)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Error in decoding strips"));
+		return OTHER_ERROR;
+	}
 	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
 	return OK;
 }
 
+/**
+ * Sets tags of 16 bit grayscale image written by this library as one uncompressed strip
+ * \param[in] tif	handler from TIFFOpen opened for writing
+ * \param[in] _nrows - number of rows of the image (height)
+ * \param[in] _ncols - number of columns of the image (width)
+ * \throw TIFFException if any tag could not be set
+*/
+void SetImageFields(TIFF* tif, UINT16 _nrows, UINT16 _ncols)
+{
+	if(0==TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, _ncols)) throw TIFFException("Error TIFFSetField");
+	if(0==TIFFSetField(tif, TIFFTAG_IMAGELENGTH, _nrows)) throw TIFFException("Error TIFFSetField");
+	if(0==TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 16)) throw TIFFException("Error TIFFSetField");
+	if(0==TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1)) throw TIFFException("Error TIFFSetField");
+	if(0==TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, _nrows)) throw TIFFException("Error TIFFSetField");
+
+	if(0==TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE)) throw TIFFException("Error TIFFSetField");
+	if(0==TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK)) throw TIFFException("Error TIFFSetField");
+	if(0==TIFFSetField(tif, TIFFTAG_FILLORDER, FILLORDER_MSB2LSB)) throw TIFFException("Error TIFFSetField");
+	if(0==TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG)) throw TIFFException("Error TIFFSetField");
+
+	if(0==TIFFSetField(tif, TIFFTAG_XRESOLUTION, 150.0)) throw TIFFException("Error TIFFSetField");
+	if(0==TIFFSetField(tif, TIFFTAG_YRESOLUTION, 150.0)) throw TIFFException("Error TIFFSetField");
+	if(0==TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH)) throw TIFFException("Error TIFFSetField");
+	if(0==TIFFSetField(tif, TIFFTAG_SOFTWARE, "LV")) throw TIFFException("Error TIFFSetField");
+}
+
 /** 
  * \details Writes Tiff image to file
  * \param[in] image_name - name and path to the input image
@@ -222,21 +598,7 @@ extern "C" __declspec(dllexport) BYTE Tiff_WriteImage(const char* image_name, UI
 	// set fields
 	try
 	{
-		if(0==TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, _ncols)) throw TIFFException("Error TIFFSetField");
-		if(0==TIFFSetField(tif, TIFFTAG_IMAGELENGTH, _nrows)) throw TIFFException("Error TIFFSetField");
-		if(0==TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 16)) throw TIFFException("Error TIFFSetField");
-		if(0==TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1)) throw TIFFException("Error TIFFSetField");
-		if(0==TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, _nrows)) throw TIFFException("Error TIFFSetField");
-
-		if(0==TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE)) throw TIFFException("Error TIFFSetField");
-		if(0==TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK)) throw TIFFException("Error TIFFSetField");
-		if(0==TIFFSetField(tif, TIFFTAG_FILLORDER, FILLORDER_MSB2LSB)) throw TIFFException("Error TIFFSetField");
-		if(0==TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG)) throw TIFFException("Error TIFFSetField");
-
-		if(0==TIFFSetField(tif, TIFFTAG_XRESOLUTION, 150.0)) throw TIFFException("Error TIFFSetField");
-		if(0==TIFFSetField(tif, TIFFTAG_YRESOLUTION, 150.0)) throw TIFFException("Error TIFFSetField");
-		if(0==TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH)) throw TIFFException("Error TIFFSetField");
-		if(0==TIFFSetField(tif, TIFFTAG_SOFTWARE, "LV")) throw TIFFException("Error TIFFSetField");
+		SetImageFields(tif, _nrows, _ncols);
 	}
 	catch(TIFFException& e) // caught also read/write exceptions
 	{
@@ -338,3 +700,129 @@ extern "C" __declspec(dllexport) BYTE Tiff_WriteImage(const char* image_name, UI
 		 return UNSUPPORTED_IMAGE;	 
 	 }
  }
+
+ /**
+  * Checks whether strips of TIFF image can be copied from file without decoding.
+  * \param[in] tiff Handler from TIFFOpen
+  * \return operation status
+  * \retval error_codes defined in error_codes.h
+  * \li OK - image is uncompressed, native-endian, MSB2LSB and every strip holds complete rows of 16 bit pixels
+  * \li UNSUPPORTED_IMAGE - image must be decoded by libtiff
+  * \warning tif must be initialized before and must pass checkTIFF
+  */
+ EXPORTTESTING BYTE checkRawTIFF( TIFF* tif )
+ {
+	 PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	 _ASSERT(tif);	// if NULL pointer
+	 UINT16 compression, fillOrder, planarConfig;
+	 UINT32 ncols, nrows, rowsPerStrip;
+	 toff_t* byteCounts;
+
+	 TIFFGetFieldDefaulted(tif, TIFFTAG_COMPRESSION, &compression);
+	 TIFFGetFieldDefaulted(tif, TIFFTAG_FILLORDER, &fillOrder);						// libtiff reverses bits of LSB2MSB data
+	 TIFFGetFieldDefaulted(tif, TIFFTAG_PLANARCONFIG, &planarConfig);
+	 if( COMPRESSION_NONE!=compression ||
+		 FILLORDER_MSB2LSB!=fillOrder ||
+		 PLANARCONFIG_CONTIG!=planarConfig ||
+		 TIFFIsByteSwapped(tif) ||													// pixels are not in native order
+		 TIFFIsTiled(tif) ||
+		 1!=TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &ncols) ||
+		 1!=TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &nrows) ||
+		 1!=TIFFGetField(tif, TIFFTAG_STRIPBYTECOUNTS, &byteCounts) ||
+		 0==ncols || 0==nrows)
+	 {
+		 PANTHEIOS_TRACE_DEBUG(PSTR("Image must be decoded"));
+		 return UNSUPPORTED_IMAGE;
+	 }
+	 TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+	 if(rowsPerStrip > nrows)
+		 rowsPerStrip = nrows;
+	 tstrip_t nstrips = TIFFNumberOfStrips(tif);
+	 if(nstrips != (nrows + rowsPerStrip - 1)/rowsPerStrip)
+	 {
+		 PANTHEIOS_TRACE_DEBUG(PSTR("Wrong number of strips: "), pantheios::integer(nstrips));
+		 return UNSUPPORTED_IMAGE;
+	 }
+	 for(tstrip_t strip = 0; strip < nstrips; strip++)								// every strip must hold its rows
+	 {
+		 UINT32 rows = strip+1 < nstrips ? rowsPerStrip : nrows - strip*rowsPerStrip;
+		 if(static_cast<ULONGLONG>(byteCounts[strip]) < static_cast<ULONGLONG>(rows)*ncols*sizeof(UINT16))
+		 {
+			 PANTHEIOS_TRACE_DEBUG(PSTR("Strip too short: "), pantheios::integer(strip));
+			 return UNSUPPORTED_IMAGE;
+		 }
+	 }
+	 PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	 return OK;
+ }
+
+ /**
+  * Writes image in strips of given height and compression, used by tests to produce files that are decoded by libtiff.
+  * \param[in] image_name name and path to the output image
+  * \param[in] _data pointer to image
+  * \param[in] _nrows number of rows of the image (height)
+  * \param[in] _ncols number of columns of the image (width)
+  * \param[in] compression value of TIFFTAG_COMPRESSION, e.g. COMPRESSION_LZW (5) or COMPRESSION_ADOBE_DEFLATE (8)
+  * \param[in] rowsPerStrip number of rows of every strip but the last one
+  * \return operation status
+  * \retval error_codes defined in error_codes.h
+  * \li OK - no error
+  * \li NULL_POINTER - NULL pointer passed to function
+  * \li WRONG_PARAMETER - rowsPerStrip is 0
+  * \li FILE_READ_ERROR - Problem with writing
+  * \li OTHER_ERROR - tags could not be set, e.g. unsupported compression
+  * \remarks Data of the last strip is shorter when \a rowsPerStrip does not divide \a _nrows
+  */
+ EXPORTTESTING BYTE writeStripTIFF( const char* image_name, UINT16* const _data, UINT16 _nrows, UINT16 _ncols, UINT16 compression, UINT32 rowsPerStrip )
+ {
+	 PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	 TIFF* tif;
+	 if(NULL==image_name || NULL==_data)
+	 {
+		 PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		 return NULL_POINTER;
+	 }
+	 if(0==rowsPerStrip)
+		 return WRONG_PARAMETER;
+	 TIFFSetWarningHandler(WarnHandler);
+	 TIFFSetErrorHandler(ErrorHandler);
+	 try
+	 {
+		 tif = TIFFOpen(image_name, "w");
+	 }
+	 catch(TIFFException& e)
+	 {
+		 PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in TIFFOpen "), e.what());
+		 return FILE_READ_ERROR;
+	 }
+	 try
+	 {
+		 SetImageFields(tif, _nrows, _ncols);
+		 if(0==TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rowsPerStrip)) throw TIFFException("Error TIFFSetField");
+		 if(0==TIFFSetField(tif, TIFFTAG_COMPRESSION, compression)) throw TIFFException("Error TIFFSetField");
+	 }
+	 catch(TIFFException& e)
+	 {
+		 PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in TIFFSetField "),e.what());
+		 TIFFClose(tif);
+		 return OTHER_ERROR;
+	 }
+	 try
+	 {
+		 for(UINT32 row = 0, strip = 0; row < _nrows; row += rowsPerStrip, strip++)
+		 {
+			 UINT32 rows = rowsPerStrip < _nrows - row ? rowsPerStrip : _nrows - row;
+			 if(-1==TIFFWriteEncodedStrip(tif, strip, _data + row*_ncols, static_cast<tsize_t>(rows)*_ncols*2))
+				 throw TIFFException("Error TIFFWriteEncodedStrip");
+		 }
+	 }
+	 catch(TIFFException& e)
+	 {
+		 PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in writing strips "),e.what());
+		 TIFFClose(tif);
+		 return FILE_READ_ERROR;
+	 }
+	 TIFFClose(tif);
+	 PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	 return OK;
+ }
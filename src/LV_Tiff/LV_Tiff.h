@@ -1,8 +1,8 @@
 /**
  * \file    LV_Tiff.h
  * \brief	Headers and definitions for LV_Tiff.dll		
- * \details Contains only definitions of methods that are not exported in release but are exported in debug. This file can be linked to TEST in
- * order to perform tests
+ * \details Contains definitions of methods that are not exported in release but are exported in debug. This file can be linked to TEST in
+ * order to perform tests. Also declares internal functions shared by source files of the library.
  * \author  PB
  * \date    2014/01/22
  */
@@ -16,5 +16,28 @@ EXPORTTESTING void WarnHandler(const char* title, const char* format, va_list pa
 EXPORTTESTING void ErrorHandler(const char* title, const char* format, va_list params);
 /// Check Tiff image for selected properties
 EXPORTTESTING BYTE checkTIFF(TIFF* tif);
+/// Checks whether Tiff image can be read without decoding
+EXPORTTESTING BYTE checkRawTIFF(TIFF* tif);
+/// Writes Tiff image in compressed strips for tests
+EXPORTTESTING BYTE writeStripTIFF(const char* image_name, UINT16* const _data, UINT16 _nrows, UINT16 _ncols, UINT16 compression, UINT32 rowsPerStrip);
+
+/**
+ * File opened for memory-mapped reading of uncompressed strips
+ */
+struct MAPPED_FILE
+{
+	HANDLE file;			///< handle of the file
+	HANDLE mapping;			///< mapping object, views are mapped per image
+	ULONGLONG size;			///< size of the file in bytes
+};
+
+/// Opens file for memory-mapped reading
+BYTE OpenMappedFile(const char* image_name, MAPPED_FILE* mapped);
+/// Releases file opened by OpenMappedFile
+void CloseMappedFile(MAPPED_FILE* mapped);
+/// Reads image of current directory into user's buffer
+BYTE ReadCurrentImage(const MAPPED_FILE* mapped, TIFF* tif, UINT16* const _data);
+/// Sets tags of image written by the library
+void SetImageFields(TIFF* tif, UINT16 _nrows, UINT16 _ncols);
 
 #endif // LV_Tiff_h__
@@ -0,0 +1,450 @@
+/**
+ * \file    TiffStack.cpp
+ * \brief	Multi-page Tiff files holding stacks of frames
+ * \details Stack is opened once and keeps its libtiff handler between calls, so reading or writing many frames does
+ * not pay for opening the file every time. Offsets of all directories are collected when the stack is opened for
+ * reading, thus any page is reached by one TIFFSetSubDirectory without walking the chain of directories. Stacks of
+ * uncompressed frames keep also the file mapping object, every page maps only the range of the file holding its strips.
+ * Exports the following functions:
+ * - Tiff_StackOpen - Opens multi-page file for reading
+ * - Tiff_StackCreate - Creates multi-page file for appending frames
+ * - Tiff_StackGetParams - Returns number of pages and size of frames
+ * - Tiff_StackReadPage - Loads one page into user's buffer
+ * - Tiff_StackReadPages - Loads range of pages into contiguous user's buffer
+ * - Tiff_StackAppend - Writes frame as the next page
+ * - Tiff_StackClose - Closes the file
+ * \author  PB
+ * \date    2014/03/14
+ */
+
+#include "stdafx.h"
+#include "LV_Tiff.h"
+
+/// marks valid stack, cleared on closing
+#define STACK_MAGIC 0x54535443
+/// largest file offset of classic Tiff, offsets are 32 bit
+#define TIFF_MAX_OFFSET 0xFFFFFFFFull
+/// upper bound of bytes of page directory with fields of SetImageFields, including tag values stored outside it
+#define PAGE_DIRECTORY_BYTES 512
+
+/**
+ * Multi-page file opened for reading or writing, opaque for the caller
+ */
+struct TIFF_STACK
+{
+	unsigned int magic;					///< STACK_MAGIC for valid stack
+	TIFF* tif;							///< handler of file
+	MAPPED_FILE mapped;					///< file opened for copying uncompressed pages
+	bool isMapped;						///< mapped is opened, otherwise pages are decoded by libtiff
+	bool writing;						///< opened by Tiff_StackCreate
+	UINT16 nrows;						///< rows of every frame
+	UINT16 ncols;						///< columns of every frame
+	UINT32 npages;						///< pages in file, pages written so far when writing
+	std::vector<toff_t> offsets;		///< offsets of directories of all pages, empty when writing
+	std::mutex lock;					///< serializes calls on the stack
+};
+
+/**
+ * Checks that stack is valid and opened in given mode
+ * \param[in] stack	stack to check
+ * \param[in] writing	required mode
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - stack can be used
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - stack is not valid or is opened in other mode
+ * \warning Magic is a best-effort debug check only. Memory of closed stack is freed, so reading its magic is undefined
+ * and a stale pointer is not reliably detected. Caller must not use stack after Tiff_StackClose.
+*/
+static BYTE checkStack(const TIFF_STACK* stack, bool writing)
+{
+	if(NULL==stack)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(STACK_MAGIC!=stack->magic || writing!=stack->writing)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Invalid stack or wrong mode"));
+		return WRONG_PARAMETER;
+	}
+	return OK;
+}
+
+/**
+ * Reads one page of the stack
+ * \param[in] stack	stack opened for reading
+ * \param[in] page	number of page, smaller than number of pages
+ * \param[out] _data	pointer to memory block of nrows*ncols pixels
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li FILE_READ_ERROR - page can not be read, is unsupported or has other size than the first page
+ * \li OTHER_ERROR - strip could not be decoded
+*/
+static BYTE ReadStackPage(TIFF_STACK* stack, UINT32 page, UINT16* const _data)
+{
+	UINT32 ncols, nrows;
+	try
+	{
+		if(0==TIFFSetSubDirectory(stack->tif, stack->offsets[page]))				// directory at cached offset
+		{
+			PANTHEIOS_TRACE_ERROR(PSTR("Error in TIFFSetSubDirectory, page: "), pantheios::integer(page));
+			return FILE_READ_ERROR;
+		}
+	}
+	catch(TIFFException& e)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in TIFFSetSubDirectory "),e.what());
+		return FILE_READ_ERROR;
+	}
+	if(OK!=checkTIFF(stack->tif) ||
+		1!=TIFFGetField(stack->tif, TIFFTAG_IMAGEWIDTH, &ncols) ||
+		1!=TIFFGetField(stack->tif, TIFFTAG_IMAGELENGTH, &nrows) ||
+		ncols!=stack->ncols || nrows!=stack->nrows)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Unsuported page: "), pantheios::integer(page));
+		return FILE_READ_ERROR;
+	}
+	return ReadCurrentImage(stack->isMapped ? &stack->mapped : NULL, stack->tif, _data);
+}
+
+/**
+ * \details Opens multi-page Tiff for reading and collects offsets of directories of all pages. Pages must meet
+ * requirements of Tiff_ReadImage and have the same size.
+ * \param[in] image_name	name and path to the input image
+ * \param[out] stack	opened stack, must be released by Tiff_StackClose
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li FILE_READ_ERROR - Problem with file reading or interpreting
+ * \li OTHER_ERROR - Undefined error
+ * \remarks Size of frames is taken from the first page, other pages are verified when read.
+*/
+extern "C" __declspec(dllexport) BYTE Tiff_StackOpen(const char* image_name, TIFF_STACK** stack)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	TIFF* tif;										// handler of file
+	TIFF_STACK* s;
+	UINT32 ncols, nrows;
+	if(NULL==image_name || NULL==stack)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	*stack = NULL;
+	TIFFSetWarningHandler(WarnHandler);													// redirecting warnings to log
+	TIFFSetErrorHandler(ErrorHandler);													// redirecting errors to log
+	try
+	{
+		tif = TIFFOpen(image_name, "r");												// open image
+	}
+	catch(TIFFException& e)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in TIFFOpen "),e.what());
+		return FILE_READ_ERROR;
+	}
+	PANTHEIOS_TRACE_DEBUG(PSTR("File to open: "), image_name);
+	if(NULL==tif)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Error in opening image: "), image_name);
+		return FILE_READ_ERROR;
+	}
+	if(OK!=checkTIFF(tif) ||
+		1!=TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &ncols) ||
+		1!=TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &nrows))
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Unsuported Tiff"));
+		TIFFClose(tif);
+		return FILE_READ_ERROR;
+	}
+	try
+	{
+		s = new TIFF_STACK;
+	}
+	catch(std::bad_alloc&)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Memory allocation failed"));
+		TIFFClose(tif);
+		return OTHER_ERROR;
+	}
+	s->tif = tif;
+	s->isMapped = OK==checkRawTIFF(tif) && OK==OpenMappedFile(image_name, &s->mapped);	// once for all pages
+	s->writing = false;
+	s->nrows = static_cast<UINT16>(nrows);
+	s->ncols = static_cast<UINT16>(ncols);
+	// ---------- Walking the chain of directories once ----------
+	try
+	{
+		do
+			s->offsets.push_back(TIFFCurrentDirOffset(tif));
+		while(TIFFReadDirectory(tif));
+	}
+	catch(TIFFException& e)	// broken directory, pages before it are still available
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in TIFFReadDirectory "),e.what());
+	}
+	s->npages = static_cast<UINT32>(s->offsets.size());
+	s->magic = STACK_MAGIC;
+	*stack = s;
+	PANTHEIOS_TRACE_DEBUG(PSTR("Pages: "), pantheios::integer(s->npages), PSTR(" size [rows;cols] ["), pantheios::integer(nrows), PSTR(","), pantheios::integer(ncols), PSTR("]"));
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * \details Creates multi-page Tiff for writing. Frames are added by Tiff_StackAppend, every frame becomes one page
+ * written as Tiff_WriteImage does. Existing file is overwritten. File is classic Tiff with 32 bit offsets, so it can
+ * not grow over 4 GiB, e.g. 8000 frames of 512x512 pixels.
+ * \param[in] image_name	name and path to the output image
+ * \param[in] _nrows	number of rows of every frame (height)
+ * \param[in] _ncols	number of columns of every frame (width)
+ * \param[out] stack	created stack, must be released by Tiff_StackClose
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - empty frame
+ * \li FILE_READ_ERROR - Problem with file opening
+ * \li OTHER_ERROR - Undefined error
+*/
+extern "C" __declspec(dllexport) BYTE Tiff_StackCreate(const char* image_name, UINT16 _nrows, UINT16 _ncols, TIFF_STACK** stack)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	TIFF* tif;										// handler of file
+	TIFF_STACK* s;
+	if(NULL==image_name || NULL==stack)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	*stack = NULL;
+	if(0==_nrows || 0==_ncols)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Wrong frame size: "), pantheios::integer(_nrows), PSTR("x"), pantheios::integer(_ncols));
+		return WRONG_PARAMETER;
+	}
+	TIFFSetWarningHandler(WarnHandler);													// redirecting warnings to log
+	TIFFSetErrorHandler(ErrorHandler);													// redirecting errors to log
+	try
+	{
+		tif = TIFFOpen(image_name, "w");												// open image
+	}
+	catch(TIFFException& e)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in TIFFOpen "), e.what());
+		return FILE_READ_ERROR;
+	}
+	if(NULL==tif)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Error in opening image: "), image_name);
+		return FILE_READ_ERROR;
+	}
+	try
+	{
+		s = new TIFF_STACK;
+	}
+	catch(std::bad_alloc&)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("Memory allocation failed"));
+		TIFFClose(tif);
+		return OTHER_ERROR;
+	}
+	s->tif = tif;
+	s->isMapped = false;
+	s->writing = true;
+	s->nrows = _nrows;
+	s->ncols = _ncols;
+	s->npages = 0;
+	s->magic = STACK_MAGIC;
+	*stack = s;
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * \details Returns number of pages and size of frames of the stack
+ * \param[in] stack	stack from Tiff_StackOpen or Tiff_StackCreate
+ * \param[out] _npages	number of pages, pages written so far for created stack
+ * \param[out] _nrows	number of rows (height)
+ * \param[out] _ncols	number of cols (width)
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - stack is not valid
+*/
+extern "C" __declspec(dllexport) BYTE Tiff_StackGetParams(TIFF_STACK* stack, UINT32* const _npages, UINT16* const _nrows, UINT16* const _ncols)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	if(NULL==_npages || NULL==_nrows || NULL==_ncols)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	if(NULL==stack || STACK_MAGIC!=stack->magic)
+		return checkStack(stack, false);
+	std::lock_guard<std::mutex> guard(stack->lock);
+	*_npages = stack->npages;
+	*_nrows = stack->nrows;
+	*_ncols = stack->ncols;
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * \details Reads range of pages of the stack into one contiguous buffer, frame after frame
+ * \param[in] stack	stack from Tiff_StackOpen
+ * \param[in] first	number of first page, starting from 0
+ * \param[in] count	number of pages
+ * \param[out] _data	pointer to memory block of count*nrows*ncols pixels
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - stack is not valid or not opened for reading, pages out of range
+ * \li FILE_READ_ERROR - page can not be read, is unsupported or has other size than the first page
+ * \li OTHER_ERROR - Undefined error
+ * \remarks Reading stops at the first page that can not be read.
+*/
+extern "C" __declspec(dllexport) BYTE Tiff_StackReadPages(TIFF_STACK* stack, UINT32 first, UINT32 count, UINT16* const _data)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	BYTE err;
+	if(NULL==_data)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	err = checkStack(stack, false);
+	if(OK!=err)
+		return err;
+	std::lock_guard<std::mutex> guard(stack->lock);
+	if(first>=stack->npages || count>stack->npages-first)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Pages out of range: "), pantheios::integer(first), PSTR("+"), pantheios::integer(count), PSTR(" of "), pantheios::integer(stack->npages));
+		return WRONG_PARAMETER;
+	}
+	size_t npix = static_cast<size_t>(stack->nrows)*stack->ncols;
+	for(UINT32 p=0;p<count;p++)
+	{
+		err = ReadStackPage(stack, first+p, _data + p*npix);
+		if(OK!=err)
+			return err;
+	}
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * \details Reads one page of the stack, page is reached directly by its cached directory offset
+ * \param[in] stack	stack from Tiff_StackOpen
+ * \param[in] page	number of page, starting from 0
+ * \param[out] _data	pointer to memory block of nrows*ncols pixels
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - stack is not valid or not opened for reading, page out of range
+ * \li FILE_READ_ERROR - page can not be read, is unsupported or has other size than the first page
+ * \li OTHER_ERROR - Undefined error
+*/
+extern "C" __declspec(dllexport) BYTE Tiff_StackReadPage(TIFF_STACK* stack, UINT32 page, UINT16* const _data)
+{
+	return Tiff_StackReadPages(stack, page, 1, _data);
+}
+
+/**
+ * \details Writes frame as the next page of the stack
+ * \param[in] stack	stack from Tiff_StackCreate
+ * \param[in] _data	pointer to frame of nrows*ncols pixels
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - stack is not valid or not created for writing
+ * \li FILE_TOO_LARGE - page would end beyond 4 GiB, nothing is written and pages written so far stay readable
+ * \li FILE_READ_ERROR - Problem with writing
+ * \li OTHER_ERROR - Undefined error
+ * \remarks Classic Tiff addresses strips and directories by 32 bit offsets. The page is checked against the current
+ * end of the file before writing, because libtiff would otherwise write past the limit and produce a broken file.
+*/
+extern "C" __declspec(dllexport) BYTE Tiff_StackAppend(TIFF_STACK* stack, UINT16* const _data)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	BYTE err;
+	UINT64 end;										// offset at which the page will be written
+	if(NULL==_data)
+	{
+		PANTHEIOS_TRACE_CRITICAL(PSTR("NULL input pointer"));
+		return NULL_POINTER;
+	}
+	err = checkStack(stack, true);
+	if(OK!=err)
+		return err;
+	std::lock_guard<std::mutex> guard(stack->lock);
+	end = TIFFGetSeekProc(stack->tif)(TIFFClientdata(stack->tif), 0, SEEK_END);	// libtiff appends pages at the end
+	if(end + static_cast<UINT64>(stack->nrows) * stack->ncols * 2 + PAGE_DIRECTORY_BYTES > TIFF_MAX_OFFSET)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Classic Tiff can not exceed 4 GiB, pages written: "), pantheios::integer(stack->npages));
+		return FILE_TOO_LARGE;
+	}
+	try
+	{
+		SetImageFields(stack->tif, stack->nrows, stack->ncols);
+		if(0==TIFFSetField(stack->tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE)) throw TIFFException("Error TIFFSetField");
+	}
+	catch(TIFFException& e)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in TIFFSetField "),e.what());
+		return OTHER_ERROR;
+	}
+	try
+	{
+		if(-1==TIFFWriteEncodedStrip(stack->tif, 0, _data, static_cast<tsize_t>(stack->nrows) * stack->ncols * 2) ||
+			0==TIFFWriteDirectory(stack->tif))												// closes page, next fields go to new one
+		{
+			PANTHEIOS_TRACE_ERROR(PSTR("Error in writing page: "), pantheios::integer(stack->npages));
+			return FILE_READ_ERROR;
+		}
+	}
+	catch(TIFFException& e)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in writing page "),e.what());
+		return FILE_READ_ERROR;
+	}
+	stack->npages++;
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
+
+/**
+ * \details Closes stack opened by Tiff_StackOpen or Tiff_StackCreate, created file is complete after this call
+ * \param[in] stack	stack, invalid after this call, closing it again is undefined (see checkStack)
+ * \return operation status
+ * \retval error_codes defined in error_codes.h
+ * \li OK - no error
+ * \li NULL_POINTER - NULL pointer passed to function
+ * \li WRONG_PARAMETER - stack is not valid
+*/
+extern "C" __declspec(dllexport) BYTE Tiff_StackClose(TIFF_STACK* stack)
+{
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Entering"));
+	if(NULL==stack || STACK_MAGIC!=stack->magic)
+		return checkStack(stack, false);
+	stack->magic = 0;
+	try
+	{
+		TIFFClose(stack->tif);
+	}
+	catch(TIFFException& e)
+	{
+		PANTHEIOS_TRACE_ERROR(PSTR("Caught exception in TIFFClose "),e.what());
+	}
+	if(stack->isMapped)
+		CloseMappedFile(&stack->mapped);
+	delete stack;
+	PANTHEIOS_TRACE_INFORMATIONAL(PSTR("Leaving"));
+	return OK;
+}
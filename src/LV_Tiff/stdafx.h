@@ -14,6 +14,9 @@
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <mutex>
 #include "tiffio.h"
 #include "Pantheios_header.h"
 #include "TIFFException.h"
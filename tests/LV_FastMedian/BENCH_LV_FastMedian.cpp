@@ -0,0 +1,238 @@
+/**
+ * \file    BENCH_LV_FastMedian.cpp
+ * \brief	Benchmarks of median engines exported by LV_FastMedian
+ * \details Sweeps engines over mask sizes, image sizes, bit depths and thread counts and reports Mpixel/s. Before timing,
+ * output of every configuration is compared on ORACLE_SAMPLES pixels with brute-force median (nth_element, as getMedian),
+ * configurations giving different result are reported as errors. The whole sweep takes hours, use --benchmark_filter,
+ * e.g. --benchmark_filter="engine:2/mask:101/size:2048".
+ * \remarks Unlike the rest of the solution the project is built with v140 toolset (Visual Studio 2015), v110 does not
+ * compile initializer lists used by Google benchmark and this file. External_dep\benchmark must be built with the same
+ * toolset. LV_FastMedian.dll is loaded at runtime through its C interface and stays on v110. The project is excluded
+ * from Build Solution and is built on demand, so machines without v140 still build the rest of the solution.
+ * \author  PB
+ * \date    2014/03/07
+ */
+
+#include "targetver.h"
+
+#include <windows.h>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "benchmark/benchmark.h"
+#include "error_codes.h"
+
+using namespace std;
+
+typedef void (*p_LV_MedFilt)(const UINT16*, UINT16*, UINT16, UINT16, UINT16);
+typedef BYTE (*p_LV_MedFiltEngine)(const UINT16*, UINT16*, UINT16, UINT16, UINT16, UINT16, UINT16);
+typedef BYTE (*p_LV_MedFiltBits)(const UINT16*, UINT16*, UINT16, UINT16, UINT16, UINT16, UINT16);
+
+/// number of pixels of every configuration compared with oracle
+#define ORACLE_SAMPLES 4096
+
+/**
+ * Engines benchmarked, first five are MEDIAN_ENGINE
+ */
+enum BENCH_ENGINE
+{
+	BENCH_HUANG = 0,			/**< HUANG specialised on bit depth, LV_MedFiltBits */
+	BENCH_HUANG_SERPENTINE = 1,	/**< LV_MedFiltEngine */
+	BENCH_CONSTANT_TIME = 2,	/**< LV_MedFiltEngine */
+	BENCH_SORTING_NETWORK = 3,	/**< LV_MedFiltEngine, masks up to 7 only */
+	BENCH_HUANG_MULTIROW = 4,	/**< LV_MedFiltEngine */
+	BENCH_DISPATCH = 5			/**< LV_MedFilt, engine and threads selected by dispatcher */
+};
+
+static HINSTANCE hinstLib;
+static p_LV_MedFilt LV_MedFilt;
+static p_LV_MedFiltEngine LV_MedFiltEngine;
+static p_LV_MedFiltBits LV_MedFiltBits;
+
+/**
+ * Cache of the last generated input image, benchmarks of the same size and bit depth run one after another
+ */
+static struct
+{
+	vector<UINT16> tab;	///< image
+	int size;			///< number of rows and columns
+	int bits;			///< bit depth
+} input = {vector<UINT16>(), 0, 0};
+
+/**
+ * Returns square noise image of given size and bit depth
+ * \param[in] size		number of rows and columns
+ * \param[in] bits		bit depth
+ * \return image, valid until next call
+*/
+static const vector<UINT16>& getInput(int size, int bits)
+{
+	unsigned int seed = 1;
+	if(input.size!=size || input.bits!=bits)
+	{
+		input.tab.resize(static_cast<size_t>(size)*size);
+		for(size_t a=0;a<input.tab.size();a++)
+		{
+			seed = seed*1664525u + 1013904223u;
+			input.tab[a] = static_cast<UINT16>((seed >> 16) & ((1u<<bits)-1));
+		}
+		input.size = size;
+		input.bits = bits;
+	}
+	return input.tab;
+}
+
+/**
+ * Brute-force median of mask x mask window centred at [r,k], zeros outside the image as in LV_MedFilt
+ * \param[in] image		input image
+ * \param[in] size		number of rows and columns
+ * \param[in] mask		size of the mask
+ * \param[in] r			row
+ * \param[in] k			column
+ * \param[out] window	buffer of mask*mask elements
+ * \return median
+*/
+static UINT16 OracleMedian(const vector<UINT16> &image, int size, int mask, int r, int k, vector<UINT16> &window)
+{
+	int half = mask/2;
+	size_t l = 0;
+	for(int wr=r-half;wr<=r+half;wr++)
+		for(int wk=k-half;wk<=k+half;wk++)
+			window[l++] = (wr<0 || wk<0 || wr>=size || wk>=size) ? 0 : image[static_cast<size_t>(wr)*size+wk];
+	nth_element(window.begin(),window.begin()+window.size()/2,window.end());
+	return window[window.size()/2];
+}
+
+/**
+ * Compares output with oracle on corners and ORACLE_SAMPLES pseudo-random pixels
+ * \param[in] image		input image
+ * \param[in] output	filtered image
+ * \param[in] size		number of rows and columns
+ * \param[in] mask		size of the mask
+ * \return true if all checked pixels are equal
+*/
+static bool CheckOracle(const vector<UINT16> &image, const vector<UINT16> &output, int size, int mask)
+{
+	vector<UINT16> window(static_cast<size_t>(mask)*mask);
+	unsigned int seed = 7;
+	int r, k;
+	for(int s=0;s<ORACLE_SAMPLES;s++)
+	{
+		if(s<4)	// corners
+		{
+			r = (s & 1) ? size-1 : 0;
+			k = (s & 2) ? size-1 : 0;
+		}
+		else
+		{
+			seed = seed*1664525u + 1013904223u;
+			r = (seed >> 8) % size;
+			seed = seed*1664525u + 1013904223u;
+			k = (seed >> 8) % size;
+		}
+		if(output[static_cast<size_t>(r)*size+k]!=OracleMedian(image,size,mask,r,k,window))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Filters image with benchmarked engine
+ * \return OK or error code of the export
+*/
+static BYTE RunEngine(int engine, const vector<UINT16> &image, vector<UINT16> &output, int size, int mask, int bits, int threads)
+{
+	switch(engine)
+	{
+	case BENCH_HUANG:
+		return LV_MedFiltBits(&image[0],&output[0],size,size,mask,bits,threads);
+	case BENCH_DISPATCH:
+		LV_MedFilt(&image[0],&output[0],size,size,mask);
+		return OK;
+	default:
+		return LV_MedFiltEngine(&image[0],&output[0],size,size,mask,engine,threads);
+	}
+}
+
+/**
+ * \details Benchmark of one configuration, arguments: engine (BENCH_ENGINE), mask, size, bits, threads (0 - all cores)
+ */
+static void BM_Median(benchmark::State &state)
+{
+	int engine = static_cast<int>(state.range(0));
+	int mask = static_cast<int>(state.range(1));
+	int size = static_cast<int>(state.range(2));
+	int bits = static_cast<int>(state.range(3));
+	int threads = static_cast<int>(state.range(4));
+	const vector<UINT16> &image = getInput(size,bits);
+	vector<UINT16> output(image.size());
+
+	if(OK!=RunEngine(engine,image,output,size,mask,bits,threads))
+	{
+		state.SkipWithError("Engine returned error");
+		return;
+	}
+	if(!CheckOracle(image,output,size,mask))
+	{
+		state.SkipWithError("Output differs from nth_element oracle");
+		return;
+	}
+	for(auto _ : state)
+		RunEngine(engine,image,output,size,mask,bits,threads);
+	state.counters["Mpixel"] = benchmark::Counter(static_cast<double>(state.iterations())*size*size/1e6, benchmark::Counter::kIsRate);	// shown per second
+}
+
+/**
+ * Generates sweep of configurations
+ * \param[in] b		benchmark receiving arguments
+ * \remarks Sorting network is run for masks it supports only, dispatcher for all cores only as LV_MedFilt has no thread argument.
+*/
+static void Sweep(benchmark::internal::Benchmark *b)
+{
+	static const int masks[] = {3, 5, 7, 15, 31, 51, 101};
+	static const int sizes[] = {512, 1024, 2048, 4096, 8192};
+	static const int bits[] = {8, 12, 16};
+	static const int threads[] = {1, 0};
+	b->ArgNames({"engine", "mask", "size", "bits", "threads"});
+	for(unsigned int s=0;s<sizeof(sizes)/sizeof(sizes[0]);s++)
+		for(unsigned int d=0;d<sizeof(bits)/sizeof(bits[0]);d++)
+			for(unsigned int m=0;m<sizeof(masks)/sizeof(masks[0]);m++)
+				for(unsigned int t=0;t<sizeof(threads)/sizeof(threads[0]);t++)
+					for(int e=BENCH_HUANG;e<=BENCH_DISPATCH;e++)
+					{
+						if(BENCH_SORTING_NETWORK==e && masks[m]>7)
+							continue;
+						if(BENCH_DISPATCH==e && 0!=threads[t])
+							continue;
+						b->Args({e, masks[m], sizes[s], bits[d], threads[t]});
+					}
+}
+
+BENCHMARK(BM_Median)->Apply(Sweep)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+int main(int argc, char* argv[])
+{
+#ifdef _DEBUG
+	hinstLib = LoadLibrary(TEXT("../../../../bin/LV_FastMedian_Debug.dll"));
+#else
+	hinstLib = LoadLibrary(TEXT("../../../../bin/LV_FastMedian.dll"));
+#endif
+	if(hinstLib==NULL)
+	{
+		cerr << "Error in LoadLibrary" << endl;
+		return 1;
+	}
+	LV_MedFilt = (p_LV_MedFilt)GetProcAddress(hinstLib, "LV_MedFilt");
+	LV_MedFiltEngine = (p_LV_MedFiltEngine)GetProcAddress(hinstLib, "LV_MedFiltEngine");
+	LV_MedFiltBits = (p_LV_MedFiltBits)GetProcAddress(hinstLib, "LV_MedFiltBits");
+	if(LV_MedFilt==NULL || LV_MedFiltEngine==NULL || LV_MedFiltBits==NULL)
+	{
+		cerr << "Error in GetProcAddress" << endl;
+		FreeLibrary(hinstLib);
+		return 1;
+	}
+	benchmark::Initialize(&argc, argv);
+	benchmark::RunSpecifiedBenchmarks();
+	FreeLibrary(hinstLib);
+	return 0;
+}
@@ -6,6 +6,62 @@
 using namespace std;
 
 typedef void (*p_LV_MedFilt31)(UINT16*, UINT16*, UINT16, UINT16); 
+typedef void (*p_LV_MedFilt)(UINT16*, UINT16*, UINT16, UINT16, UINT16); 
+typedef BYTE (*p_LV_MedFiltMT)(UINT16*, UINT16*, UINT16, UINT16, UINT16, UINT16); 
+typedef BYTE (*p_LV_MedFiltEngine)(UINT16*, UINT16*, UINT16, UINT16, UINT16, UINT16, UINT16); 
+typedef BYTE (*p_LV_MedFiltBits)(UINT16*, UINT16*, UINT16, UINT16, UINT16, UINT16, UINT16); 
+typedef BYTE (*p_LV_MedFiltPlanCreate)(UINT16, UINT16, UINT16, UINT16, void**); 
+typedef BYTE (*p_LV_MedFiltPlanExecute)(void*, UINT16*, UINT16*); 
+typedef BYTE (*p_LV_MedFiltPlanDestroy)(void*); 
+typedef BYTE (*p_LV_MedFiltBorder)(UINT16*, UINT16*, UINT16, UINT16, UINT16, UINT16, UINT16, UINT16); 
+typedef BYTE (*p_LV_MedFiltBatch)(UINT16*, UINT16*, UINT32, UINT16, UINT16, UINT16, UINT16); 
+typedef BYTE (__cdecl *p_StreamSource)(void*, UINT64, UINT32, UINT16*); 
+typedef BYTE (__cdecl *p_StreamSink)(void*, UINT64, UINT32, const UINT16*); 
+typedef BYTE (*p_LV_MedFiltStream)(UINT64, UINT32, UINT16, UINT32, UINT16, UINT16, p_StreamSource, p_StreamSink, void*, UINT16); 
+typedef BYTE (*p_LV_TemporalMedianCreate)(UINT16, UINT16, UINT16, UINT16, void**); 
+typedef BYTE (*p_LV_TemporalMedianPush)(void*, UINT16*, UINT16*); 
+typedef BYTE (*p_LV_TemporalMedianDestroy)(void*); 
+typedef BYTE (*p_LV_TemporalMedianStack)(UINT16*, UINT16*, UINT32, UINT16, UINT16, UINT16, UINT16); 
+typedef BYTE (*p_LV_RankFilt)(UINT16*, UINT16*, UINT16, UINT16, UINT16, const double*, UINT16, UINT16); 
+typedef BYTE (*p_LV_MedFiltMasked)(UINT16*, UINT8*, UINT16*, UINT16, UINT16, UINT16, UINT16, UINT16, UINT16); 
+typedef BYTE (*p_LV_MedFiltFloat)(float*, float*, UINT16, UINT16, UINT16, UINT16); 
+typedef BYTE (*p_LV_MedFiltDouble)(double*, double*, UINT16, UINT16, UINT16, UINT16); 
+typedef BYTE (*p_LV_MedFiltBackground)(UINT16*, UINT16*, UINT16, UINT16, UINT16, UINT16, UINT16, UINT16, UINT16, double*, UINT16*); 
+typedef BYTE (*p_LV_MedFiltUpdate)(UINT16*, UINT16*, UINT16, UINT16, UINT16, const UINT16*, UINT16, UINT16); 
+typedef BYTE (__cdecl *p_ProgressCallback)(void*, UINT32, UINT32); 
+typedef BYTE (*p_LV_MedFiltProgress)(UINT16*, UINT16*, UINT16, UINT16, UINT16, UINT16, p_ProgressCallback, void*, volatile LONG*); 
+/// layout of MEDFILT_DISPATCH
+struct DISPATCH_TABLE
+{
+	UINT16 network_max_mask[5];
+	UINT16 ct_min_mask[5];
+	UINT32 min_band_pixels;
+};
+typedef BYTE (*p_LV_MedFiltDispatchGet)(DISPATCH_TABLE*); 
+typedef BYTE (*p_LV_MedFiltDispatchSet)(const DISPATCH_TABLE*); 
+typedef BYTE (*p_LV_MedFiltCalibrate)(DISPATCH_TABLE*); 
+/// layout of MEDFILT_VIEW
+struct IMAGE_VIEW
+{
+	UINT16 *tab;
+	UINT32 pitch;
+	UINT32 row;
+	UINT32 col;
+	UINT32 rows;
+	UINT32 cols;
+};
+typedef BYTE (*p_LV_MedFiltView)(const IMAGE_VIEW*, const IMAGE_VIEW*, UINT16, UINT16, UINT16, UINT16, UINT16); 
+typedef BYTE (*p_LV_MedFiltMaskedView)(const IMAGE_VIEW*, const UINT8*, const IMAGE_VIEW*, UINT16, UINT16, UINT16, UINT16); 
+typedef BYTE (*p_LV_RankFiltView)(const IMAGE_VIEW*, const IMAGE_VIEW*, UINT16, const double*, UINT16, UINT16); 
+typedef BYTE (*p_LV_MedFiltBackgroundView)(const IMAGE_VIEW*, const IMAGE_VIEW*, UINT16, UINT16, UINT16, UINT16, UINT16, double*, UINT16*); 
+typedef BYTE (*p_LV_MedFiltProgressView)(const IMAGE_VIEW*, const IMAGE_VIEW*, UINT16, UINT16, p_ProgressCallback, void*, volatile LONG*); 
+typedef BYTE (*p_LV_MedFiltPlanExecuteView)(void*, const IMAGE_VIEW*, const IMAGE_VIEW*); 
+
+/// Returns random pixel of full 16 bit range, rand() gives only 15 bits (RAND_MAX is 32767)
+static UINT16 rand16()
+{
+	return static_cast<UINT16>((rand()<<1) ^ rand());
+}
 
 int _tmain(int argc, _TCHAR* argv[])
 {
@@ -20,6 +76,36 @@ protected:
 	BOOL init_error;
 	HINSTANCE hinstLib; 
 	p_LV_MedFilt31 LV_MedFilt31; 
+	p_LV_MedFilt LV_MedFilt; 
+	p_LV_MedFiltMT LV_MedFiltMT; 
+	p_LV_MedFiltEngine LV_MedFiltEngine; 
+	p_LV_MedFiltBits LV_MedFiltBits; 
+	p_LV_MedFiltPlanCreate LV_MedFiltPlanCreate; 
+	p_LV_MedFiltPlanExecute LV_MedFiltPlanExecute; 
+	p_LV_MedFiltPlanDestroy LV_MedFiltPlanDestroy; 
+	p_LV_MedFiltBorder LV_MedFiltBorder; 
+	p_LV_MedFiltBatch LV_MedFiltBatch; 
+	p_LV_MedFiltStream LV_MedFiltStream; 
+	p_LV_TemporalMedianCreate LV_TemporalMedianCreate; 
+	p_LV_TemporalMedianPush LV_TemporalMedianPush; 
+	p_LV_TemporalMedianDestroy LV_TemporalMedianDestroy; 
+	p_LV_TemporalMedianStack LV_TemporalMedianStack; 
+	p_LV_RankFilt LV_RankFilt; 
+	p_LV_MedFiltMasked LV_MedFiltMasked; 
+	p_LV_MedFiltFloat LV_MedFiltFloat; 
+	p_LV_MedFiltDouble LV_MedFiltDouble; 
+	p_LV_MedFiltBackground LV_MedFiltBackground; 
+	p_LV_MedFiltUpdate LV_MedFiltUpdate; 
+	p_LV_MedFiltProgress LV_MedFiltProgress; 
+	p_LV_MedFiltDispatchGet LV_MedFiltDispatchGet; 
+	p_LV_MedFiltDispatchSet LV_MedFiltDispatchSet; 
+	p_LV_MedFiltCalibrate LV_MedFiltCalibrate; 
+	p_LV_MedFiltView LV_MedFiltView; 
+	p_LV_MedFiltMaskedView LV_MedFiltMaskedView; 
+	p_LV_RankFiltView LV_RankFiltView; 
+	p_LV_MedFiltBackgroundView LV_MedFiltBackgroundView; 
+	p_LV_MedFiltProgressView LV_MedFiltProgressView; 
+	p_LV_MedFiltPlanExecuteView LV_MedFiltPlanExecuteView; 
 	virtual void SetUp()
 	{
 		init_error = FALSE;	// no error
@@ -40,6 +126,186 @@ protected:
 		}
 		else
 			cout << "Addres of p_LV_MedFilt31: " << LV_MedFilt31 << endl;
+		LV_MedFilt = (p_LV_MedFilt)GetProcAddress(hinstLib, "LV_MedFilt"); 
+		if(LV_MedFilt==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltMT = (p_LV_MedFiltMT)GetProcAddress(hinstLib, "LV_MedFiltMT"); 
+		if(LV_MedFiltMT==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltEngine = (p_LV_MedFiltEngine)GetProcAddress(hinstLib, "LV_MedFiltEngine"); 
+		if(LV_MedFiltEngine==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltBits = (p_LV_MedFiltBits)GetProcAddress(hinstLib, "LV_MedFiltBits"); 
+		if(LV_MedFiltBits==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltPlanCreate = (p_LV_MedFiltPlanCreate)GetProcAddress(hinstLib, "LV_MedFiltPlanCreate"); 
+		if(LV_MedFiltPlanCreate==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltPlanExecute = (p_LV_MedFiltPlanExecute)GetProcAddress(hinstLib, "LV_MedFiltPlanExecute"); 
+		if(LV_MedFiltPlanExecute==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltPlanDestroy = (p_LV_MedFiltPlanDestroy)GetProcAddress(hinstLib, "LV_MedFiltPlanDestroy"); 
+		if(LV_MedFiltPlanDestroy==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltBorder = (p_LV_MedFiltBorder)GetProcAddress(hinstLib, "LV_MedFiltBorder"); 
+		if(LV_MedFiltBorder==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltBatch = (p_LV_MedFiltBatch)GetProcAddress(hinstLib, "LV_MedFiltBatch"); 
+		if(LV_MedFiltBatch==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltStream = (p_LV_MedFiltStream)GetProcAddress(hinstLib, "LV_MedFiltStream"); 
+		if(LV_MedFiltStream==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_TemporalMedianCreate = (p_LV_TemporalMedianCreate)GetProcAddress(hinstLib, "LV_TemporalMedianCreate"); 
+		if(LV_TemporalMedianCreate==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_TemporalMedianPush = (p_LV_TemporalMedianPush)GetProcAddress(hinstLib, "LV_TemporalMedianPush"); 
+		if(LV_TemporalMedianPush==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_TemporalMedianDestroy = (p_LV_TemporalMedianDestroy)GetProcAddress(hinstLib, "LV_TemporalMedianDestroy"); 
+		if(LV_TemporalMedianDestroy==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_TemporalMedianStack = (p_LV_TemporalMedianStack)GetProcAddress(hinstLib, "LV_TemporalMedianStack"); 
+		if(LV_TemporalMedianStack==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_RankFilt = (p_LV_RankFilt)GetProcAddress(hinstLib, "LV_RankFilt"); 
+		if(LV_RankFilt==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltMasked = (p_LV_MedFiltMasked)GetProcAddress(hinstLib, "LV_MedFiltMasked"); 
+		if(LV_MedFiltMasked==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltFloat = (p_LV_MedFiltFloat)GetProcAddress(hinstLib, "LV_MedFiltFloat"); 
+		if(LV_MedFiltFloat==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltDouble = (p_LV_MedFiltDouble)GetProcAddress(hinstLib, "LV_MedFiltDouble"); 
+		if(LV_MedFiltDouble==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltBackground = (p_LV_MedFiltBackground)GetProcAddress(hinstLib, "LV_MedFiltBackground"); 
+		if(LV_MedFiltBackground==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltUpdate = (p_LV_MedFiltUpdate)GetProcAddress(hinstLib, "LV_MedFiltUpdate"); 
+		if(LV_MedFiltUpdate==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltProgress = (p_LV_MedFiltProgress)GetProcAddress(hinstLib, "LV_MedFiltProgress"); 
+		if(LV_MedFiltProgress==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltDispatchGet = (p_LV_MedFiltDispatchGet)GetProcAddress(hinstLib, "LV_MedFiltDispatchGet"); 
+		if(LV_MedFiltDispatchGet==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltDispatchSet = (p_LV_MedFiltDispatchSet)GetProcAddress(hinstLib, "LV_MedFiltDispatchSet"); 
+		if(LV_MedFiltDispatchSet==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltCalibrate = (p_LV_MedFiltCalibrate)GetProcAddress(hinstLib, "LV_MedFiltCalibrate"); 
+		if(LV_MedFiltCalibrate==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltView = (p_LV_MedFiltView)GetProcAddress(hinstLib, "LV_MedFiltView"); 
+		if(LV_MedFiltView==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltMaskedView = (p_LV_MedFiltMaskedView)GetProcAddress(hinstLib, "LV_MedFiltMaskedView"); 
+		if(LV_MedFiltMaskedView==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_RankFiltView = (p_LV_RankFiltView)GetProcAddress(hinstLib, "LV_RankFiltView"); 
+		if(LV_RankFiltView==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltBackgroundView = (p_LV_MedFiltBackgroundView)GetProcAddress(hinstLib, "LV_MedFiltBackgroundView"); 
+		if(LV_MedFiltBackgroundView==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltProgressView = (p_LV_MedFiltProgressView)GetProcAddress(hinstLib, "LV_MedFiltProgressView"); 
+		if(LV_MedFiltProgressView==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
+		LV_MedFiltPlanExecuteView = (p_LV_MedFiltPlanExecuteView)GetProcAddress(hinstLib, "LV_MedFiltPlanExecuteView"); 
+		if(LV_MedFiltPlanExecuteView==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+		}
 	}
 
 	virtual void TearDown()
@@ -90,4 +356,914 @@ TEST_F(DLL_Tests,FastMedianTest)
 
 	cout << "Results in /data/test_out.dat" << endl;
 	EXPECT_EQ(1,1);
+}
+
+/**
+ * \test LV_MedFiltMT
+ * Filters random image serially and in row bands
+ * Expects:
+ * -# LV_MedFiltMT returns OK for any number of threads
+ * -# Output identical to HUANG engine
+ * -# WRONG_PARAMETER for zero or even mask
+ */
+TEST_F(DLL_Tests,LV_MedFiltMT)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 301, cols = 257, mask = 15;
+	const UINT16 threads[] = {0, 1, 2, 7, 400};
+	vector<UINT16> input_image(rows*cols), serial(rows*cols), parallel(rows*cols);
+	srand(0);
+	for(unsigned int a=0;a<input_image.size();a++)
+		input_image[a] = rand16();
+	ASSERT_EQ(OK,LV_MedFiltEngine(&input_image[0],&serial[0],rows,cols,mask,0,1));
+	for(unsigned int t=0;t<sizeof(threads)/sizeof(threads[0]);t++)
+	{
+		EXPECT_EQ(OK,LV_MedFiltMT(&input_image[0],&parallel[0],rows,cols,mask,threads[t]));
+		EXPECT_TRUE(serial==parallel);
+	}
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltMT(&input_image[0],&parallel[0],rows,cols,0,2));
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltMT(&input_image[0],&parallel[0],rows,cols,4,2));
+}
+
+/**
+ * \test LV_MedFiltEngine
+ * Filters random image with every engine
+ * Expects:
+ * -# LV_MedFiltEngine returns OK for every engine
+ * -# Output identical to HUANG engine
+ * -# WRONG_PARAMETER for unknown engine and even mask
+ */
+TEST_F(DLL_Tests,LV_MedFiltEngine)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 123, cols = 211, mask = 9;
+	const UINT16 engines[] = {0, 1, 2, 3, 4};	// MEDIAN_ENGINE
+	vector<UINT16> input_image(rows*cols), reference(rows*cols), output_image(rows*cols);
+	srand(1);
+	for(unsigned int a=0;a<input_image.size();a++)
+		input_image[a] = rand16();
+	ASSERT_EQ(OK,LV_MedFiltEngine(&input_image[0],&reference[0],rows,cols,mask,0,1));
+	for(unsigned int e=0;e<sizeof(engines)/sizeof(engines[0]);e++)
+	{
+		EXPECT_EQ(OK,LV_MedFiltEngine(&input_image[0],&output_image[0],rows,cols,mask,engines[e],2));
+		EXPECT_TRUE(reference==output_image) << "engine " << engines[e];
+	}
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltEngine(&input_image[0],&output_image[0],rows,cols,mask,1000,2));
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltEngine(&input_image[0],&output_image[0],rows,cols,4,0,2));
+}
+
+/**
+ * \test HuangMultiRow
+ * Filters random images whose bands are not multiple of MULTIROW_ROWS rows, including images lower than the mask
+ * Expects:
+ * -# Output of HUANG_MULTIROW engine identical to HUANG engine for every mask and number of threads
+ */
+TEST_F(DLL_Tests,HuangMultiRow)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows[] = {1, 5, 37, 130};
+	const UINT16 cols = 71;
+	const UINT16 masks[] = {1, 3, 15, 41};
+	const UINT16 threads[] = {1, 3};
+	for(unsigned int r=0;r<sizeof(rows)/sizeof(rows[0]);r++)
+	{
+		vector<UINT16> input_image(rows[r]*cols), reference(rows[r]*cols), output_image(rows[r]*cols);
+		srand(21+r);
+		for(unsigned int a=0;a<input_image.size();a++)
+			input_image[a] = rand16();
+		for(unsigned int m=0;m<sizeof(masks)/sizeof(masks[0]);m++)
+		{
+			ASSERT_EQ(OK,LV_MedFiltEngine(&input_image[0],&reference[0],rows[r],cols,masks[m],0,1));
+			for(unsigned int t=0;t<sizeof(threads)/sizeof(threads[0]);t++)
+			{
+				EXPECT_EQ(OK,LV_MedFiltEngine(&input_image[0],&output_image[0],rows[r],cols,masks[m],4,threads[t]));
+				EXPECT_TRUE(reference==output_image) << "rows " << rows[r] << " mask " << masks[m] << " threads " << threads[t];
+			}
+		}
+	}
+}
+
+/**
+ * \test ConstantTimeLargeMask
+ * Filters random image and image with narrow range of values with masks 61 and 101, image is wider than one strip
+ * of columns and its width is not multiple of strip width
+ * Expects:
+ * -# Output of CONSTANT_TIME engine equal to sorting of every window (zeros outside the image) for 1 and 3 threads
+ */
+TEST_F(DLL_Tests,ConstantTimeLargeMask)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 70, cols = 150;
+	const UINT16 masks[] = {61, 101};
+	const UINT16 ranges[] = {0, 700};	// 0 - full range of values
+	const UINT16 threads[] = {1, 3};
+	vector<UINT16> input_image(rows*cols), reference(rows*cols), output_image(rows*cols);
+	vector<UINT16> window;
+	for(unsigned int g=0;g<sizeof(ranges)/sizeof(ranges[0]);g++)
+	{
+		srand(31+g);
+		for(unsigned int a=0;a<input_image.size();a++)
+			input_image[a] = ranges[g] ? static_cast<UINT16>(30000 + rand()%ranges[g]) : rand16();
+		for(unsigned int m=0;m<sizeof(masks)/sizeof(masks[0]);m++)
+		{
+			const int bok = masks[m]/2;
+			for(int r=0;r<rows;r++)
+				for(int c=0;c<cols;c++)
+				{
+					window.clear();
+					for(int i=r-bok;i<=r+bok;i++)
+						for(int j=c-bok;j<=c+bok;j++)
+							window.push_back((i<0 || j<0 || i>=rows || j>=cols) ? 0 : input_image[i*cols+j]);
+					std::nth_element(window.begin(),window.begin()+window.size()/2,window.end());
+					reference[r*cols+c] = window[window.size()/2];
+				}
+			for(unsigned int t=0;t<sizeof(threads)/sizeof(threads[0]);t++)
+			{
+				EXPECT_EQ(OK,LV_MedFiltEngine(&input_image[0],&output_image[0],rows,cols,masks[m],2,threads[t]));
+				EXPECT_TRUE(reference==output_image) << "range " << ranges[g] << " mask " << masks[m] << " threads " << threads[t];
+			}
+		}
+	}
+}
+
+/**
+ * \test SortingNetwork
+ * Filters random images with masks supported by sorting network engine, image widths are not multiple of vector width
+ * Expects:
+ * -# Output of SORTING_NETWORK engine identical to HUANG engine for masks 3, 5 and 7
+ */
+TEST_F(DLL_Tests,SortingNetwork)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 67, cols = 101;
+	const UINT16 masks[] = {3, 5, 7};
+	vector<UINT16> input_image(rows*cols), reference(rows*cols), output_image(rows*cols);
+	srand(2);
+	for(unsigned int a=0;a<input_image.size();a++)
+		input_image[a] = rand16();
+	for(unsigned int m=0;m<sizeof(masks)/sizeof(masks[0]);m++)
+	{
+		ASSERT_EQ(OK,LV_MedFiltEngine(&input_image[0],&reference[0],rows,cols,masks[m],0,1));
+		EXPECT_EQ(OK,LV_MedFiltEngine(&input_image[0],&output_image[0],rows,cols,masks[m],3,1));
+		EXPECT_TRUE(reference==output_image) << "mask " << masks[m];
+	}
+}
+
+/**
+ * \test LV_MedFiltBits
+ * Filters random 8, 10, 12, 14 and 16 bit images
+ * Expects:
+ * -# Output identical to HUANG engine for every bit depth
+ * -# UNSUPPORTED_IMAGE if image has values above bit depth
+ * -# WRONG_PARAMETER for unsupported bit depth
+ * -# OK for empty image
+ */
+TEST_F(DLL_Tests,LV_MedFiltBits)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 97, cols = 133, mask = 11;
+	const UINT16 bits[] = {8, 10, 12, 14, 16};
+	vector<UINT16> input_image(rows*cols), reference(rows*cols), output_image(rows*cols);
+	for(unsigned int b=0;b<sizeof(bits)/sizeof(bits[0]);b++)
+	{
+		srand(bits[b]);
+		for(unsigned int a=0;a<input_image.size();a++)
+			input_image[a] = static_cast<UINT16>(rand16() % (1<<bits[b]));
+		ASSERT_EQ(OK,LV_MedFiltEngine(&input_image[0],&reference[0],rows,cols,mask,0,1));
+		EXPECT_EQ(OK,LV_MedFiltBits(&input_image[0],&output_image[0],rows,cols,mask,bits[b],2));
+		EXPECT_TRUE(reference==output_image) << "bits " << bits[b];
+	}
+	input_image[0] = 4096;
+	EXPECT_EQ(UNSUPPORTED_IMAGE,LV_MedFiltBits(&input_image[0],&output_image[0],rows,cols,mask,12,2));
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltBits(&input_image[0],&output_image[0],rows,cols,mask,11,2));
+	EXPECT_EQ(OK,LV_MedFiltBits(&input_image[0],&output_image[0],0,cols,mask,12,2));
+	EXPECT_EQ(OK,LV_MedFiltBits(&input_image[0],&output_image[0],rows,0,mask,12,2));
+}
+
+/**
+ * \test LV_MedFiltPlan
+ * Filters several random images with one plan
+ * Expects:
+ * -# LV_MedFiltPlanCreate, LV_MedFiltPlanExecute and LV_MedFiltPlanDestroy return OK
+ * -# Output of every execution identical to HUANG engine, for small (sorting network) and large mask
+ * -# WRONG_PARAMETER for even mask, NULL_POINTER for NULL plan
+ */
+TEST_F(DLL_Tests,LV_MedFiltPlan)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 143, cols = 119;
+	const UINT16 masks[] = {5, 21};
+	vector<UINT16> input_image(rows*cols), reference(rows*cols), output_image(rows*cols);
+	void *plan = NULL;
+	for(unsigned int m=0;m<sizeof(masks)/sizeof(masks[0]);m++)
+	{
+		ASSERT_EQ(OK,LV_MedFiltPlanCreate(rows,cols,masks[m],3,&plan));
+		for(unsigned int frame=0;frame<3;frame++)
+		{
+			srand(frame);
+			for(unsigned int a=0;a<input_image.size();a++)
+				input_image[a] = rand16();
+			ASSERT_EQ(OK,LV_MedFiltEngine(&input_image[0],&reference[0],rows,cols,masks[m],0,1));
+			EXPECT_EQ(OK,LV_MedFiltPlanExecute(plan,&input_image[0],&output_image[0]));
+			EXPECT_TRUE(reference==output_image) << "mask " << masks[m] << " frame " << frame;
+		}
+		EXPECT_EQ(OK,LV_MedFiltPlanDestroy(plan));
+	}
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltPlanCreate(rows,cols,4,1,&plan));
+	EXPECT_EQ(NULL_POINTER,LV_MedFiltPlanExecute(NULL,&input_image[0],&output_image[0]));
+	EXPECT_EQ(NULL_POINTER,LV_MedFiltPlanDestroy(NULL));
+}
+
+/**
+ * \test LV_MedFiltBorder
+ * Filters flat image and random image with every border mode
+ * Expects:
+ * -# BORDER_ZERO identical to HUANG engine
+ * -# Flat image stays flat for BORDER_REPLICATE, BORDER_REFLECT and BORDER_CONSTANT with the same value
+ * -# Corners of flat image are darkened by BORDER_ZERO
+ * -# WRONG_PARAMETER for unknown border mode
+ */
+TEST_F(DLL_Tests,LV_MedFiltBorder)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 57, cols = 83, mask = 13, level = 1000;
+	const UINT16 modes[] = {1, 2, 3};	// BORDER_MODE
+	vector<UINT16> input_image(rows*cols), reference(rows*cols), output_image(rows*cols);
+	srand(3);
+	for(unsigned int a=0;a<input_image.size();a++)
+		input_image[a] = rand16();
+	ASSERT_EQ(OK,LV_MedFiltEngine(&input_image[0],&reference[0],rows,cols,mask,0,1));
+	EXPECT_EQ(OK,LV_MedFiltBorder(&input_image[0],&output_image[0],rows,cols,mask,0,0,2));
+	EXPECT_TRUE(reference==output_image);
+
+	std::fill(input_image.begin(),input_image.end(),level);
+	for(unsigned int m=0;m<sizeof(modes)/sizeof(modes[0]);m++)
+	{
+		EXPECT_EQ(OK,LV_MedFiltBorder(&input_image[0],&output_image[0],rows,cols,mask,modes[m],level,2));
+		EXPECT_TRUE(input_image==output_image) << "mode " << modes[m];
+	}
+	EXPECT_EQ(OK,LV_MedFiltBorder(&input_image[0],&output_image[0],rows,cols,mask,0,0,2));
+	EXPECT_EQ(0,output_image[0]);
+	EXPECT_EQ(level,output_image[rows/2*cols+cols/2]);
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltBorder(&input_image[0],&output_image[0],rows,cols,mask,4,0,2));
+}
+
+/**
+ * \test LV_MedFiltBatch
+ * Filters stacks of random frames, stack shallower and deeper than number of threads
+ * Expects:
+ * -# LV_MedFiltBatch returns OK
+ * -# Every output frame identical to HUANG engine applied to the input frame
+ */
+TEST_F(DLL_Tests,LV_MedFiltBatch)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 71, cols = 93, mask = 9;
+	const UINT32 depths[] = {1, 2, 11};
+	const unsigned int frame_size = rows*cols;
+	vector<UINT16> reference(frame_size);
+	for(unsigned int d=0;d<sizeof(depths)/sizeof(depths[0]);d++)
+	{
+		vector<UINT16> input_stack(depths[d]*frame_size), output_stack(depths[d]*frame_size);
+		srand(depths[d]);
+		for(unsigned int a=0;a<input_stack.size();a++)
+			input_stack[a] = rand16();
+		EXPECT_EQ(OK,LV_MedFiltBatch(&input_stack[0],&output_stack[0],depths[d],rows,cols,mask,4));
+		for(unsigned int f=0;f<depths[d];f++)
+		{
+			ASSERT_EQ(OK,LV_MedFiltEngine(&input_stack[f*frame_size],&reference[0],rows,cols,mask,0,1));
+			EXPECT_TRUE(std::equal(reference.begin(),reference.end(),output_stack.begin()+f*frame_size)) << "depth " << depths[d] << " frame " << f;
+		}
+	}
+}
+
+/// Image streamed by LV_MedFiltStream test
+struct STREAM_TEST
+{
+	const vector<UINT16> *input;	///< whole input image
+	vector<UINT16> output;			///< whole output image
+	UINT32 cols;					///< number of columns
+	UINT64 next_in;					///< next row expected by source
+	UINT64 next_out;				///< next row expected by sink
+};
+
+/// Source of LV_MedFiltStream test, copies rows from STREAM_TEST::input
+static BYTE __cdecl StreamTestSource(void *user, UINT64 first_row, UINT32 nrows, UINT16 *rows)
+{
+	STREAM_TEST *t = static_cast<STREAM_TEST*>(user);
+	if(first_row!=t->next_in)
+		return OTHER_ERROR;
+	std::copy(t->input->begin()+first_row*t->cols,t->input->begin()+(first_row+nrows)*t->cols,rows);
+	t->next_in += nrows;
+	return OK;
+}
+
+/// Sink of LV_MedFiltStream test, copies rows to STREAM_TEST::output
+static BYTE __cdecl StreamTestSink(void *user, UINT64 first_row, UINT32 nrows, const UINT16 *rows)
+{
+	STREAM_TEST *t = static_cast<STREAM_TEST*>(user);
+	if(first_row!=t->next_out)
+		return OTHER_ERROR;
+	std::copy(rows,rows+nrows*t->cols,t->output.begin()+first_row*t->cols);
+	t->next_out += nrows;
+	return OK;
+}
+
+/**
+ * \test LV_MedFiltStream
+ * Streams random image in strips of different heights, also strips thinner than the mask
+ * Expects:
+ * -# LV_MedFiltStream returns OK, every row read and written once in order
+ * -# Output identical to LV_MedFiltBorder of the whole image for zero and reflect borders
+ */
+TEST_F(DLL_Tests,LV_MedFiltStream)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 131, cols = 77, mask = 11;
+	const UINT32 strips[] = {1, 4, 32, 500};
+	const UINT16 modes[] = {0, 2};	// BORDER_MODE
+	vector<UINT16> input_image(rows*cols), reference(rows*cols);
+	srand(5);
+	for(unsigned int a=0;a<input_image.size();a++)
+		input_image[a] = rand16();
+	for(unsigned int m=0;m<sizeof(modes)/sizeof(modes[0]);m++)
+	{
+		LV_MedFiltBorder(&input_image[0],&reference[0],rows,cols,mask,modes[m],0,1);
+		for(unsigned int s=0;s<sizeof(strips)/sizeof(strips[0]);s++)
+		{
+			STREAM_TEST t;
+			t.input = &input_image;
+			t.output.assign(rows*cols,0);
+			t.cols = cols;
+			t.next_in = t.next_out = 0;
+			EXPECT_EQ(OK,LV_MedFiltStream(rows,cols,mask,strips[s],modes[m],0,StreamTestSource,StreamTestSink,&t,3));
+			EXPECT_EQ(rows,t.next_in);
+			EXPECT_EQ(rows,t.next_out);
+			EXPECT_TRUE(reference==t.output) << "mode " << modes[m] << " strip " << strips[s];
+		}
+	}
+}
+
+/**
+ * \test TemporalMedian
+ * Computes per-pixel median over sliding window of random frames, brute force reference
+ * Expects:
+ * -# LV_TemporalMedianStack output identical to sorting window of every pixel, also before window is full
+ * -# LV_TemporalMedianPush fed frame by frame gives the same output
+ */
+TEST_F(DLL_Tests,TemporalMedian)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 37, cols = 59, window = 7;
+	const UINT32 nframes = 20;
+	const unsigned int frame_size = rows*cols;
+	vector<UINT16> input_stack(nframes*frame_size), reference(nframes*frame_size), output_stack(nframes*frame_size);
+	vector<UINT16> values;
+	void *tm = NULL;
+	srand(6);
+	for(unsigned int a=0;a<input_stack.size();a++)
+		input_stack[a] = static_cast<UINT16>(rand() % 64);	// many repeated values
+	for(unsigned int f=0;f<nframes;f++)
+		for(unsigned int p=0;p<frame_size;p++)
+		{
+			values.clear();
+			for(unsigned int g=(f+1>window ? f+1-window : 0);g<=f;g++)
+				values.push_back(input_stack[g*frame_size+p]);
+			std::sort(values.begin(),values.end());
+			reference[f*frame_size+p] = values[values.size()/2];
+		}
+	EXPECT_EQ(OK,LV_TemporalMedianStack(&input_stack[0],&output_stack[0],nframes,rows,cols,window,3));
+	EXPECT_TRUE(reference==output_stack);
+
+	std::fill(output_stack.begin(),output_stack.end(),0);
+	ASSERT_EQ(OK,LV_TemporalMedianCreate(rows,cols,window,3,&tm));
+	for(unsigned int f=0;f<nframes;f++)
+		EXPECT_EQ(OK,LV_TemporalMedianPush(tm,&input_stack[f*frame_size],&output_stack[f*frame_size]));
+	EXPECT_EQ(OK,LV_TemporalMedianDestroy(tm));
+	EXPECT_TRUE(reference==output_stack);
+}
+
+/**
+ * \test LV_RankFilt
+ * Computes minimum, 10th percentile, median, 90th percentile and maximum of random image in one call
+ * Expects:
+ * -# Every output image equal to sorted window of brute force reference (zeros outside the image)
+ * -# Median output identical to HUANG engine
+ * -# WRONG_PARAMETER for percentile out of range
+ */
+TEST_F(DLL_Tests,LV_RankFilt)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 41, cols = 67, mask = 7;
+	const double percentiles[] = {0, 10, 50, 90, 100};
+	const unsigned int npercentiles = sizeof(percentiles)/sizeof(percentiles[0]);
+	const unsigned int frame_size = rows*cols, n = mask*mask;
+	const int bok = mask/2;
+	vector<UINT16> input_image(frame_size), reference(frame_size), output_images(npercentiles*frame_size), window;
+	srand(7);
+	for(unsigned int a=0;a<input_image.size();a++)
+		input_image[a] = rand16();
+	EXPECT_EQ(OK,LV_RankFilt(&input_image[0],&output_images[0],rows,cols,mask,percentiles,npercentiles,3));
+	for(int r=0;r<rows;r++)
+		for(int c=0;c<cols;c++)
+		{
+			window.clear();
+			for(int i=r-bok;i<=r+bok;i++)
+				for(int j=c-bok;j<=c+bok;j++)
+					window.push_back((i<0 || j<0 || i>=rows || j>=cols) ? 0 : input_image[i*cols+j]);
+			std::sort(window.begin(),window.end());
+			for(unsigned int p=0;p<npercentiles;p++)
+				ASSERT_EQ(window[static_cast<unsigned int>(floor(percentiles[p]/100*(n-1)+0.5))],output_images[p*frame_size+r*cols+c]) << "percentile " << percentiles[p];
+		}
+	ASSERT_EQ(OK,LV_MedFiltEngine(&input_image[0],&reference[0],rows,cols,mask,0,1));
+	EXPECT_TRUE(std::equal(reference.begin(),reference.end(),output_images.begin()+2*frame_size));
+	const double wrong = 100.5;
+	EXPECT_EQ(WRONG_PARAMETER,LV_RankFilt(&input_image[0],&output_images[0],rows,cols,mask,&wrong,1,1));
+}
+
+/**
+ * \test LV_MedFiltMasked
+ * Filters flat image with dead (0) and saturated (4095) pixels given once by mask and once by sentinel value
+ * Expects:
+ * -# Flat image restored everywhere, invalid pixels do not affect median
+ * -# empty_value in windows without valid pixels
+ * -# With all pixels valid interior identical to HUANG engine
+ */
+TEST_F(DLL_Tests,LV_MedFiltMasked)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 60, cols = 80, mask = 5, flat = 1000;
+	const unsigned int frame_size = rows*cols;
+	const int bok = mask/2;
+	vector<UINT16> input_image(frame_size,flat), output_image(frame_size), reference(frame_size);
+	vector<UINT8> valid(frame_size,1);
+	srand(13);
+	for(unsigned int a=0;a<frame_size/5;a++)	// 20% of bad pixels, some windows have more bad than good
+	{
+		unsigned int idx = rand()%frame_size;
+		input_image[idx] = (a%2) ? 4095 : 0;
+		valid[idx] = 0;
+	}
+	EXPECT_EQ(OK,LV_MedFiltMasked(&input_image[0],&valid[0],&output_image[0],rows,cols,mask,0,0,2));
+	for(unsigned int a=0;a<frame_size;a++)
+		ASSERT_EQ(flat,output_image[a]) << "pixel " << a;
+	// the same pixels marked by sentinel value
+	for(unsigned int a=0;a<frame_size;a++)
+		if(4095==input_image[a])
+			input_image[a] = 0;
+	EXPECT_EQ(OK,LV_MedFiltMasked(&input_image[0],NULL,&output_image[0],rows,cols,mask,0,0,2));
+	for(unsigned int a=0;a<frame_size;a++)
+		ASSERT_EQ(flat,output_image[a]) << "pixel " << a;
+	// no valid pixels at all
+	std::fill(valid.begin(),valid.end(),0);
+	EXPECT_EQ(OK,LV_MedFiltMasked(&input_image[0],&valid[0],&output_image[0],rows,cols,mask,0,77,2));
+	EXPECT_EQ(static_cast<ptrdiff_t>(frame_size),std::count(output_image.begin(),output_image.end(),77));
+	// all valid
+	for(unsigned int a=0;a<frame_size;a++)
+		input_image[a] = rand16();
+	std::fill(valid.begin(),valid.end(),1);
+	EXPECT_EQ(OK,LV_MedFiltMasked(&input_image[0],&valid[0],&output_image[0],rows,cols,mask,0,0,2));
+	ASSERT_EQ(OK,LV_MedFiltEngine(&input_image[0],&reference[0],rows,cols,mask,0,1));
+	for(int r=bok;r<rows-bok;r++)
+		for(int c=bok;c<cols-bok;c++)
+			ASSERT_EQ(reference[r*cols+c],output_image[r*cols+c]);
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltMasked(&input_image[0],&valid[0],&output_image[0],rows,cols,4,0,0,2));
+}
+
+/**
+ * \test LV_MedFiltFloat
+ * Filters normalized test image held in C_Matrix_Container as double and as float
+ * Expects:
+ * -# double output equal to sorting of every window (zeros outside the image)
+ * -# float output of image with integer values identical to HUANG engine
+ * -# UNSUPPORTED_IMAGE for image with NaN
+ */
+TEST_F(DLL_Tests,LV_MedFiltFloat)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 mask = 5;
+	const int bok = mask/2;
+	C_MATRIX_LOAD(input_image,"../../../../tests/LV_FastMedian/data/testimag1.dat"); // load test file
+	input_image.Normalize(0,1);
+	const int rows = input_image._rows, cols = input_image._cols;
+	const unsigned int frame_size = input_image.GetNumofElements();
+	C_Matrix_Container output_image(rows,cols);
+	vector<double> window;
+	EXPECT_EQ(OK,LV_MedFiltDouble(input_image.data,output_image.data,rows,cols,mask,0));
+	for(int r=0;r<rows;r++)
+		for(int c=0;c<cols;c++)
+		{
+			window.clear();
+			for(int i=r-bok;i<=r+bok;i++)
+				for(int j=c-bok;j<=c+bok;j++)
+					window.push_back((i<0 || j<0 || i>=rows || j>=cols) ? 0.0 : input_image.data[i*cols+j]);
+			std::sort(window.begin(),window.end());
+			ASSERT_EQ(window[window.size()/2],output_image.data[r*cols+c]);
+		}
+	// integer image
+	vector<UINT16> input16(frame_size), reference(frame_size);
+	vector<float> input_float(frame_size), output_float(frame_size);
+	for(unsigned int a=0;a<frame_size;a++)
+	{
+		input16[a] = static_cast<UINT16>(floor(65535*input_image.data[a]+0.5));
+		input_float[a] = input16[a];
+	}
+	EXPECT_EQ(OK,LV_MedFiltFloat(&input_float[0],&output_float[0],rows,cols,mask,2));
+	ASSERT_EQ(OK,LV_MedFiltEngine(&input16[0],&reference[0],rows,cols,mask,0,1));
+	for(unsigned int a=0;a<frame_size;a++)
+		ASSERT_EQ(static_cast<float>(reference[a]),output_float[a]);
+	input_float[frame_size/2] = std::numeric_limits<float>::quiet_NaN();
+	EXPECT_EQ(UNSUPPORTED_IMAGE,LV_MedFiltFloat(&input_float[0],&output_float[0],rows,cols,mask,2));
+}
+
+/// Median of mask x mask window of float image centred at (r,c), zeros outside the image, computed by sorting
+static float FloatWindowMedian(const vector<float> &image, int rows, int cols, int mask, int r, int c, vector<float> &window)
+{
+	const int bok = mask/2;
+	window.clear();
+	for(int i=r-bok;i<=r+bok;i++)
+		for(int j=c-bok;j<=c+bok;j++)
+			window.push_back((i<0 || j<0 || i>=rows || j>=cols) ? 0.0f : image[i*cols+j]);
+	std::nth_element(window.begin(),window.begin()+window.size()/2,window.end());
+	return window[window.size()/2];
+}
+
+/**
+ * \test LV_MedFiltFloatLargeMask
+ * Filters float images of distinct values with mask 225, too large for tiles. Ranks of the whole image are filtered
+ * by histogram of 2^16 bins (small image), 2^20 bins (more than 2^16 values) and 2^24 bins (more than 2^20 values)
+ * Expects:
+ * -# Output equal to sorting of the window (zeros outside the image), every pixel of small image and about 500
+ * pixels of larger images
+ */
+TEST_F(DLL_Tests,LV_MedFiltFloatLargeMask)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 sizes[][2] = {{41, 47}, {300, 310}, {1030, 1030}};	// rows, cols
+	const UINT16 mask = 225;
+	vector<float> window;
+	srand(14);
+	for(unsigned int s=0;s<sizeof(sizes)/sizeof(sizes[0]);s++)
+	{
+		const int rows = sizes[s][0], cols = sizes[s][1];
+		const unsigned int frame_size = rows*cols;
+		const unsigned int step = frame_size/500 + 1;	// checked pixels
+		vector<float> input_image(frame_size), output_image(frame_size);
+		// shuffled distinct values, negative, zero and positive, exact in float
+		for(unsigned int a=0;a<frame_size;a++)
+			input_image[a] = 0.25f*(static_cast<float>(a) - static_cast<float>(frame_size/2));
+		for(unsigned int a=frame_size-1;a>0;a--)
+			std::swap(input_image[a],input_image[(rand()*(RAND_MAX+1u) + rand()) % (a+1)]);
+		EXPECT_EQ(OK,LV_MedFiltFloat(&input_image[0],&output_image[0],rows,cols,mask,0));
+		unsigned int wrong = 0;
+		for(unsigned int a=0;a<frame_size;a+=step)
+			wrong += FloatWindowMedian(input_image,rows,cols,mask,a/cols,a%cols,window)!=output_image[a];
+		EXPECT_EQ(0,wrong) << "image " << rows << "x" << cols;
+	}
+}
+
+/**
+ * \test LV_MedFiltFloatTiles
+ * Filters float image larger than one tile in both directions, with 1 and 3 threads so bands do not start at tiles
+ * Expects:
+ * -# Output equal to sorting of every window (zeros outside the image), also along tile seams
+ */
+TEST_F(DLL_Tests,LV_MedFiltFloatTiles)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 520, cols = 530;
+	const UINT16 masks[] = {5, 15};
+	const UINT16 threads[] = {1, 3};
+	vector<float> input_image(rows*cols), reference(rows*cols), output_image(rows*cols);
+	vector<float> window;
+	srand(15);
+	for(unsigned int a=0;a<input_image.size();a++)
+		input_image[a] = 0.01f*static_cast<float>(rand()%5000) - 20.0f;
+	for(unsigned int m=0;m<sizeof(masks)/sizeof(masks[0]);m++)
+	{
+		for(int r=0;r<rows;r++)
+			for(int c=0;c<cols;c++)
+				reference[r*cols+c] = FloatWindowMedian(input_image,rows,cols,masks[m],r,c,window);
+		for(unsigned int t=0;t<sizeof(threads)/sizeof(threads[0]);t++)
+		{
+			EXPECT_EQ(OK,LV_MedFiltFloat(&input_image[0],&output_image[0],rows,cols,masks[m],threads[t]));
+			EXPECT_TRUE(reference==output_image) << "mask " << masks[m] << " threads " << threads[t];
+		}
+	}
+}
+
+/**
+ * \test LV_MedFiltBackground
+ * Approximates median with 51x51 mask of flat background with isolated hot pixels and of random image
+ * Expects:
+ * -# Flat background restored exactly and zero estimated error for factor 5
+ * -# For factor 1 output identical to LV_MedFiltBorder and zero estimated error
+ * -# WRONG_PARAMETER for zero factor
+ */
+TEST_F(DLL_Tests,LV_MedFiltBackground)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 200, cols = 230, mask = 51, flat = 800;
+	const UINT16 replicate = 1, reflect = 2;	// BORDER_MODE
+	const unsigned int frame_size = rows*cols;
+	vector<UINT16> input_image(frame_size,flat), output_image(frame_size), reference(frame_size);
+	double mean_error = -1;
+	UINT16 max_error = 1;
+	for(unsigned int a=0;a<frame_size;a+=97)
+		input_image[a] = 4095;
+	EXPECT_EQ(OK,LV_MedFiltBackground(&input_image[0],&output_image[0],rows,cols,mask,5,replicate,0,0,&mean_error,&max_error));
+	EXPECT_EQ(static_cast<ptrdiff_t>(frame_size),std::count(output_image.begin(),output_image.end(),flat));
+	EXPECT_EQ(0.0,mean_error);
+	EXPECT_EQ(0,max_error);
+	srand(15);
+	for(unsigned int a=0;a<frame_size;a++)
+		input_image[a] = static_cast<UINT16>(rand()%4096);
+	EXPECT_EQ(OK,LV_MedFiltBackground(&input_image[0],&output_image[0],rows,cols,mask,1,reflect,0,0,&mean_error,&max_error));
+	EXPECT_EQ(OK,LV_MedFiltBorder(&input_image[0],&reference[0],rows,cols,mask,reflect,0,0));
+	EXPECT_TRUE(std::equal(reference.begin(),reference.end(),output_image.begin()));
+	EXPECT_EQ(0.0,mean_error);
+	EXPECT_EQ(0,max_error);
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltBackground(&input_image[0],&output_image[0],rows,cols,mask,0,reflect,0,0,NULL,NULL));
+}
+
+/**
+ * \test LV_MedFiltUpdate
+ * Changes random image inside overlapping rectangles and rectangle crossing the edge of the image, updates median of
+ * previous frame
+ * Expects:
+ * -# Updated output identical to HUANG engine applied to new frame
+ * -# Output not modified for no rectangles
+ */
+TEST_F(DLL_Tests,LV_MedFiltUpdate)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 120, cols = 150, mask = 9;
+	const UINT16 rects[] = {10, 20, 15, 30,		// row, col, rows, cols
+							18, 40, 20, 10,
+							110, 140, 30, 30,
+							60, 0, 1, 150};
+	const UINT16 nrects = sizeof(rects)/sizeof(rects[0])/4;
+	vector<UINT16> input_image(rows*cols), output_image(rows*cols), reference(rows*cols);
+	srand(16);
+	for(unsigned int a=0;a<input_image.size();a++)
+		input_image[a] = rand16();
+	LV_MedFilt(&input_image[0],&output_image[0],rows,cols,mask);
+	EXPECT_EQ(OK,LV_MedFiltUpdate(&input_image[0],&output_image[0],rows,cols,mask,NULL,0,2));
+	ASSERT_EQ(OK,LV_MedFiltEngine(&input_image[0],&reference[0],rows,cols,mask,0,1));
+	EXPECT_TRUE(reference==output_image);
+	for(unsigned int i=0;i<nrects;i++)
+		for(int r=rects[4*i];r<std::min(rects[4*i]+rects[4*i+2],static_cast<int>(rows));r++)
+			for(int c=rects[4*i+1];c<std::min(rects[4*i+1]+rects[4*i+3],static_cast<int>(cols));c++)
+				input_image[r*cols+c] = rand16();
+	EXPECT_EQ(OK,LV_MedFiltUpdate(&input_image[0],&output_image[0],rows,cols,mask,rects,nrects,2));
+	ASSERT_EQ(OK,LV_MedFiltEngine(&input_image[0],&reference[0],rows,cols,mask,0,1));
+	EXPECT_TRUE(reference==output_image);
+	EXPECT_EQ(NULL_POINTER,LV_MedFiltUpdate(&input_image[0],&output_image[0],rows,cols,mask,NULL,1,2));
+}
+
+/**
+ * Progress callback of LV_MedFiltProgress test, user points to vector of reported rows. Cancels when number of
+ * reports reaches its capacity.
+ */
+static BYTE __cdecl ProgressTestCallback(void *user, UINT32 rows_done, UINT32 rows_total)
+{
+	vector<UINT32> *reports = static_cast<vector<UINT32>*>(user);
+	reports->push_back(rows_done);
+	return reports->size()>=reports->capacity() ? CANCELLED : OK;
+}
+
+/**
+ * \test LV_MedFiltProgress
+ * Filters random image reporting progress, then cancels by callback and by flag
+ * Expects:
+ * -# Output identical to HUANG engine, progress not decreasing and ending with all rows
+ * -# CANCELLED when callback returns non-zero after first report or cancel flag is set
+ */
+TEST_F(DLL_Tests,LV_MedFiltProgress)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 300, cols = 200, mask = 9;
+	vector<UINT16> input_image(rows*cols), output_image(rows*cols), reference(rows*cols);
+	vector<UINT32> reports;
+	volatile LONG cancel = 0;
+	srand(17);
+	for(unsigned int a=0;a<input_image.size();a++)
+		input_image[a] = rand16();
+	reports.reserve(1000);
+	EXPECT_EQ(OK,LV_MedFiltProgress(&input_image[0],&output_image[0],rows,cols,mask,2,ProgressTestCallback,&reports,&cancel));
+	ASSERT_EQ(OK,LV_MedFiltEngine(&input_image[0],&reference[0],rows,cols,mask,0,1));
+	EXPECT_TRUE(reference==output_image);
+	ASSERT_FALSE(reports.empty());
+	EXPECT_EQ(rows,reports.back());
+	EXPECT_TRUE(std::is_sorted(reports.begin(),reports.end()));
+	vector<UINT32> one_report;
+	one_report.reserve(1);
+	EXPECT_EQ(CANCELLED,LV_MedFiltProgress(&input_image[0],&output_image[0],rows,cols,mask,1,ProgressTestCallback,&one_report,NULL));
+	EXPECT_EQ(1u,one_report.size());
+	cancel = 1;
+	EXPECT_EQ(CANCELLED,LV_MedFiltProgress(&input_image[0],&output_image[0],rows,cols,mask,2,NULL,NULL,&cancel));
+}
+
+/**
+ * \test LV_MedFiltDispatch
+ * Filters random 12 bit image by LV_MedFilt with decision tables forcing every engine, then calibrates
+ * Expects:
+ * -# Output identical to HUANG engine for every table and mask
+ * -# WRONG_PARAMETER for zero min_band_pixels
+ * -# Calibrated table installed and returned by LV_MedFiltDispatchGet
+ */
+TEST_F(DLL_Tests,LV_MedFiltDispatch)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT16 rows = 157, cols = 203;
+	const UINT16 masks[] = {3, 7, 15, 21, 61};
+	vector<UINT16> input_image(rows*cols), reference(rows*cols), output_image(rows*cols);
+	DISPATCH_TABLE defaults, tables[3], calibrated, current;
+	srand(18);
+	for(unsigned int a=0;a<input_image.size();a++)
+		input_image[a] = static_cast<UINT16>(rand() & 0xFFF);
+	ASSERT_EQ(OK,LV_MedFiltDispatchGet(&defaults));
+	tables[0] = tables[1] = tables[2] = defaults;
+	tables[0].min_band_pixels = 1000;	// one thread per 1000 pixels
+	for(unsigned int b=0;b<5;b++)
+	{
+		tables[0].network_max_mask[b] = 0;	// Huang only
+		tables[0].ct_min_mask[b] = 0xFFFF;
+		tables[1].network_max_mask[b] = 7;	// networks and constant time
+		tables[1].ct_min_mask[b] = 3;
+		tables[2].network_max_mask[b] = 0;	// constant time only
+		tables[2].ct_min_mask[b] = 3;
+	}
+	for(unsigned int m=0;m<sizeof(masks)/sizeof(masks[0]);m++)
+	{
+		ASSERT_EQ(OK,LV_MedFiltEngine(&input_image[0],&reference[0],rows,cols,masks[m],0,1));
+		for(unsigned int t=0;t<sizeof(tables)/sizeof(tables[0]);t++)
+		{
+			EXPECT_EQ(OK,LV_MedFiltDispatchSet(&tables[t]));
+			LV_MedFilt(&input_image[0],&output_image[0],rows,cols,masks[m]);
+			EXPECT_TRUE(reference==output_image) << "mask " << masks[m] << " table " << t;
+		}
+	}
+	tables[0].min_band_pixels = 0;
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltDispatchSet(&tables[0]));
+	EXPECT_EQ(OK,LV_MedFiltDispatchSet(NULL));
+	ASSERT_EQ(OK,LV_MedFiltDispatchGet(&current));
+	EXPECT_EQ(0,memcmp(&defaults,&current,sizeof(current)));
+	ASSERT_EQ(OK,LV_MedFiltCalibrate(&calibrated));
+	for(unsigned int b=0;b<5;b++)
+		EXPECT_LE(calibrated.network_max_mask[b],7);
+	EXPECT_LT(0u,calibrated.min_band_pixels);
+	ASSERT_EQ(OK,LV_MedFiltDispatchGet(&current));
+	EXPECT_EQ(0,memcmp(&calibrated,&current,sizeof(current)));
+	LV_MedFilt(&input_image[0],&output_image[0],rows,cols,masks[sizeof(masks)/sizeof(masks[0])-1]);	// reference holds the last mask
+	EXPECT_TRUE(reference==output_image);
+	EXPECT_EQ(OK,LV_MedFiltDispatchSet(NULL));
+}
+
+/**
+ * \test LV_MedFiltView
+ * Filters ROI of random image with padded rows into ROI of larger output buffer with different pitch
+ * Expects:
+ * -# Output view identical to LV_MedFiltBorder of ROI copied to dense array, for every engine and ENGINE_AUTO
+ * -# Output buffer outside the output view not modified
+ * -# WRONG_PARAMETER for views of different size or view wider than pitch
+ */
+TEST_F(DLL_Tests,LV_MedFiltView)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT32 rows = 61, cols = 79, in_pitch = 131, out_pitch = 97;
+	const UINT16 masks[] = {5, 15};
+	const UINT16 fill = 0xBEEF;
+	vector<UINT16> input_buf(90*in_pitch), output_buf(70*out_pitch), roi(rows*cols), reference(rows*cols);
+	IMAGE_VIEW input = {&input_buf[0], in_pitch, 17, 23, rows, cols};
+	IMAGE_VIEW output = {&output_buf[0], out_pitch, 3, 11, rows, cols};
+	srand(20);
+	for(unsigned int a=0;a<input_buf.size();a++)
+		input_buf[a] = rand16();
+	for(UINT32 r=0;r<rows;r++)
+		for(UINT32 k=0;k<cols;k++)
+			roi[r*cols+k] = input_buf[(input.row+r)*in_pitch + input.col+k];
+	for(unsigned int m=0;m<sizeof(masks)/sizeof(masks[0]);m++)
+	{
+		ASSERT_EQ(OK,LV_MedFiltBorder(&roi[0],&reference[0],rows,cols,masks[m],2,0,1));
+		for(UINT16 engine=0;engine<=5;engine++)	// MEDIAN_ENGINE and ENGINE_AUTO
+		{
+			std::fill(output_buf.begin(),output_buf.end(),fill);
+			EXPECT_EQ(OK,LV_MedFiltView(&input,&output,masks[m],engine,2,0,3));
+			unsigned int wrong = 0, outside = 0;
+			for(UINT32 r=0;r<output_buf.size()/out_pitch;r++)
+				for(UINT32 k=0;k<out_pitch;k++)
+				{
+					UINT16 v = output_buf[r*out_pitch+k];
+					if(r>=output.row && r<output.row+rows && k>=output.col && k<output.col+cols)
+						wrong += v!=reference[(r-output.row)*cols + k-output.col];
+					else
+						outside += v!=fill;
+				}
+			EXPECT_EQ(0,wrong) << "mask " << masks[m] << " engine " << engine;
+			EXPECT_EQ(0,outside) << "mask " << masks[m] << " engine " << engine;
+		}
+	}
+	IMAGE_VIEW bad = output;
+	bad.rows--;
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltView(&input,&bad,masks[0],0,2,0,1));
+	bad = input;
+	bad.col = in_pitch-cols+1;
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltView(&bad,&output,masks[0],0,2,0,1));
+}
+
+/**
+ * \test LV_MedFiltViewOverloads
+ * Runs view overloads of masked, rank, background, progress and plan filters on ROI of padded image
+ * Expects:
+ * -# Output views identical to dense export run on ROI copied to dense array
+ * -# Output buffers outside the output views not modified
+ * -# WRONG_PARAMETER for views of different size or not matching the plan
+ */
+TEST_F(DLL_Tests,LV_MedFiltViewOverloads)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	const UINT32 rows = 53, cols = 67, in_pitch = 91, out_pitch = 80, out_rows = rows+5;
+	const UINT16 mask = 9;
+	const UINT16 fill = 0xBEEF;
+	const unsigned int frame_size = rows*cols;
+	const double percentiles[] = {10.0, 50.0, 90.0};
+	vector<UINT16> input_buf((rows+9)*in_pitch), output_buf(3*out_rows*out_pitch), roi(frame_size), reference(3*frame_size);
+	vector<UINT8> valid(frame_size);
+	IMAGE_VIEW input = {&input_buf[0], in_pitch, 5, 11, rows, cols};
+	IMAGE_VIEW outputs[3];
+	srand(40);
+	for(unsigned int a=0;a<input_buf.size();a++)
+		input_buf[a] = rand16();
+	for(UINT32 r=0;r<rows;r++)
+		for(UINT32 k=0;k<cols;k++)
+			roi[r*cols+k] = input_buf[(input.row+r)*in_pitch + input.col+k];
+	for(unsigned int a=0;a<frame_size;a++)
+		valid[a] = rand()%4!=0;
+	for(int i=0;i<3;i++)
+	{
+		IMAGE_VIEW o = {&output_buf[i*out_rows*out_pitch], out_pitch, 3, 7, rows, cols};
+		outputs[i] = o;
+	}
+	// counts pixels of output view i different from reference and pixels outside the view that were modified
+	auto compare = [&](int i, const UINT16 *ref) -> unsigned int
+	{
+		unsigned int wrong = 0;
+		for(UINT32 r=0;r<out_rows;r++)
+			for(UINT32 k=0;k<out_pitch;k++)
+			{
+				UINT16 v = outputs[i].tab[r*out_pitch+k];
+				if(r>=outputs[i].row && r<outputs[i].row+rows && k>=outputs[i].col && k<outputs[i].col+cols)
+					wrong += v!=ref[(r-outputs[i].row)*cols + k-outputs[i].col];
+				else
+					wrong += v!=fill;
+			}
+		return wrong;
+	};
+	// masked
+	std::fill(output_buf.begin(),output_buf.end(),fill);
+	ASSERT_EQ(OK,LV_MedFiltMasked(&roi[0],&valid[0],&reference[0],rows,cols,mask,0,7,2));
+	EXPECT_EQ(OK,LV_MedFiltMaskedView(&input,&valid[0],&outputs[0],mask,0,7,2));
+	EXPECT_EQ(0,compare(0,&reference[0])) << "masked";
+	// rank
+	std::fill(output_buf.begin(),output_buf.end(),fill);
+	ASSERT_EQ(OK,LV_RankFilt(&roi[0],&reference[0],rows,cols,mask,percentiles,3,2));
+	EXPECT_EQ(OK,LV_RankFiltView(&input,outputs,mask,percentiles,3,2));
+	for(int i=0;i<3;i++)
+		EXPECT_EQ(0,compare(i,&reference[i*frame_size])) << "rank " << percentiles[i];
+	// background
+	double mean_error_dense, mean_error_view;
+	UINT16 max_error_dense, max_error_view;
+	std::fill(output_buf.begin(),output_buf.end(),fill);
+	ASSERT_EQ(OK,LV_MedFiltBackground(&roi[0],&reference[0],rows,cols,21,3,2,0,2,&mean_error_dense,&max_error_dense));
+	EXPECT_EQ(OK,LV_MedFiltBackgroundView(&input,&outputs[0],21,3,2,0,2,&mean_error_view,&max_error_view));
+	EXPECT_EQ(0,compare(0,&reference[0])) << "background";
+	EXPECT_EQ(mean_error_dense,mean_error_view);
+	EXPECT_EQ(max_error_dense,max_error_view);
+	// progress
+	std::fill(output_buf.begin(),output_buf.end(),fill);
+	ASSERT_EQ(OK,LV_MedFiltProgress(&roi[0],&reference[0],rows,cols,mask,3,NULL,NULL,NULL));
+	EXPECT_EQ(OK,LV_MedFiltProgressView(&input,&outputs[0],mask,3,NULL,NULL,NULL));
+	EXPECT_EQ(0,compare(0,&reference[0])) << "progress";
+	// plan, dense execute after view execute must still see dense layout
+	void *plan = NULL;
+	vector<UINT16> dense(frame_size);
+	ASSERT_EQ(OK,LV_MedFiltPlanCreate(rows,cols,mask,3,&plan));
+	std::fill(output_buf.begin(),output_buf.end(),fill);
+	EXPECT_EQ(OK,LV_MedFiltPlanExecute(plan,&roi[0],&reference[0]));
+	EXPECT_EQ(OK,LV_MedFiltPlanExecuteView(plan,&input,&outputs[0]));
+	EXPECT_EQ(0,compare(0,&reference[0])) << "plan";
+	EXPECT_EQ(OK,LV_MedFiltPlanExecute(plan,&roi[0],&dense[0]));
+	EXPECT_TRUE(std::equal(dense.begin(),dense.end(),reference.begin()));
+	IMAGE_VIEW bad = input;
+	bad.rows--;
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltPlanExecuteView(plan,&bad,&bad));
+	EXPECT_EQ(OK,LV_MedFiltPlanDestroy(plan));
+	bad = outputs[2];
+	bad.cols++;
+	IMAGE_VIEW bad_outputs[3] = {outputs[0], outputs[1], bad};
+	EXPECT_EQ(WRONG_PARAMETER,LV_RankFiltView(&input,bad_outputs,mask,percentiles,3,2));
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltMaskedView(&input,&valid[0],&bad,mask,0,7,2));
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltBackgroundView(&input,&bad,21,3,2,0,2,&mean_error_view,&max_error_view));
+	EXPECT_EQ(WRONG_PARAMETER,LV_MedFiltProgressView(&input,&bad,mask,3,NULL,NULL,NULL));
 }
\ No newline at end of file
@@ -8,9 +8,13 @@
 #include "targetver.h"
 
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <limits>
 #include <tchar.h>
 #include "gtest/gtest.h"
 #include "C_Matrix_Container.h"
 #include "C_DumpAll.h"
+#include "error_codes.h"
 
 // TODO: reference additional headers your program requires here
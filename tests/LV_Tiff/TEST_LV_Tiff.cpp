@@ -18,8 +18,26 @@ using namespace std;
 typedef BYTE (*p_Tiff_GetParams)(char*, UINT16*, UINT16*); 
 /// \copydoc ::Tiff_ReadImage
 typedef BYTE (*p_Tiff_ReadImage)(char*, UINT16*); 
+/// \copydoc ::Tiff_ReadImageParallel
+typedef BYTE (*p_Tiff_ReadImageParallel)(char*, UINT16*, UINT16); 
 /// \copydoc ::Tiff_WriteImage
 typedef BYTE (*p_Tiff_WriteImage)(char*, UINT16*,UINT16,UINT16); 
+/// \copydoc ::Tiff_StackOpen
+typedef BYTE (*p_Tiff_StackOpen)(char*, void**); 
+/// \copydoc ::Tiff_StackCreate
+typedef BYTE (*p_Tiff_StackCreate)(char*, UINT16, UINT16, void**); 
+/// \copydoc ::Tiff_StackGetParams
+typedef BYTE (*p_Tiff_StackGetParams)(void*, UINT32*, UINT16*, UINT16*); 
+/// \copydoc ::Tiff_StackReadPage
+typedef BYTE (*p_Tiff_StackReadPage)(void*, UINT32, UINT16*); 
+/// \copydoc ::Tiff_StackReadPages
+typedef BYTE (*p_Tiff_StackReadPages)(void*, UINT32, UINT32, UINT16*); 
+/// \copydoc ::Tiff_StackAppend
+typedef BYTE (*p_Tiff_StackAppend)(void*, UINT16*); 
+/// \copydoc ::Tiff_StackClose
+typedef BYTE (*p_Tiff_StackClose)(void*); 
+/// \copydoc ::writeStripTIFF
+typedef BYTE (*p_writeStripTIFF)(char*, UINT16*, UINT16, UINT16, UINT16, UINT32);
 /// \copydoc ::WarnHandler
 typedef void (*p_WarnHandler)(const char*, const char*, va_list);
 /// \copydoc ::ErrorHandler
@@ -44,7 +62,16 @@ protected:
 	HINSTANCE hinstLib; 
 	p_Tiff_GetParams Tiff_GetParams;	// pointer to function from DLL
 	p_Tiff_ReadImage Tiff_ReadImage;	// pointer to function from DLL
+	p_Tiff_ReadImageParallel Tiff_ReadImageParallel;	// pointer to function from DLL
 	p_Tiff_WriteImage Tiff_WriteImage; // pointer to function from DLL
+	p_Tiff_StackOpen Tiff_StackOpen;	// pointer to function from DLL
+	p_Tiff_StackCreate Tiff_StackCreate;	// pointer to function from DLL
+	p_Tiff_StackGetParams Tiff_StackGetParams;	// pointer to function from DLL
+	p_Tiff_StackReadPage Tiff_StackReadPage;	// pointer to function from DLL
+	p_Tiff_StackReadPages Tiff_StackReadPages;	// pointer to function from DLL
+	p_Tiff_StackAppend Tiff_StackAppend;	// pointer to function from DLL
+	p_Tiff_StackClose Tiff_StackClose;	// pointer to function from DLL
+	p_writeStripTIFF writeStripTIFF; // pointer to function from DLL
 	p_WarnHandler WarnHandler; // pointer to function from DLL
 	p_ErrorHandler ErrorHandler; // pointer to function from DLL
 	
@@ -79,6 +106,13 @@ protected:
 			init_error = TRUE;
 			return;
 		}
+		Tiff_ReadImageParallel = (p_Tiff_ReadImageParallel)GetProcAddress(hinstLib, "Tiff_ReadImageParallel"); 
+		if(Tiff_ReadImageParallel==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+			return;
+		}
 		Tiff_WriteImage = (p_Tiff_WriteImage)GetProcAddress(hinstLib, "Tiff_WriteImage"); 
 		if(Tiff_ReadImage==NULL)
 		{
@@ -86,6 +120,62 @@ protected:
 			init_error = TRUE;
 			return;
 		}
+		Tiff_StackOpen = (p_Tiff_StackOpen)GetProcAddress(hinstLib, "Tiff_StackOpen"); 
+		if(Tiff_StackOpen==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+			return;
+		}
+		Tiff_StackCreate = (p_Tiff_StackCreate)GetProcAddress(hinstLib, "Tiff_StackCreate"); 
+		if(Tiff_StackCreate==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+			return;
+		}
+		Tiff_StackGetParams = (p_Tiff_StackGetParams)GetProcAddress(hinstLib, "Tiff_StackGetParams"); 
+		if(Tiff_StackGetParams==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+			return;
+		}
+		Tiff_StackReadPage = (p_Tiff_StackReadPage)GetProcAddress(hinstLib, "Tiff_StackReadPage"); 
+		if(Tiff_StackReadPage==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+			return;
+		}
+		Tiff_StackReadPages = (p_Tiff_StackReadPages)GetProcAddress(hinstLib, "Tiff_StackReadPages"); 
+		if(Tiff_StackReadPages==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+			return;
+		}
+		Tiff_StackAppend = (p_Tiff_StackAppend)GetProcAddress(hinstLib, "Tiff_StackAppend"); 
+		if(Tiff_StackAppend==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+			return;
+		}
+		Tiff_StackClose = (p_Tiff_StackClose)GetProcAddress(hinstLib, "Tiff_StackClose"); 
+		if(Tiff_StackClose==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+			return;
+		}
+		writeStripTIFF = (p_writeStripTIFF)GetProcAddress(hinstLib, "writeStripTIFF"); 
+		if(writeStripTIFF==NULL)
+		{
+			cerr << "Error in GetProcAddress" << endl;
+			init_error = TRUE;
+			return;
+		}
 		WarnHandler = (p_WarnHandler)GetProcAddress(hinstLib, "WarnHandler"); 
 		if(WarnHandler==NULL)
 		{
@@ -298,4 +388,187 @@ TEST_F(DLL_Tests,Tiff_Nonexistent_WriteImage)
 	err = Tiff_WriteImage("../../../../tests/LV_Tiff/data_no/no.tif",image,100,100);
 	EXPECT_EQ(FILE_READ_ERROR,err);		// expect FILE_READ_ERROR from procedure
 	delete[] image;
+}
+
+/**
+ * \test Tiff_Mapped_ReadImage
+ * Writes uncompressed image and reads it back. Tiff_WriteImage produces uncompressed native-endian file, thus
+ * Tiff_ReadImage copies it from memory-mapped file instead of decoding by libtiff.
+ * Expects:
+ * -# Proper initialization of DLL in fixture class
+ * -# Tiff_WriteImage and Tiff_ReadImage return OK
+ * -# Read image equal to written one
+ */ 
+TEST_F(DLL_Tests,Tiff_Mapped_ReadImage)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	BYTE err;	// error returned from procedure
+	UINT16 rows = 1000, cols = 1500, height, width;
+	UINT32 l;
+	UINT16* image = new UINT16[rows*cols];
+	UINT16* loaded = new UINT16[rows*cols];
+	for(l=0;l<(UINT32)rows*cols;++l)
+		image[l] = (UINT16)(l*2654435761u >> 16);	// pseudo random pixels, all bytes used
+	err = Tiff_WriteImage("../../../../tests/LV_Tiff/data/out_mapped.tif",image,rows,cols);
+	ASSERT_EQ(OK,err);
+	err = Tiff_GetParams("../../../../tests/LV_Tiff/data/out_mapped.tif",&height, &width);
+	ASSERT_EQ(OK,err);
+	EXPECT_EQ(rows, height);
+	EXPECT_EQ(cols, width);
+	err = Tiff_ReadImage("../../../../tests/LV_Tiff/data/out_mapped.tif",loaded);
+	ASSERT_EQ(OK,err);
+	for(l=0;l<(UINT32)rows*cols;++l)
+		ASSERT_EQ(image[l], loaded[l]) << "pixel " << l;
+	delete[] image;
+	delete[] loaded;
+}
+
+
+/**
+ * \test Tiff_ReadImageParallel
+ * Loads test image on various number of threads and compares it with image loaded by Tiff_ReadImage
+ * Expects:
+ * -# Proper initialization of DLL in fixture class
+ * -# Tiff_ReadImage and Tiff_ReadImageParallel return OK
+ * -# The same images for all numbers of threads (0 - all cores)
+ * -# FILE_READ_ERROR for nonexistent file
+ */ 
+TEST_F(DLL_Tests,Tiff_ReadImageParallel)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	BYTE err;	// error returned from procedure
+	UINT16 width, height;	// tiff size
+	UINT32 l;
+	UINT16 threads[] = {0, 1, 2, 5};
+	err = Tiff_GetParams("../../../../tests/LV_Tiff/data/test_4800x2000.tif",&height, &width);
+	ASSERT_EQ(OK,err);		// expect that returned size is correct
+	UINT16* image = new UINT16[width*height];
+	UINT16* loaded = new UINT16[width*height];
+	err = Tiff_ReadImage("../../../../tests/LV_Tiff/data/test_4800x2000.tif",image);
+	ASSERT_EQ(OK,err);
+	for(int t=0;t<sizeof(threads)/sizeof(threads[0]);++t)
+	{
+		memset(loaded,0,sizeof(UINT16)*width*height);
+		err = Tiff_ReadImageParallel("../../../../tests/LV_Tiff/data/test_4800x2000.tif",loaded,threads[t]);
+		ASSERT_EQ(OK,err) << "threads " << threads[t];
+		for(l=0;l<(UINT32)width*height;++l)
+			ASSERT_EQ(image[l], loaded[l]) << "threads " << threads[t] << " pixel " << l;
+	}
+	err = Tiff_ReadImageParallel("../../../../tests/LV_Tiff/data/no.tif",loaded,0);
+	EXPECT_EQ(FILE_READ_ERROR,err);
+	delete[] image;
+	delete[] loaded;
+}
+
+
+/**
+ * \test Tiff_ReadImageParallel_Compressed
+ * Writes LZW and Deflate images in strips of 24 rows, the last strip has 16 rows, and reads them on various number
+ * of threads. Compressed strips are decoded by libtiff, thus the parallel path is used.
+ * \pre Requires EXPORTTESTING macro and will work only for debug configs
+ * Expects:
+ * -# Proper initialization of DLL in fixture class
+ * -# writeStripTIFF, Tiff_ReadImage and Tiff_ReadImageParallel return OK
+ * -# Read images equal to written one for all numbers of threads (0 - all cores)
+ */ 
+TEST_F(DLL_Tests,Tiff_ReadImageParallel_Compressed)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	UINT16 rows = 1000, cols = 1500;
+	UINT32 l;
+	UINT16 compressions[] = {5, 8};	// COMPRESSION_LZW, COMPRESSION_ADOBE_DEFLATE
+	UINT16 threads[] = {0, 1, 2, 5, 100};
+	UINT16* image = new UINT16[rows*cols];
+	UINT16* loaded = new UINT16[rows*cols];
+	for(l=0;l<(UINT32)rows*cols;++l)
+		image[l] = (UINT16)((l%cols + l/cols) & 0xFFF) + (UINT16)((l*2654435761u >> 28));	// compressible with noise
+	for(int c=0;c<sizeof(compressions)/sizeof(compressions[0]);++c)
+	{
+		ASSERT_EQ(OK,writeStripTIFF("../../../../tests/LV_Tiff/data/out_compressed.tif",image,rows,cols,compressions[c],24));
+		memset(loaded,0,sizeof(UINT16)*rows*cols);
+		ASSERT_EQ(OK,Tiff_ReadImage("../../../../tests/LV_Tiff/data/out_compressed.tif",loaded));
+		for(l=0;l<(UINT32)rows*cols;++l)
+			ASSERT_EQ(image[l], loaded[l]) << "compression " << compressions[c] << " pixel " << l;
+		for(int t=0;t<sizeof(threads)/sizeof(threads[0]);++t)
+		{
+			memset(loaded,0,sizeof(UINT16)*rows*cols);
+			ASSERT_EQ(OK,Tiff_ReadImageParallel("../../../../tests/LV_Tiff/data/out_compressed.tif",loaded,threads[t]));
+			for(l=0;l<(UINT32)rows*cols;++l)
+				ASSERT_EQ(image[l], loaded[l]) << "compression " << compressions[c] << " threads " << threads[t] << " pixel " << l;
+		}
+	}
+	delete[] image;
+	delete[] loaded;
+}
+
+/**
+ * \test Tiff_Stack
+ * Writes stack of frames to multi-page file and reads it back by pages and by ranges of pages
+ * Expects:
+ * -# Proper initialization of DLL in fixture class
+ * -# Tiff_StackCreate, Tiff_StackAppend, Tiff_StackOpen, Tiff_StackReadPage, Tiff_StackReadPages and Tiff_StackClose return OK
+ * -# Tiff_StackGetParams returns number of pages and size of frames
+ * -# Read pages equal to written frames, Tiff_ReadImage reads the first page
+ * -# WRONG_PARAMETER for pages out of range and for reading from stack opened for writing
+ */ 
+TEST_F(DLL_Tests,Tiff_Stack)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	UINT16 rows = 300, cols = 457, height, width;
+	UINT32 nframes = 20, npages, l;
+	UINT32 npix = (UINT32)rows*cols;
+	void* stack;
+	UINT16* frames = new UINT16[npix*nframes];
+	UINT16* loaded = new UINT16[npix*nframes];
+	for(l=0;l<npix*nframes;++l)
+		frames[l] = (UINT16)(l*2654435761u >> 13);	// pseudo random pixels, different in every frame
+	ASSERT_EQ(OK,Tiff_StackCreate("../../../../tests/LV_Tiff/data/out_stack.tif",rows,cols,&stack));
+	for(UINT32 f=0;f<nframes;++f)
+		ASSERT_EQ(OK,Tiff_StackAppend(stack,frames+f*npix));
+	EXPECT_EQ(WRONG_PARAMETER,Tiff_StackReadPage(stack,0,loaded));	// opened for writing
+	ASSERT_EQ(OK,Tiff_StackClose(stack));
+
+	ASSERT_EQ(OK,Tiff_StackOpen("../../../../tests/LV_Tiff/data/out_stack.tif",&stack));
+	ASSERT_EQ(OK,Tiff_StackGetParams(stack,&npages,&height,&width));
+	EXPECT_EQ(nframes, npages);
+	EXPECT_EQ(rows, height);
+	EXPECT_EQ(cols, width);
+	UINT32 pages[] = {7, 0, 19, 7, 1};	// random access
+	for(int p=0;p<sizeof(pages)/sizeof(pages[0]);++p)
+	{
+		ASSERT_EQ(OK,Tiff_StackReadPage(stack,pages[p],loaded));
+		for(l=0;l<npix;++l)
+			ASSERT_EQ(frames[pages[p]*npix+l], loaded[l]) << "page " << pages[p] << " pixel " << l;
+	}
+	ASSERT_EQ(OK,Tiff_StackReadPages(stack,0,nframes,loaded));
+	for(l=0;l<npix*nframes;++l)
+		ASSERT_EQ(frames[l], loaded[l]) << "pixel " << l;
+	EXPECT_EQ(WRONG_PARAMETER,Tiff_StackReadPages(stack,15,6,loaded));
+	EXPECT_EQ(WRONG_PARAMETER,Tiff_StackReadPage(stack,nframes,loaded));
+	EXPECT_EQ(WRONG_PARAMETER,Tiff_StackAppend(stack,frames));		// opened for reading
+	EXPECT_EQ(OK,Tiff_StackClose(stack));
+
+	ASSERT_EQ(OK,Tiff_ReadImage("../../../../tests/LV_Tiff/data/out_stack.tif",loaded));
+	for(l=0;l<npix;++l)
+		ASSERT_EQ(frames[l], loaded[l]) << "pixel " << l;
+	EXPECT_EQ(FILE_READ_ERROR,Tiff_StackOpen("../../../../tests/LV_Tiff/data/no.tif",&stack));
+	delete[] frames;
+	delete[] loaded;
+}
+
+/**
+ * \test Tiff_StackTooLarge
+ * Appends frame of 65535x65535 pixels (8 GiB) to new stack
+ * Expects:
+ * -# FILE_TOO_LARGE from Tiff_StackAppend, frame is rejected before its data is read
+ * -# Tiff_StackClose returns OK
+ */ 
+TEST_F(DLL_Tests,Tiff_StackTooLarge)
+{
+	ASSERT_FALSE(init_error); // expect no error during initialization ( SetUp() )
+	UINT16 frame[16] = {0};	// never read
+	void* stack;
+	ASSERT_EQ(OK,Tiff_StackCreate("../../../../tests/LV_Tiff/data/out_stack_large.tif",65535,65535,&stack));
+	EXPECT_EQ(FILE_TOO_LARGE,Tiff_StackAppend(stack,frame));
+	EXPECT_EQ(OK,Tiff_StackClose(stack));
 }
\ No newline at end of file